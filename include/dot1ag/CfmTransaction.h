@@ -0,0 +1,297 @@
+/*
+ * @brief: CFM request/response transactions, as C++20 coroutines
+ *
+ *    Copyright (c) 2017
+ *    HCL Technologies Ltd.
+ *    All rights reserved.
+ *
+ * Created on March 7, 2017
+ */
+
+#ifndef _CFM_TRANSACTION_H_
+#define _CFM_TRANSACTION_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <coroutine>
+#include <deque>
+#include <vector>
+#include <unordered_map>
+#include <atomic>
+#include <string>
+#include <ostream>
+using namespace std;
+
+#include "dot1ag/Dot1ag.h"
+#include "dot1ag/TimerWheel.h"
+
+/*
+ * A coroutine started and forgotten: it runs as it is called up to its
+ * first co_await, and is resumed by the TransactionTable it waits on, in
+ * the thread of its owner, till it returns and its frame is freed. No
+ * thread and no stack of its own, only its frame: thousands of them can
+ * wait at once. Exceptions are not used here, one escaping aborts.
+ */
+class CfmTask {
+public:
+
+    struct promise_type {
+
+        CfmTask get_return_object() {
+            return CfmTask();
+        }
+
+        suspend_never initial_suspend() noexcept {
+            return suspend_never();
+        }
+
+        suspend_never final_suspend() noexcept {
+            return suspend_never();
+        }
+
+        void return_void() {
+        }
+
+        void unhandled_exception() {
+            abort();
+        }
+
+        /* the frames are counted, for the memory they take */
+        static void *operator new(size_t size);
+        static void operator delete(void *frame, size_t size);
+    };
+
+    /* The frames live and the bytes they take, thread safe */
+    static uint64_t getFrames() {
+        return frames_.load(memory_order_relaxed);
+    };
+
+    static uint64_t getFrameBytes() {
+        return frameBytes_.load(memory_order_relaxed);
+    };
+
+private:
+    static atomic<uint64_t> frames_;
+    static atomic<uint64_t> frameBytes_;
+};
+
+class Transaction;
+
+/*
+ * The transactions outstanding of a thread, by their Transaction ID in a
+ * hash table, and their timeouts, in ms, on a TimerWheel: the owner
+ * delivers the replies received, advances the time and sleeps till
+ * nextExpiry() along with its other deadlines, e.g. on its TimerService.
+ * The coroutines sleeping are parked on the wheel as well.
+ *
+ * Note: not thread safe but getStats(), the owner makes all the calls and
+ * the coroutines run in its thread.
+ */
+class TransactionTable {
+public:
+
+    struct Stats {
+        uint64_t opened;
+        uint64_t replies; /* delivered to a transaction */
+        uint64_t unmatched; /* of an ID not outstanding */
+        uint64_t expired; /* timed out before closed */
+        uint32_t pending; /* outstanding now */
+        uint32_t sleeping; /* coroutines parked on a sleep */
+    };
+
+    TransactionTable();
+
+    /* Destroys the coroutines still suspended on it */
+    virtual ~TransactionTable();
+
+    /*
+     * Hand the frame received over to the transaction of its Transaction
+     * ID if it is outstanding and waits for this opcode: it is moved out,
+     * the coroutine waiting resumed right away. False if none, the frame
+     * left alone.
+     */
+    bool deliver(Dot1ag *frame);
+
+    /* Time out the transactions and wake the sleepers due by now (ms) */
+    void advance(uint64_t now);
+
+    /* The next tick (ms) advance() has something to do, NONE64 if none */
+    uint64_t nextExpiry() const {
+        return timers_.nextExpiry();
+    };
+
+    /*
+     * co_await table.sleep(msec): resume msec ms from now, at the first
+     * advance() past it
+     */
+    class SleepAwaiter {
+    public:
+
+        SleepAwaiter(TransactionTable &table, uint32_t msec) :
+        table_(table), msec_(msec) {
+        }
+
+        bool await_ready() const {
+            return false;
+        }
+
+        void await_suspend(coroutine_handle<> handle) {
+            table_.park(handle, msec_);
+        }
+
+        void await_resume() const {
+        }
+
+    private:
+        TransactionTable &table_;
+        uint32_t msec_;
+    };
+
+    SleepAwaiter sleep(uint32_t msec) {
+        return SleepAwaiter(*this, msec);
+    };
+
+    uint32_t pending() const {
+        return byTransId_.size();
+    };
+
+    void getStats(Stats &stats) const;
+
+    size_t memoryUsage() const;
+
+private:
+    friend class Transaction;
+
+    /* A timer of the wheel: a transaction, or a coroutine sleeping */
+    struct Slot {
+        Transaction *transaction;
+        coroutine_handle<> sleeper;
+        bool used;
+    };
+
+    /* A free slot, the wheel grown for it */
+    uint32_t allocSlot();
+    void freeSlot(uint32_t slot);
+
+    /* Register the transaction, return its slot and set its ID */
+    uint32_t open(Transaction *transaction, uint32_t timeoutMsec);
+    void close(Transaction *transaction);
+
+    void park(coroutine_handle<> handle, uint32_t msec);
+
+    static uint64_t nowMsec();
+
+    vector<Slot> slots_;
+    vector<uint32_t> free_;
+    TimerWheel timers_;
+    vector<uint32_t> due_;
+
+    /* the slot of the transaction outstanding by Transaction ID */
+    unordered_map<uint32_t, uint32_t> byTransId_;
+    uint32_t nextTransId_;
+
+    atomic<uint64_t> opened_;
+    atomic<uint64_t> replies_;
+    atomic<uint64_t> unmatched_;
+    atomic<uint64_t> expired_;
+    atomic<uint32_t> pending_;
+    atomic<uint32_t> sleeping_;
+};
+
+ostream& operator<<(ostream& os, const TransactionTable::Stats& stats);
+
+/*
+ * One request and its replies, for a coroutine to write "send the request,
+ * co_await the reply or the timeout":
+ *
+ *     Transaction lb(table, CFM_LBR, timeout);
+ *     lbm->setTransId(lb.getTransId());
+ *     send lbm
+ *     Dot1ag *lbr = co_await lb.reply();   // NULL once timed out
+ *
+ * It takes a fresh Transaction ID as it is constructed, starting its
+ * timeout, and gives it back as it goes out of scope. A request answered
+ * several times, e.g. an LTM by every MIP on the way, has reply() awaited
+ * again till it returns NULL. The replies received while the coroutine
+ * was not waiting are queued.
+ */
+class Transaction {
+public:
+
+    Transaction(TransactionTable &table, uint8_t opcode,
+            uint32_t timeoutMsec);
+
+    Transaction(const Transaction &) = delete;
+    Transaction &operator=(const Transaction &) = delete;
+
+    virtual ~Transaction();
+
+    uint32_t getTransId() const {
+        return transId_;
+    };
+
+    /* The opcode of the replies awaited, as CFM_LBR */
+    uint8_t getOpcode() const {
+        return opcode_;
+    };
+
+    bool isExpired() const {
+        return expired_;
+    };
+
+    /* ms it was opened at, as the time base of advance() */
+    uint64_t getOpenedAt() const {
+        return openedAt_;
+    };
+
+    class ReplyAwaiter {
+    public:
+
+        ReplyAwaiter(Transaction &transaction) : transaction_(transaction) {
+        }
+
+        bool await_ready() const {
+            return !transaction_.replies_.empty() || transaction_.expired_;
+        }
+
+        void await_suspend(coroutine_handle<> handle) {
+            transaction_.waiter_ = handle;
+        }
+
+        Dot1ag *await_resume() {
+            return transaction_.nextReply();
+        }
+
+    private:
+        Transaction &transaction_;
+    };
+
+    /*
+     * co_await it for the next reply, NULL once timed out. The reply is
+     * owned by the transaction, valid till the next reply() or its end.
+     */
+    ReplyAwaiter reply() {
+        return ReplyAwaiter(*this);
+    };
+
+private:
+    friend class TransactionTable;
+
+    Dot1ag *nextReply();
+
+    TransactionTable &table_;
+    uint32_t slot_;
+    uint32_t transId_;
+    uint8_t opcode_;
+    bool expired_;
+    uint64_t openedAt_;
+
+    deque<Dot1ag *> replies_;
+    Dot1ag *current_;
+
+    /* the coroutine in co_await reply(), if any */
+    coroutine_handle<> waiter_;
+};
+
+#endif /* The end of #ifndef _CFM_TRANSACTION_H_ */
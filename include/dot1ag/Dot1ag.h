@@ -19,6 +19,8 @@
 #include <pcap.h>
 
 #include "ieee8021ag.h"
+#include "PacketBuf.h"
+#include "FrameLayout.h"
 
 /*
  * Additionals to ieee8021ag.h, due to support of R-APS
@@ -71,15 +73,28 @@ struct Dot1agAttr {
     uint8_t ring_id;
     int CCMSkips;
 
-    uint32_t CCMinterval;
+    uint32_t CCMinterval; /* ms, 3 for 3.33 ms */
     const uint8_t srcMac[ETHER_HDR_LEN];
     const uint8_t dstMac[ETHER_HDR_LEN];
     const char *md;
     const char *ma;
     const char *ifname;
     const char *remoteMac;
+    uint8_t ltmTtl; /* linktrace to remoteMac with LTMs of this TTL, 0: off */
     int verbose; // debug purpose
 
+    /* Fault alarms: the lowest defect priority (1-6), times in ms */
+    uint8_t lowestAlarmPri;
+    uint32_t fngAlarmTime;
+    uint32_t fngResetTime;
+
+    /*
+     * Remote MEP events: transitions within eventWindow ms are reported
+     * as one, flapping is dampened with flapHalfLife ms (0: never)
+     */
+    uint32_t eventWindow;
+    uint32_t flapHalfLife;
+
     Dot1agAttr() : srcMac({0}), dstMac({0}) {
         transId = 0;
         mepid = -1;
@@ -92,21 +107,35 @@ struct Dot1agAttr {
         ma = "HCL_ERPS";
         ifname = NULL;
         remoteMac = NULL;
+        ltmTtl = 0;
         verbose = 0;
+        lowestAlarmPri = 2;
+        fngAlarmTime = 2500;
+        fngResetTime = 10000;
+        eventWindow = 1000;
+        flapHalfLife = 15000;
     }
 } __attribute__((__packed__));
 
 class Dot1ag {
 public:
-    static const uint16_t BUFFER_MAX_SIZE = 1516;
+    static const uint16_t BUFFER_MAX_SIZE = PacketBuf::MAX_SIZE;
 
     Dot1ag();
     Dot1ag(const uint8_t * data, uint32_t len);
+    Dot1ag(PacketBuf &&pkt);
     Dot1ag(const Dot1agAttr * attr);
 
+    /* Packets are move-only, use clone() for a deep copy of the frame */
+    Dot1ag(Dot1ag &&other);
+    Dot1ag(const Dot1ag &) = delete;
+    Dot1ag &operator=(const Dot1ag &) = delete;
+
     virtual ~Dot1ag() {
     };
 
+    Dot1ag *clone() const;
+
     /* Parse a MAC address */
     static int eth_addr_parse(uint8_t *addr, const char *str);
 
@@ -134,48 +163,94 @@ public:
 
     void setTransId(uint32_t trans_id) {
         struct cfm_tid *p;
-        p = POS_CFM_TID(buf);
+        p = POS_CFM_TID(buf.data());
         p->transID = htonl(trans_id);
     }
 
     int setDstMac(const char *mac) {
-        return Dot1ag::eth_addr_parse(this->etherHeader_p->ether_dhost, mac);
+        return Dot1ag::eth_addr_parse(etherHeader()->ether_dhost, mac);
     }
 
     int setDstMac(const uint8_t *mac) {
         for (int i = 0; i < ETHER_ADDR_LEN; i++) {
-            this->etherHeader_p->ether_dhost[i] = mac[i];
+            etherHeader()->ether_dhost[i] = mac[i];
         }
         return 0;
     }
     
     uint16_t getEtherType() const {
-        return ntohs(*(ETHER_TYPE(this->buf)));
+        return ntohs(*(ETHER_TYPE(buf.data())));
     };
 
     uint32_t getTransId() const {
-        struct cfm_tid *p;
-        p = POS_CFM_TID(buf);
+        const struct cfmhdr *cfmhdr = getCfmHdr();
+        const struct cfm_tid *p;
+
+        if (cfmhdr == NULL || (const uint8_t *) (cfmhdr + 1) +
+                sizeof (struct cfm_tid) > buf.data() + buf.size()) {
+            return 0;
+        }
+        p = (const struct cfm_tid *) (cfmhdr + 1);
         return ntohl(p->transID);
     };
 
     uint32_t getPacketSize() const {
-        return this->packetSize;
+        return buf.size();
     };
 
     uint8_t *getPacketData() {
-        return this->buf;
+        return buf.data();
+    };
+
+    const PacketBuf &getPacketBuf() const {
+        return buf;
+    };
+
+    /* The tagging of the frame, classified once when received or built */
+    FrameTagging getTagging() const {
+        return tagging;
+    };
+
+    /*
+     * When the frame was received, in us of the date as pcap stamped it,
+     * 0 for a frame built here
+     */
+    uint64_t getRxStamp() const {
+        return rxStamp;
+    };
+
+    void setRxStamp(const struct timeval &ts) {
+        rxStamp = (uint64_t) ts.tv_sec * 1000000 + ts.tv_usec;
+    };
+
+    /* NULL if the frame is not CFM */
+    const struct cfmhdr *getCfmHdr() const {
+        return frameCfmHdr(tagging, buf.data());
+    };
+
+    /* VLAN ID of the outer tag, 0 if untagged */
+    uint16_t getVlan() const {
+        switch (tagging) {
+            case FRAME_DOT1Q:
+                return Dot1qLayout::vlan(buf.data());
+            case FRAME_DOT1AD:
+                return Dot1adLayout::vlan(buf.data());
+            default:
+                return 0;
+        }
     };
     const string *getDstMacString();
 
 protected:
-    uint8_t buf[BUFFER_MAX_SIZE];
+    PacketBuf buf;
+    FrameTagging tagging;
+    uint64_t rxStamp;
+
+    /* Note: never cache pointers into buf, it may move while growing */
+    struct ether_header *etherHeader() {
+        return (struct ether_header *) buf.data();
+    };
 
-    struct ether_header *etherHeader_p = (struct ether_header *) buf;
-    uint8_t *localmac = etherHeader_p->ether_shost;
-    uint8_t *remotemac = etherHeader_p->ether_dhost;
-    uint32_t packetSize;
-    
     const Dot1agAttr *attr;
 
 private:
@@ -27,8 +27,36 @@ public:
     
     void addCcm(uint8_t md_level, const char *md, const char *ma,
         uint16_t mepid, uint32_t CCIsentCCMs);
+
+    /*
+     * Encode the MAID of the character string MD name and MA name, as sent
+     * in our CCMs. maid is zero filled first.
+     */
+    static void encodeMaid(struct cfm_maid *maid, const char *md,
+        const char *ma);
     
     int cfmMatchCcm(const uint8_t *data) const;
+
+    /* Set or clear the RDI bit of the CCM flags, for the next ones sent */
+    void setRdi(bool rdi) {
+        struct cfmhdr *cfmhdr =
+                (struct cfmhdr *) frameCfmHdr(tagging, buf.data());
+
+        if (rdi) {
+            cfmhdr->flags |= DOT1AG_CCFLAGS_RDI;
+        } else {
+            cfmhdr->flags &= ~DOT1AG_CCFLAGS_RDI;
+        }
+    };
+
+    /*
+     * The CCM Interval field of a CCM interval in ms (3 for 3.33 ms), 0 if
+     * it is not one of those of 802.1ag
+     */
+    static int encodeInterval(uint32_t ms);
+
+    /* The CCM interval in us of the CCM Interval field, 0 if invalid */
+    static uint32_t decodeInterval(uint8_t code);
     
 private:    
 
@@ -22,15 +22,36 @@ class Dot1agLbm : public Dot1ag {
 public:
     /* how many times need to wait before sending in waiting for response */
     static const int LBR_BACKLOG = 6;
-    
+
+    /* ms to wait for the LBR of an LBM */
+    static const uint32_t LBR_TIMEOUT = 5000;
+
     Dot1agLbm(const Dot1agAttr *attr);
 
     virtual ~Dot1agLbm() {
     };
 
-    int cfm_matchlbr(const uint8_t *data);
+    int cfm_matchlbr(const uint8_t *data, uint32_t size);
+
+    /* Of the LBM sent with transId, rather than of the one in the template */
+    int cfm_matchlbr(const uint8_t *data, uint32_t size, uint32_t transId);
     static int convertDotagLbm2Lbr(Dot1ag *lb, const uint8_t *localMac);
 
+    /*
+     * Validate the raw frame of size bytes as an LBM for localMac and turn
+     * it into the LBR in place. Silent, as it is used on the RX fast path.
+     */
+    static int convertLbm2Lbr(uint8_t *frame, uint32_t size,
+            const uint8_t *localMac);
+
+    /* The validation of convertLbm2Lbr() alone, the frame left alone */
+    static int validateLbm(const uint8_t *frame, uint32_t size,
+            const uint8_t *localMac);
+
+    /* The turning into the LBR alone, of an LBM validated of tagging */
+    static void turnLbm2Lbr(uint8_t *frame, FrameTagging tagging,
+            const uint8_t *localMac);
+
 private:
 
 };
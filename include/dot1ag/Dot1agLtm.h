@@ -1,10 +1,11 @@
 /*
- * @brief: CFM PDU Encapsulation with type/length media
- * 
+ * @brief: CFM_LTM PDU Encapsulation with type/length media
+ *
  *    Copyright (c) 2017
  *    HCL Technologies Ltd.
  *    All rights reserved.
  *
+ * Created on March 7, 2017
  */
 
 #ifndef _DOT1AG_LTM_H_
@@ -14,37 +15,40 @@
 #include <netinet/in.h>
 #include <sys/types.h>
 
+#include <string>
+using namespace std;
+
 #include "ieee8021ag.h"
+#include "Dot1ag.h"
 
-class Dot1agLtm: public Dot1ag {
+class Dot1agLtm : public Dot1ag {
 public:
-    
-    Dot1agLtm(){        
-    };
-    
-    virtual ~Dot1agLtm() {
-    };
-    
-    void
-    cfm_addltm(uint32_t transID, uint8_t ttl, uint8_t *localmac, uint8_t *remotemac);
+    /* ms to wait for the LTRs of an LTM, from every hop on the way */
+    static const uint32_t LTR_TIMEOUT = 5000;
 
-    void
-    cfm_ltm_setttl(uint8_t ttl);
+    /* the LTM is relayed by the MAC addresses learnt only */
+    static const uint8_t FLAG_USE_FDB_ONLY = 0x80;
 
-    void
-    cfm_ltm_settransid(uint32_t trans_id);
+    /*
+     * An LTM to the LTM group address of the MD level, tracing the route
+     * to attr->remoteMac, with the TTL ttl
+     */
+    Dot1agLtm(const Dot1agAttr *attr, uint8_t ttl);
 
-    void
-    cfm_addltr(uint32_t transID, uint8_t ttl, uint8_t action);
+    virtual ~Dot1agLtm() {
+    };
 
-    int
-    cfm_matchltr(uint8_t *dst, uint16_t vlan, uint8_t md_level,
-            uint32_t trans_id, int *hit_target);
+    void setTtl(uint8_t ttl);
 
+    /*
+     * Validate the raw frame of size bytes as an LTR to localMac and get
+     * its TTL and Relay Action. Silent, as it is used on the RX path.
+     */
+    static int parseLtr(const uint8_t *frame, uint32_t size,
+            const uint8_t *localMac, uint8_t &ttl, uint8_t &action);
 
-    
 private:
+
 };
 
 #endif /* The end of #ifndef _DOT1AG_LTM_H_ */
-
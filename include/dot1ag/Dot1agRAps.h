@@ -23,10 +23,14 @@ public:
     
     void addRAps(uint8_t request, uint8_t *nid);
     
-    int cfmMatchRAps(const uint8_t *data) const;
+    /* Return 1 if the packet received is a well formed R-APS PDU */
+    int cfmMatchRAps(const Dot1ag *packet) const;
     
 private:    
 
+    template <class Layout>
+    int matchRAps(const uint8_t *data, uint32_t size) const;
+
 };
 
 #endif /* The end of #ifndef _DOT1AG_R_APS_H_ */
@@ -0,0 +1,121 @@
+/*
+ * @brief: Non-blocking sink of the state change events of the MEPs
+ *
+ *    Copyright (c) 2017
+ *    HCL Technologies Ltd.
+ *    All rights reserved.
+ *
+ * Created on March 7, 2017
+ */
+
+#ifndef _EVENT_LOG_H_
+#define _EVENT_LOG_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <ostream>
+#include <vector>
+using namespace std;
+
+#include "Runnable.h"
+#include "TimerService.h"
+
+/*
+ * Every producer thread, a shard, posts its events to a single producer
+ * ring of its own, which never blocks: an event finding the ring full is
+ * dropped and counted. The thread of the log sleeps till an event is
+ * posted, then lets the rings fill for DRAIN_MSEC and writes the events
+ * out, so that what is logged costs the producers a copy of the event
+ * whatever the output does, and an idle log never wakes up.
+ */
+class EventLog : public Runnable {
+public:
+    static const uint32_t DEFAULT_CAPACITY = 1024; /* events per producer */
+    static const uint32_t DRAIN_MSEC = 50;
+
+    enum Type {
+        RMEP_UP,
+        RMEP_DOWN,
+        RMEP_FLAPPED, /* back as it was, but count times down and up */
+        RMEP_SUPPRESSED, /* flapping: its events are held back */
+        RMEP_REUSED, /* no longer flapping */
+        RMEP_INTERVAL_MISMATCH, /* arg: its CCM interval, in us */
+        FAULT_ALARM, /* arg: the priority of the defect */
+        FAULT_ALARM_RESET,
+        RAPS_SF_SENT,
+        LBR_LOST, /* arg: the Transaction ID of the LBM unanswered */
+        LBR_RECEIVED /* again, arg: the Transaction ID it answered */
+    };
+
+    struct Event {
+        uint64_t time; /* ms */
+        uint32_t arg;
+        uint32_t count; /* of the transitions coalesced */
+        uint16_t vlan;
+        uint16_t mepid;
+        uint16_t rMEPid; /* 0 for the events of the local MEP */
+        uint8_t type;
+    };
+
+    EventLog(uint32_t producers, uint32_t capacity = DEFAULT_CAPACITY,
+            string name = "Event Log");
+
+    virtual ~EventLog();
+
+    /*
+     * Producer only, one thread per producer: post the event, EXIT_FAILURE
+     * if it was dropped
+     */
+    int post(uint32_t producer, const Event &event) {
+        Ring &ring = *rings_[producer];
+        uint32_t head = ring.head.load(memory_order_relaxed);
+
+        if (head - ring.tail.load(memory_order_acquire) >= capacity_) {
+            ring.dropped.fetch_add(1, memory_order_relaxed);
+            return EXIT_FAILURE;
+        }
+        ring.events[head & (capacity_ - 1)] = event;
+        ring.head.store(head + 1, memory_order_release);
+
+        /* against asleep_ set before the rings are looked at */
+        atomic_thread_fence(memory_order_seq_cst);
+        if (asleep_.load(memory_order_relaxed)) {
+            waker_.wake();
+        }
+        return EXIT_SUCCESS;
+    };
+
+    /* Consumer only: write out the events posted so far, return how many */
+    uint32_t drain(ostream &os);
+
+    /* Events dropped as their ring was full */
+    uint64_t getDropped() const;
+
+    static const char *typeName(uint8_t type);
+
+    /* Drains the rings to cout till the end */
+    virtual void task();
+
+    /* Whether some event is still to be drained */
+    bool isPending() const;
+
+private:
+    struct Ring {
+        atomic<uint32_t> head; /* written by the producer */
+        char pad[60];
+        atomic<uint32_t> tail; /* written by the consumer */
+        atomic<uint64_t> dropped;
+        vector<Event> events;
+    };
+
+    uint32_t capacity_; /* a power of 2 */
+    vector<Ring *> rings_;
+
+    /* the thread of the log sleeps, or is about to, in waker_ */
+    atomic<bool> asleep_;
+    TimerService waker_;
+};
+
+#endif /* The end of #ifndef _EVENT_LOG_H_ */
+
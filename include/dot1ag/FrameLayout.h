@@ -0,0 +1,150 @@
+/*
+ * @brief: Layouts of the CFM frames by their VLAN tagging
+ *
+ *    Copyright (c) 2017
+ *    HCL Technologies Ltd.
+ *    All rights reserved.
+ *
+ * Created on March 7, 2017
+ */
+
+#ifndef _FRAME_LAYOUT_H_
+#define _FRAME_LAYOUT_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "ieee8021ag.h"
+
+#define ETYPE_8021AD    0x88a8
+
+/*
+ * The tagging of a frame, found once by classifyFrame() when received, and
+ * then used to pick the FrameLayout all the offsets are taken from.
+ */
+enum FrameTagging {
+    FRAME_UNTAGGED = 0, /* CFM right behind the Ether header */
+    FRAME_DOT1Q, /* 802.1Q C-tag */
+    FRAME_DOT1AD, /* 802.1ad S-tag followed by a C-tag */
+    FRAME_NOT_CFM /* not a CFM frame, or too short for one */
+};
+
+/*
+ * Accessors of a CFM frame with TAGS VLAN tags, all offsets are constants
+ * so that a path specialized for the layout has no tagging test left.
+ * The frame is assumed to be at least MIN_SIZE, as checked by
+ * classifyFrame().
+ */
+template <int TAGS>
+struct FrameLayout {
+    static const FrameTagging TAGGING = (FrameTagging) TAGS;
+    static const uint32_t ETHERTYPE_OFFSET =
+            ETHER_ADDR_LEN * 2 + TAGS * ETHER_DOT1Q_LEN;
+    static const uint32_t CFM_OFFSET = ETHERTYPE_OFFSET + sizeof (uint16_t);
+    static const uint32_t PDU_OFFSET = CFM_OFFSET + sizeof (struct cfmhdr);
+    static const uint32_t MIN_SIZE = PDU_OFFSET;
+
+    /* VLAN ID of the outer tag, 0 if untagged */
+    static uint16_t vlan(const uint8_t *frame) {
+        if (TAGS == 0) {
+            return 0;
+        }
+        return ((frame[ETHER_ADDR_LEN * 2 + 2] << 8) |
+                frame[ETHER_ADDR_LEN * 2 + 3]) & 0x0fff;
+    };
+
+    /* VLAN ID of the inner tag, the only one if single tagged */
+    static uint16_t innerVlan(const uint8_t *frame) {
+        if (TAGS == 0) {
+            return 0;
+        }
+        return ((frame[ETHERTYPE_OFFSET - 2] << 8) |
+                frame[ETHERTYPE_OFFSET - 1]) & 0x0fff;
+    };
+
+    static const uint8_t *srcMac(const uint8_t *frame) {
+        return frame + ETHER_ADDR_LEN;
+    };
+
+    static struct cfmhdr *cfmhdr(uint8_t *frame) {
+        return (struct cfmhdr *) (frame + CFM_OFFSET);
+    };
+
+    static const struct cfmhdr *cfmhdr(const uint8_t *frame) {
+        return (const struct cfmhdr *) (frame + CFM_OFFSET);
+    };
+
+    /* The PDU right behind the CFM header, e.g. struct cfm_cc */
+    template <class T>
+    static const T *pdu(const uint8_t *frame) {
+        return (const T *) (frame + PDU_OFFSET);
+    };
+
+    template <class T>
+    static T *pdu(uint8_t *frame) {
+        return (T *) (frame + PDU_OFFSET);
+    };
+
+    /* The first TLV, by the First TLV Offset of the CFM header */
+    static const uint8_t *firstTlv(const uint8_t *frame) {
+        return frame + PDU_OFFSET + cfmhdr(frame)->tlv_offset;
+    };
+};
+
+typedef FrameLayout<0> UntaggedLayout;
+typedef FrameLayout<1> Dot1qLayout;
+typedef FrameLayout<2> Dot1adLayout;
+
+/*
+ * The only place the TPIDs are looked at: return the tagging of the frame
+ * of size bytes, FRAME_NOT_CFM if it is not a CFM frame with at least the
+ * CFM header.
+ */
+static inline FrameTagging classifyFrame(const uint8_t *frame, uint32_t size) {
+    const uint8_t *p = frame + ETHER_ADDR_LEN * 2;
+
+#define FRAME_TYPE_AT(n)        ((p[(n)] << 8) | p[(n) + 1])
+
+    if (size < UntaggedLayout::MIN_SIZE) {
+        return FRAME_NOT_CFM;
+    }
+    switch (FRAME_TYPE_AT(0)) {
+        case ETYPE_CFM:
+            return FRAME_UNTAGGED;
+        case ETYPE_8021Q:
+            if (size >= Dot1qLayout::MIN_SIZE &&
+                    FRAME_TYPE_AT(ETHER_DOT1Q_LEN) == ETYPE_CFM) {
+                return FRAME_DOT1Q;
+            }
+            break;
+        case ETYPE_8021AD:
+            if (size >= Dot1adLayout::MIN_SIZE &&
+                    FRAME_TYPE_AT(ETHER_DOT1Q_LEN) == ETYPE_8021Q &&
+                    FRAME_TYPE_AT(ETHER_DOT1Q_LEN * 2) == ETYPE_CFM) {
+                return FRAME_DOT1AD;
+            }
+            break;
+        default:
+            break;
+    }
+    return FRAME_NOT_CFM;
+
+#undef FRAME_TYPE_AT
+}
+
+/* The CFM header of a frame of the tagging given, NULL if not CFM */
+static inline const struct cfmhdr *frameCfmHdr(FrameTagging tagging,
+        const uint8_t *frame) {
+    switch (tagging) {
+        case FRAME_UNTAGGED:
+            return UntaggedLayout::cfmhdr(frame);
+        case FRAME_DOT1Q:
+            return Dot1qLayout::cfmhdr(frame);
+        case FRAME_DOT1AD:
+            return Dot1adLayout::cfmhdr(frame);
+        default:
+            return NULL;
+    }
+}
+
+#endif /* The end of #ifndef _FRAME_LAYOUT_H_ */
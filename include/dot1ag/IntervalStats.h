@@ -0,0 +1,140 @@
+/*
+ * @brief: Streaming statistics of the intervals between CCMs received
+ *
+ *    Copyright (c) 2017
+ *    HCL Technologies Ltd.
+ *    All rights reserved.
+ *
+ * Created on March 7, 2017
+ */
+
+#ifndef _INTERVAL_STATS_H_
+#define _INTERVAL_STATS_H_
+
+#include <stdint.h>
+#include <math.h>
+
+#include <ostream>
+using namespace std;
+
+/*
+ * Min, max, mean and variance (Welford's online algorithm) of the intervals
+ * between arrivals, in us, with a histogram of them against the nominal
+ * interval: four buckets an octave from 0.5x on, the nominal interval
+ * starting bucket NOMINAL_BUCKET, the last one from 3.5x on where rMEPwhile
+ * runs out. Fixed size, no allocation, plain data to be copied as is.
+ */
+class IntervalStats {
+public:
+    static const uint32_t BUCKETS = 12;
+    static const uint32_t NOMINAL_BUCKET = 4;
+
+    /* plain data: not set up until reset() */
+    void reset();
+
+    /* The next arrival starts over, e.g. after the sender was lost */
+    void restart() {
+        last_ = 0;
+    };
+
+    /* An arrival at now (us), of a sender meant to send every nominal us */
+    void add(uint64_t now, uint32_t nominal) {
+        uint64_t elapsed = now - last_;
+        uint32_t interval;
+        double delta;
+
+        if (last_ == 0 || now < last_) {
+            last_ = now;
+            return;
+        }
+        last_ = now;
+        interval = elapsed > 0xffffffffULL ? 0xffffffff : elapsed;
+
+        if (count_ == 0 || interval < min_) {
+            min_ = interval;
+        }
+        if (interval > max_) {
+            max_ = interval;
+        }
+        count_++;
+        delta = interval - mean_;
+        mean_ += delta / count_;
+        m2_ += delta * (interval - mean_);
+
+        buckets_[bucket(interval, nominal)]++;
+    };
+
+    /* The last arrival, us, 0 for none yet */
+    uint64_t getLast() const {
+        return last_;
+    };
+
+    /* The number of intervals, one less than the arrivals */
+    uint32_t getCount() const {
+        return count_;
+    };
+
+    uint32_t getMin() const {
+        return min_;
+    };
+
+    uint32_t getMax() const {
+        return max_;
+    };
+
+    double getMean() const {
+        return mean_;
+    };
+
+    double getVariance() const {
+        return count_ > 1 ? m2_ / (count_ - 1) : 0;
+    };
+
+    double getStddev() const {
+        return sqrt(getVariance());
+    };
+
+    uint32_t getBucket(uint32_t k) const {
+        return buckets_[k];
+    };
+
+    /* The lower bound of bucket k, as a ratio of the nominal interval */
+    static double bucketLow(uint32_t k);
+
+    /* The bucket of interval, with nominal: log2 and two more bits */
+    static uint32_t bucket(uint32_t interval, uint32_t nominal) {
+        uint64_t ratio;
+        uint32_t msb;
+        uint32_t index;
+
+        if (nominal == 0) {
+            return BUCKETS - 1;
+        }
+        /* 256 for the nominal interval */
+        ratio = ((uint64_t) interval << 8) / nominal;
+        if (ratio < FIRST_RATIO) {
+            return 0;
+        }
+        msb = 63 - __builtin_clzll(ratio);
+        index = msb * 4 + ((ratio >> (msb - 2)) & 3) - FIRST_INDEX;
+        return index < BUCKETS ? index : BUCKETS - 1;
+    };
+
+    void print(ostream &os) const;
+
+private:
+    /* 0.5x, 128 / 256, is the first bucket, log2 128 * 4 */
+    static const uint64_t FIRST_RATIO = 128;
+    static const uint32_t FIRST_INDEX = 28;
+
+    uint64_t last_; /* us, of the last arrival, 0 for none */
+    uint32_t count_;
+    uint32_t min_;
+    uint32_t max_;
+    double mean_;
+    double m2_; /* sum of the squared differences from the mean */
+    uint32_t buckets_[BUCKETS];
+};
+
+#endif /* The end of #ifndef _INTERVAL_STATS_H_ */
+
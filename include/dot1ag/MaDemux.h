@@ -0,0 +1,107 @@
+/*
+ * @brief: Demultiplexing CFM frames to their MA by VLAN and MD level
+ *
+ *    Copyright (c) 2017
+ *    HCL Technologies Ltd.
+ *    All rights reserved.
+ *
+ * Created on March 7, 2017
+ */
+
+#ifndef _MA_DEMUX_H_
+#define _MA_DEMUX_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <atomic>
+using namespace std;
+
+/*
+ * Maps a (VLAN 0-4095, MD level 0-7) pair to the index of the MA context
+ * configured for it, through a two level direct table: a page holds the
+ * entries of PAGE_VLANS VLANs and is only allocated once one of them is
+ * used, so that a few MAs on scattered VLANs take a few KB.
+ *
+ * Lookups are O(1) and lock free. Frames of a pair without an MA are only
+ * counted, the caller drops them without logging. add() is meant for the
+ * configuration time, before frames are demultiplexed.
+ */
+class MaDemux {
+public:
+    static const uint32_t NONE = 0xffff;
+    static const uint32_t VLANS = 4096;
+    static const uint32_t LEVELS = 8;
+    static const uint32_t PAGE_BITS = 6;
+    static const uint32_t PAGE_VLANS = 1 << PAGE_BITS;
+    static const uint32_t PAGES = VLANS / PAGE_VLANS;
+
+    MaDemux();
+    ~MaDemux();
+
+    MaDemux(const MaDemux &) = delete;
+    MaDemux &operator=(const MaDemux &) = delete;
+
+    /*
+     * Map (vlan, level) to ma, return EXIT_FAILURE if out of range or
+     * already mapped
+     */
+    int add(uint16_t vlan, uint8_t level, uint32_t ma);
+
+    /* The MA of (vlan, level), NONE if none */
+    uint32_t lookup(uint16_t vlan, uint8_t level) const {
+        const uint16_t *page;
+
+        if (vlan >= VLANS || level >= LEVELS) {
+            return NONE;
+        }
+        page = pages_[vlan >> PAGE_BITS];
+        if (page == NULL) {
+            return NONE;
+        }
+        return page[((vlan & (PAGE_VLANS - 1)) << 3) | level];
+    };
+
+    /*
+     * The MA on vlan at the lowest MD level above level, NONE if none: the
+     * one a CCM of a lower level leaks into
+     */
+    uint32_t lookupAbove(uint16_t vlan, uint8_t level) const {
+        uint32_t ma;
+
+        while (++level < LEVELS) {
+            if ((ma = lookup(vlan, level)) != NONE) {
+                return ma;
+            }
+        }
+        return NONE;
+    };
+
+    /* As lookup(), counting the frames of an unknown pair */
+    uint32_t demux(uint16_t vlan, uint8_t level) {
+        uint32_t ma = lookup(vlan, level);
+
+        if (ma == NONE) {
+            unknown_.fetch_add(1, memory_order_relaxed);
+        }
+        return ma;
+    };
+
+    /* Frames dropped as of no MA */
+    uint64_t getUnknown() const {
+        return unknown_.load(memory_order_relaxed);
+    };
+
+    uint32_t size() const {
+        return size_;
+    };
+
+    size_t memoryUsage() const;
+
+private:
+    uint16_t *pages_[PAGES];
+    uint32_t size_;
+    atomic<uint64_t> unknown_;
+};
+
+#endif /* The end of #ifndef _MA_DEMUX_H_ */
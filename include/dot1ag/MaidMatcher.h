@@ -0,0 +1,75 @@
+/*
+ * @brief: Matching the MAID of CCMs received against ours
+ *
+ *    Copyright (c) 2017
+ *    HCL Technologies Ltd.
+ *    All rights reserved.
+ *
+ * Created on March 7, 2017
+ */
+
+#ifndef _MAID_MATCHER_H_
+#define _MAID_MATCHER_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "ieee8021ag.h"
+
+/*
+ * The expected MAID is encoded once, exactly as Dot1agCcm::addCcm() puts
+ * it in our own CCMs, so that a CCM received is validated by one 48 byte
+ * compare. The names are only decoded for diagnostics, on a mismatch.
+ */
+class MaidMatcher {
+public:
+
+    MaidMatcher() {
+        memset(image_, 0, sizeof (image_));
+    };
+
+    void setMaid(const char *md, const char *ma);
+
+    bool match(const struct cfm_maid *maid) const {
+#ifdef __SSE2__
+        /* the MAID is not aligned in the frame, our image is */
+        const uint8_t *p = &maid->format;
+        const __m128i *q = (const __m128i *) image_;
+        __m128i eq;
+
+        eq = _mm_and_si128(
+                _mm_and_si128(
+                _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) p),
+                _mm_load_si128(q)),
+                _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (p + 16)),
+                _mm_load_si128(q + 1))),
+                _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (p + 32)),
+                _mm_load_si128(q + 2)));
+        return _mm_movemask_epi8(eq) == 0xffff;
+#else
+        return memcmp(maid, image_, MAID_SIZE) == 0;
+#endif
+    };
+
+    const struct cfm_maid *getMaid() const {
+        return (const struct cfm_maid *) image_;
+    };
+
+    /*
+     * Decode the character string MD name and Short MA name of the MAID
+     * into '\0' terminated md and ma, empty if not of that format. Return
+     * EXIT_FAILURE if the lengths in the MAID are illegal.
+     */
+    static int decodeNames(const struct cfm_maid *maid,
+            char md[DOT1AG_MAX_MD_LENGTH + 1], char ma[MAID_SIZE - 4 + 1]);
+
+private:
+    uint8_t image_[MAID_SIZE] __attribute__((aligned(16)));
+};
+
+#endif /* The end of #ifndef _MAID_MATCHER_H_ */
+
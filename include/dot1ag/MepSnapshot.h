@@ -0,0 +1,167 @@
+/*
+ * @brief: State of a local MEP and its remote MEPs, published for readers
+ *         on other threads
+ *
+ *    Copyright (c) 2017
+ *    HCL Technologies Ltd.
+ *    All rights reserved.
+ *
+ * Created on March 7, 2017
+ */
+
+#ifndef _MEP_SNAPSHOT_H_
+#define _MEP_SNAPSHOT_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#include <atomic>
+using namespace std;
+
+#include "ieee8021ag.h"
+#include "IntervalStats.h"
+
+/*
+ * One writer, the thread owning the MEP, publishes the remote MEPs by their
+ * slot in the RMepStore; any number of readers copy them out. Each entry has
+ * a seqlock of its own: the writer never waits, and a reader retries the
+ * copy of an entry the writer was in the middle of.
+ *
+ * The entries are kept in pages of growing size, 8 << k entries for page k,
+ * never moved once allocated, so that a MEP with a couple of remote MEPs
+ * takes a few hundred bytes, and the readers can follow the pages without a
+ * lock while the writer adds some.
+ */
+class MepSnapshot {
+public:
+    static const uint32_t FIRST_PAGE_BITS = 3;
+    static const uint32_t PAGES = 11; /* 8 * (2^11 - 1) > MAX_MEPID */
+
+    struct Entry {
+        uint16_t mepid;
+        uint8_t state; /* RMepStore::RMEP_* */
+        uint8_t tlv_ps;
+        uint8_t tlv_is;
+        uint8_t mac[ETHER_ADDR_LEN];
+        uint32_t interval; /* us, of its CCM Interval field */
+        /* RMepStore::SeqStats */
+        uint32_t lastSeq;
+        uint32_t received;
+        uint32_t lost;
+        uint32_t gaps;
+        uint32_t duplicates;
+        uint32_t reorders;
+        uint64_t lastSeen; /* ms, of the last CCM accepted */
+        IntervalStats arrivals;
+    };
+
+    MepSnapshot();
+    ~MepSnapshot();
+
+    MepSnapshot(const MepSnapshot &) = delete;
+    MepSnapshot &operator=(const MepSnapshot &) = delete;
+
+    /* Writer only: publish the entry of slot */
+    void publish(uint32_t slot, const Entry &entry) {
+        Cell *cell = cellFor(slot);
+
+        if (cell == NULL) {
+            return;
+        }
+        store(*cell, &entry, sizeof (entry));
+
+        if (slot >= size_.load(memory_order_relaxed)) {
+            size_.store(slot + 1, memory_order_release);
+        }
+    };
+
+    /* Writer only: publish the intervals between the CCMs the MEP sent */
+    void publishTx(const IntervalStats &tx) {
+        store(tx_, &tx, sizeof (tx));
+    };
+
+    /*
+     * Writer only: publish the defects of the local MEP, and the priority
+     * of the defect its fault alarm reports, 0 for none
+     */
+    void publishDefects(uint8_t defects, uint8_t alarm) {
+        defects_.store(alarm << 8 | defects, memory_order_release);
+    };
+
+    /* The number of slots published, any thread */
+    uint32_t size() const {
+        return size_.load(memory_order_acquire);
+    };
+
+    uint8_t getDefects() const {
+        return defects_.load(memory_order_acquire) & 0xff;
+    };
+
+    uint8_t getAlarm() const {
+        return defects_.load(memory_order_acquire) >> 8;
+    };
+
+    /*
+     * Any thread: copy out a consistent image of the entry of slot, return
+     * EXIT_FAILURE if it has not been published
+     */
+    int read(uint32_t slot, Entry &entry) const;
+
+    /* Any thread: as read(), for what publishTx() published */
+    int readTx(IntervalStats &tx) const;
+
+    /* Bytes taken, for diagnostics */
+    size_t memoryUsage() const;
+
+private:
+    static const uint32_t WORDS = (sizeof (Entry) + 7) / 8;
+
+    struct Cell {
+        atomic<uint32_t> seq;
+        atomic<uint64_t> words[WORDS];
+    };
+
+    /* the page of slot, and the index in it */
+    static uint32_t pageOf(uint32_t slot, uint32_t &index) {
+        uint32_t k = 31 - __builtin_clz((slot >> FIRST_PAGE_BITS) + 1);
+
+        index = slot - (((1U << k) - 1) << FIRST_PAGE_BITS);
+        return k;
+    };
+
+    static uint32_t pageSize(uint32_t k) {
+        return 1U << (FIRST_PAGE_BITS + k);
+    };
+
+    /* Writer only: the cell of slot, allocating its page if need be */
+    Cell *cellFor(uint32_t slot);
+
+    /* Writer only: copy size bytes of data into the cell, under its seq */
+    static void store(Cell &cell, const void *data, size_t size) {
+        uint64_t words[WORDS];
+        uint32_t seq;
+
+        memset(words, 0, sizeof (words));
+        memcpy(words, data, size);
+
+        /* odd while the words are being changed */
+        seq = cell.seq.load(memory_order_relaxed);
+        cell.seq.store(seq + 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+        for (uint32_t i = 0; i < WORDS; i++) {
+            cell.words[i].store(words[i], memory_order_relaxed);
+        }
+        cell.seq.store(seq + 2, memory_order_release);
+    };
+
+    /* Copy a consistent image of the cell out, EXIT_FAILURE if never set */
+    static int load(const Cell &cell, void *data, size_t size);
+
+    atomic<Cell *> pages_[PAGES];
+    atomic<uint32_t> size_;
+    atomic<uint32_t> defects_;
+    Cell tx_;
+};
+
+#endif /* The end of #ifndef _MEP_SNAPSHOT_H_ */
+
@@ -0,0 +1,123 @@
+/*
+ * @brief: Monotonic time in ns, the time base of the timers
+ *
+ *    Copyright (c) 2017
+ *    HCL Technologies Ltd.
+ *    All rights reserved.
+ *
+ * Created on March 7, 2017
+ */
+
+#ifndef _MONO_TIME_H_
+#define _MONO_TIME_H_
+
+#include <stdint.h>
+#include <time.h>
+
+/*
+ * A point in time, or a span of it, in ns of CLOCK_MONOTONIC: setting the
+ * date, or NTP stepping it, does not move it, so no timer runs out early or
+ * late on that. 64 bits of ns last 584 years from the boot. The ms ticks of
+ * the timing wheels are msec() of it.
+ */
+class MonoTime {
+public:
+    static const uint64_t NSEC_PER_USEC = 1000ULL;
+    static const uint64_t NSEC_PER_MSEC = 1000000ULL;
+    static const uint64_t NSEC_PER_SEC = 1000000000ULL;
+
+    MonoTime() : ns_(0) {
+    }
+
+    explicit MonoTime(uint64_t ns) : ns_(ns) {
+    }
+
+    static MonoTime now() {
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return fromTimespec(ts);
+    };
+
+    static MonoTime fromTimespec(const struct timespec &ts) {
+        return MonoTime((uint64_t) ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec);
+    };
+
+    static MonoTime fromUsec(uint64_t us) {
+        return MonoTime(us * NSEC_PER_USEC);
+    };
+
+    static MonoTime fromMsec(uint64_t ms) {
+        return MonoTime(ms * NSEC_PER_MSEC);
+    };
+
+    uint64_t nsec() const {
+        return ns_;
+    };
+
+    uint64_t usec() const {
+        return ns_ / NSEC_PER_USEC;
+    };
+
+    uint64_t msec() const {
+        return ns_ / NSEC_PER_MSEC;
+    };
+
+    /* The first ms tick not before it, for a deadline not to fire early */
+    uint64_t msecCeil() const {
+        return (ns_ + NSEC_PER_MSEC - 1) / NSEC_PER_MSEC;
+    };
+
+    void toTimespec(struct timespec &ts) const {
+        ts.tv_sec = ns_ / NSEC_PER_SEC;
+        ts.tv_nsec = ns_ % NSEC_PER_SEC;
+    };
+
+    MonoTime operator+(const MonoTime &t) const {
+        return MonoTime(ns_ + t.ns_);
+    };
+
+    MonoTime operator-(const MonoTime &t) const {
+        return MonoTime(ns_ - t.ns_);
+    };
+
+    MonoTime &operator+=(const MonoTime &t) {
+        ns_ += t.ns_;
+        return *this;
+    };
+
+    MonoTime &operator-=(const MonoTime &t) {
+        ns_ -= t.ns_;
+        return *this;
+    };
+
+    bool operator==(const MonoTime &t) const {
+        return ns_ == t.ns_;
+    };
+
+    bool operator!=(const MonoTime &t) const {
+        return ns_ != t.ns_;
+    };
+
+    bool operator<(const MonoTime &t) const {
+        return ns_ < t.ns_;
+    };
+
+    bool operator<=(const MonoTime &t) const {
+        return ns_ <= t.ns_;
+    };
+
+    bool operator>(const MonoTime &t) const {
+        return ns_ > t.ns_;
+    };
+
+    bool operator>=(const MonoTime &t) const {
+        return ns_ >= t.ns_;
+    };
+
+private:
+    uint64_t ns_;
+};
+
+#endif /* The end of #ifndef _MONO_TIME_H_ */
+
@@ -14,6 +14,7 @@
 #include <string>
 #include <deque>
 #include <map>
+#include <atomic>
 using namespace std;
 
 #include <pcap.h>
@@ -22,10 +23,14 @@ using namespace std;
 #include "Dot1ag.h"
 #include "Runnable.h"
 #include "NetIfListener.h"
+#include "RxPolicer.h"
+#include "MonoTime.h"
 
 class NetIf : public Runnable {
 public:
     static const uint32_t WAKEUP = 20000;
+    static const uint32_t TX_BATCH = 64;
+    static const uint32_t RX_BUDGET = 64;
 
     NetIf(const char *ifname, string name = "NetIf");
 
@@ -33,6 +38,32 @@ public:
 
     pcap_t * setupPcap();
 
+    /*
+     * Open the RX channel, pcap with the CFM filter, non-blocking: return
+     * its fd to poll for the frames received, -1 on failure. By the thread
+     * receiving, RX or the one driving receive() itself.
+     */
+    int openRx();
+
+    /*
+     * Read the frames received so far, budget of them at most, without
+     * blocking: each is policed, answered by the LBR fast path or handed
+     * over to its listener, right in the calling thread. Return how many
+     * were read, budget if there may be more. With any read, late is set
+     * to the us from the reception of the first one to its reading: how
+     * late the thread came to it.
+     */
+    uint32_t receive(uint32_t budget, uint64_t *late = NULL);
+
+    /* How the RX thread is scheduled, to be set before start() */
+    void setRxSchedAttr(const SchedAttr &attr) {
+        this->rx->setSchedAttr(attr);
+    };
+
+    const Runnable &getRx() const {
+        return *this->rx;
+    };
+
     /* Anyone want to receive the ether packet need to call this func to register */
     int registerListener(uint16_t etherType, NetIfListener *listener);
 
@@ -41,25 +72,82 @@ public:
     };
     
     int sendPacket(Dot1ag *packet) {
-        return NetIf::sendPacket(this->ifname_, packet->getPacketData(),
-                packet->getPacketSize());
+        return transmit(packet->getPacketData(), packet->getPacketSize());
     }
+
+    /* Send the raw frame over the persistent TX channel, thread safe */
+    int transmit(const uint8_t *data, uint32_t size);
+
+    /*
+     * Send the frames in one go over the TX channel, TX_BATCH of them per
+     * sendmmsg() call, thread safe; return how many were sent
+     */
+    uint32_t transmitBatch(Dot1ag * const *packets, uint32_t count);
+
+    struct LbrFastPathStats {
+        uint64_t reflected; /* LBRs sent from the RX thread */
+        uint64_t rateLimited; /* LBMs dropped being over the rate */
+        uint64_t invalid; /* LBMs dropped not being valid for us */
+        uint64_t txErrors;
+    };
+
+    /*
+     * Answer LBMs by LBRs right in the RX thread, up to rate LBRs/s, with
+     * the LBM turned into the LBR in the receive buffer. 0 disables the
+     * fast path (default), LBMs are then handed over to the listener.
+     */
+    void setLbrFastPath(uint32_t rate, uint32_t burst);
+    void getLbrFastPathStats(LbrFastPathStats &stats) const;
+
+    /*
+     * Answer on the fast path the LBMs of vlan and MD level, those of an
+     * MA configured. The LBMs of any other pair are handed over to the
+     * listener, as the frames of the fast path turned off: the engine
+     * counts them with the frames of no MA and drops them, and the RX
+     * policer keeps them to the rate of the OAM frames. Thread safe.
+     */
+    void addLbrMa(uint16_t vlan, uint8_t level);
     
     const uint8_t *getLocalMac() const { return this->localMac; } 
+
+    /*
+     * The per source MAC and class policer applied before any frame is
+     * queued, the budget of the CCMs and R-APS set by the engine
+     */
+    RxPolicer &getPolicer() {
+        return this->policer_;
+    };
     
     /* For sending raw ether packet over the given dev in ifname */
     static int sendPacket(const char * ifname, uint8_t *data, uint32_t size);
     static int getSrcMac(uint8_t *ea, const char *dev);
     
-    static void updateTimeFromNow(struct timeval &tval, uint32_t sec, uint32_t usec) {
-        struct timeval now;
-        gettimeofday(&now, NULL);
-        tval.tv_sec = now.tv_sec + sec;
-        tval.tv_usec += now.tv_usec + usec;
-        if (tval.tv_usec >= 1000000) {
-            tval.tv_sec++;
-            tval.tv_usec %= 1000000;
-        }
+    /*
+     * The current time in ms, as the tick of the timing wheels and the
+     * deadlines of TimerService, and in us: MonoTime, which setting the
+     * date does not move
+     */
+    static uint64_t getTimeMsec() {
+        return MonoTime::now().msec();
+    }
+
+    static uint64_t getTimeUsec() {
+        return MonoTime::now().usec();
+    }
+
+    /* The date in us, as pcap stamps the frames received */
+    static uint64_t getDateUsec() {
+        struct timespec ts;
+
+        clock_gettime(CLOCK_REALTIME, &ts);
+        return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    }
+
+    /* Set time to sec and usec from now */
+    static void updateTimeFromNow(MonoTime &time, uint32_t sec, uint32_t usec) {
+        time = MonoTime::now() + MonoTime((uint64_t) sec *
+                MonoTime::NSEC_PER_SEC + (uint64_t) usec *
+                MonoTime::NSEC_PER_USEC);
     }
 
 protected:
@@ -68,10 +156,17 @@ protected:
     class RX : public Runnable {
     public:
 
-        RX(NetIf *netIf) : Runnable("RX"), netIf(netIf) {
+        RX(NetIf *netIf) : Runnable("RX - " + string(netIf->ifname_)),
+        netIf(netIf) {
             this->mutex_ = netIf->mutex_;
             this->cond_ = netIf->cond_;
         }
+
+        ~RX() {
+            /* borrowed from the NetIf, which frees them */
+            this->mutex_ = NULL;
+            this->cond_ = NULL;
+        }
         virtual void task();
     private:
         NetIf *netIf;
@@ -83,6 +178,13 @@ protected:
     /* add packets into the buffer, thread safe */
     int bufferPacket(Dot1ag *packet);
 
+    /*
+     * Return true if the frame is an LBM which has been consumed by the
+     * LBR fast path, being answered or dropped. Only called by the thread
+     * receiving.
+     */
+    bool reflectLbm(uint8_t *frame, uint32_t size, uint64_t nowUsec);
+
 
 
 private:
@@ -93,6 +195,28 @@ private:
 
     uint8_t localMac[ETHER_ADDR_LEN];
 
+    RxPolicer policer_;
+
+    /* The RX channel, once opened by openRx() */
+    pcap_t *pcap_;
+
+    /* The persistent TX channel, -1 if not available */
+    int txSock_;
+    int ifindex_;
+    int openTxChannel();
+
+    uint32_t lbrRate_;
+    uint64_t lbrBurst_;
+    TokenBucket lbrBucket_;
+
+    /* by VLAN, bit n set for the MD level n of an MA configured */
+    static const uint32_t LBR_VLANS = 4096;
+    atomic<uint8_t> lbrLevels_[LBR_VLANS];
+    atomic<uint64_t> lbrReflected_;
+    atomic<uint64_t> lbrRateLimited_;
+    atomic<uint64_t> lbrInvalid_;
+    atomic<uint64_t> lbrTxErrors_;
+
     RX *rx;
 
     friend ostream& operator<<(ostream& os, const NetIf& nif);
@@ -24,24 +24,74 @@ using namespace std;
 class NetIfListener : public Runnable {
 public:
 
+    /*
+     * RX classes, in the order of priority: R-APS beats CCM, which beats
+     * LBM/LBR/LTM/LTR, so that a loopback flood can't delay protection
+     * switching.
+     */
+    enum RxClass {
+        RX_RAPS = 0,
+        RX_CCM,
+        RX_LB_LT,
+        RX_OTHER,
+        RX_CLASS_MAX
+    };
+
+    /* Max frames queued per class, the excess is dropped */
+    static const uint32_t RX_QUEUE_DEPTH[RX_CLASS_MAX];
+
+    /*
+     * A non-empty class is served anyway once this many frames of higher
+     * classes have been served in front of it.
+     */
+    static const uint32_t RX_STARVATION_LIMIT = 32;
+
+    struct RxQueueStats {
+        uint32_t depth; /* frames currently queued */
+        uint32_t highWater; /* max depth seen */
+        uint64_t enqueued;
+        uint64_t dropped; /* dropped as the queue was full */
+        uint64_t starved; /* served by the starvation guard */
+    };
+
     NetIfListener(string name = "NetIf Listener");
 
     virtual ~NetIfListener();
 
-    int bufferPacket(Dot1ag *packet);
+    /*
+     * Queue the packet by its class, thread safe. The packet is deleted and
+     * EXIT_FAILURE returned if its queue is full.
+     */
+    virtual int bufferPacket(Dot1ag *packet);
+
+    static RxClass classifyPacket(const Dot1ag *packet);
+    static const char *rxClassName(int rxClass);
+
+    /* Copy out the counters of all the classes, thread safe */
+    void getRxQueueStats(RxQueueStats stats[RX_CLASS_MAX]) const;
 
 protected:
 
+    /*
+     * Return the next packet to process, NULL if nothing queued.
+     * Note: the caller must hold mutex_
+     */
+    Dot1ag *popPacket();
+
+    /* Frames queued over all classes, the caller must hold mutex_ */
+    uint32_t rxDepth() const;
+
     deque<Dot1ag *> txBuffer;
-    deque<Dot1ag *> rxBuffer;
+    deque<Dot1ag *> rxBuffer[RX_CLASS_MAX];
+    RxQueueStats rxStats[RX_CLASS_MAX];
 
+    /* frames of higher classes served while a class was waiting */
+    uint32_t rxSkipped[RX_CLASS_MAX];
 
 private:
 
     friend ostream& operator<<(ostream& os, const NetIfListener& nif);
 };
 
-
-
 #endif /* The end of #ifndef _NET_IF_LISTENER_H_ */
 
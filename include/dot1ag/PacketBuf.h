@@ -0,0 +1,91 @@
+/*
+ * @brief: Right-sized, move-only storage for Ether frames
+ *
+ *    Copyright (c) 2017
+ *    HCL Technologies Ltd.
+ *    All rights reserved.
+ *
+ * Created on March 7, 2017
+ */
+
+#ifndef _PACKET_BUF_H_
+#define _PACKET_BUF_H_
+
+#include <stdint.h>
+
+/*
+ * Frames up to INLINE_SIZE bytes (CCM, R-APS, LBM/LBR without Data TLV) are
+ * kept inline in the object, larger ones are moved to the heap on demand,
+ * never exceeding MAX_SIZE. Both start zero filled, as the frames are built
+ * over them. The buffer can only be moved; a deep copy has to be asked for
+ * explicitly via clone().
+ */
+class PacketBuf {
+public:
+    static const uint16_t INLINE_SIZE = 128;
+    static const uint16_t MAX_SIZE = 1516;
+
+    PacketBuf() : data_(inline_), size_(0), capacity_(INLINE_SIZE),
+    inline_() {
+    };
+
+    /* Copy len bytes of data in, truncated to MAX_SIZE */
+    PacketBuf(const uint8_t *data, uint32_t len);
+
+    PacketBuf(PacketBuf &&other);
+    PacketBuf &operator=(PacketBuf &&other);
+
+    PacketBuf(const PacketBuf &) = delete;
+    PacketBuf &operator=(const PacketBuf &) = delete;
+
+    ~PacketBuf();
+
+    /* The explicit deep copy */
+    PacketBuf clone() const {
+        return PacketBuf(data_, size_);
+    };
+
+    uint8_t *data() {
+        return data_;
+    };
+
+    const uint8_t *data() const {
+        return data_;
+    };
+
+    uint32_t size() const {
+        return size_;
+    };
+
+    uint32_t capacity() const {
+        return capacity_;
+    };
+
+    bool isInline() const {
+        return data_ == inline_;
+    };
+
+    /*
+     * Set the frame size to len, the bytes added are zero filled.
+     * Return EXIT_FAILURE if len is over MAX_SIZE.
+     */
+    int resize(uint32_t len);
+
+    /*
+     * Grow the frame by len zero filled bytes, return the start of the
+     * appended bytes or NULL if the frame would exceed MAX_SIZE.
+     * Note: pointers into the buffer are invalid after the call.
+     */
+    uint8_t *append(uint32_t len);
+
+private:
+    int reserve(uint32_t len);
+
+    uint8_t *data_;
+    uint16_t size_;
+    uint16_t capacity_;
+    uint8_t inline_[INLINE_SIZE];
+};
+
+#endif /* The end of #ifndef _PACKET_BUF_H_ */
+
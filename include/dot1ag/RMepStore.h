@@ -0,0 +1,271 @@
+/*
+ * @brief: Sparse store of the remote MEPs learnt from CCMs
+ *
+ *    Copyright (c) 2017
+ *    HCL Technologies Ltd.
+ *    All rights reserved.
+ *
+ * Created on March 7, 2017
+ */
+
+#ifndef _RMEP_STORE_H_
+#define _RMEP_STORE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <vector>
+using namespace std;
+
+#include "ieee8021ag.h"
+#include "TimerWheel.h"
+#include "IntervalStats.h"
+
+/*
+ * Only the remote MEPs actually heard of take a slot. The slots are dense,
+ * with the fields touched by every CCM or expiry check (state bits, sequence
+ * accounting, the last CCM accepted, inter-arrival statistics, the rMEPwhile
+ * timeout, and the deadline kept by the timing wheel with the slot as timer
+ * id) in arrays of their own, and the rest in a cold side table. MEPIDs
+ * map to slots through a two level index, with a page of 256 entries
+ * allocated for a range of MEPIDs only once one of them is used.
+ *
+ * Note: not thread safe, the owner serializes the calls.
+ */
+class RMepStore {
+public:
+    static const uint32_t NONE = 0xffffffff;
+    static const uint32_t PAGE_BITS = 8;
+    static const uint32_t PAGE_SIZE = 1 << PAGE_BITS;
+    static const uint32_t PAGES = (MAX_MEPID + PAGE_SIZE) / PAGE_SIZE;
+
+    /* state bits */
+    enum {
+        RMEP_ACTIVE = 0x01,
+        RMEP_CCM_RECEIVED_EQUAL = 0x02,
+        RMEP_CCM_DEFECT = 0x04, /* rMEPCCMdefect */
+        RMEP_RDI = 0x08, /* recvdRDI */
+        RMEP_INTERVAL_MISMATCH = 0x10, /* its CCM Interval is not ours */
+        RMEP_MAC_STATUS = 0x20 /* its port or interface is not up */
+    };
+
+    /* what the sequence number of a CCM received was, by trackSeq() */
+    enum {
+        SEQ_FIRST, /* or not numbered, 0 */
+        SEQ_IN_ORDER,
+        SEQ_GAP, /* some CCMs before it are missing */
+        SEQ_DUPLICATE,
+        SEQ_LATE, /* after a later one, one of the missing ones */
+        SEQ_RESTART /* so far back that the remote MEP has started over */
+    };
+
+    /*
+     * CCMs of a remote MEP arriving later than that many behind the last
+     * one are taken for a restart of the remote MEP, not a reorder
+     */
+    static const uint32_t REORDER_WINDOW = 63;
+
+    /* The sequence accounting of the CCMs of a remote MEP */
+    struct SeqStats {
+        uint32_t last; /* highest sequence number received */
+        uint32_t received;
+        uint32_t lost; /* missing in the gaps, less those arriving late */
+        uint32_t gaps;
+        uint32_t duplicates;
+        uint32_t reorders;
+        /* bit n: last - n received, to tell late ones from duplicates */
+        uint64_t window;
+    };
+
+    /* The fields not needed on every CCM */
+    struct Cold {
+        uint8_t recvdMacAddress[ETHER_ADDR_LEN];
+        uint8_t tlv_ps; /* TLV Port Status */
+        uint8_t tlv_is; /* TLV Interface Status */
+        uint32_t recvdInterval; /* us, of its CCM Interval field */
+
+        /* its events: as last reported, pending, and the flap dampening */
+        uint8_t reportedUp;
+        uint8_t pending;
+        uint8_t suppressed;
+        uint16_t transitions; /* since last reported */
+        uint32_t penalty;
+        uint64_t penaltyAt; /* ms */
+        uint64_t dueAt; /* ms, when pending */
+    };
+
+    RMepStore();
+    ~RMepStore();
+
+    RMepStore(const RMepStore &) = delete;
+    RMepStore &operator=(const RMepStore &) = delete;
+
+    /* Return the slot of the remote MEP, NONE if not known */
+    uint32_t find(uint16_t mepid) const {
+        const uint16_t *page;
+
+        if (mepid > MAX_MEPID) {
+            return NONE;
+        }
+        page = index_[mepid >> PAGE_BITS];
+        if (page == NULL || page[mepid & (PAGE_SIZE - 1)] == EMPTY) {
+            return NONE;
+        }
+        return page[mepid & (PAGE_SIZE - 1)];
+    };
+
+    /* Return the slot of the remote MEP, taking a new one if not known */
+    uint32_t insert(uint16_t mepid);
+
+    uint32_t size() const {
+        return mepid_.size();
+    };
+
+    uint16_t getMepid(uint32_t slot) const {
+        return mepid_[slot];
+    };
+
+    uint8_t &state(uint32_t slot) {
+        return state_[slot];
+    };
+
+    uint8_t state(uint32_t slot) const {
+        return state_[slot];
+    };
+
+    uint32_t lastSeq(uint32_t slot) const {
+        return seq_[slot].last;
+    };
+
+    const SeqStats &seqStats(uint32_t slot) const {
+        return seq_[slot];
+    };
+
+    /*
+     * Account the sequence number of a CCM of the remote MEP against the
+     * highest one so far and the window of those received just before it,
+     * O(1), and return SEQ_* of what it was. A remote MEP not numbering its
+     * CCMs sends 0, which is only counted.
+     */
+    int trackSeq(uint32_t slot, uint32_t seq) {
+        SeqStats &stats = seq_[slot];
+        int32_t ahead = (int32_t) (seq - stats.last);
+        uint64_t bit;
+
+        if (stats.received++ == 0 || seq == 0) {
+            stats.last = seq;
+            stats.window = 1;
+            return SEQ_FIRST;
+        }
+        if (ahead > 0) {
+            stats.window = ahead > (int32_t) REORDER_WINDOW ? 0 :
+                    stats.window << ahead;
+            stats.window |= 1;
+            stats.last = seq;
+            if (ahead == 1) {
+                return SEQ_IN_ORDER;
+            }
+            stats.lost += ahead - 1;
+            stats.gaps++;
+            return SEQ_GAP;
+        }
+        if ((uint32_t) -ahead <= REORDER_WINDOW) {
+            bit = 1ULL << -ahead;
+            if (stats.window & bit) {
+                stats.duplicates++;
+                return SEQ_DUPLICATE;
+            }
+            /* one of those counted lost, after all */
+            stats.window |= bit;
+            stats.reorders++;
+            if (stats.lost > 0) {
+                stats.lost--;
+            }
+            return SEQ_LATE;
+        }
+        stats.last = seq;
+        stats.window = 1;
+        return SEQ_RESTART;
+    };
+
+    /* rMEPwhile of the remote MEP, 3.5 times its own CCM interval, in ms */
+    uint32_t &timeout(uint32_t slot) {
+        return timeout_[slot];
+    };
+
+    /*
+     * The CCMs are kept up to that many bytes from the source MAC on, less
+     * the sequence number: longer ones are never taken for the last one
+     */
+    static const uint32_t MEMO_SIZE = 128;
+
+    /*
+     * true if the frame of size bytes is the CCM last kept for the remote
+     * MEP, byte for byte from the source MAC on, but for the len bytes at
+     * skip (the sequence number), with skip + len <= size. A steady stream
+     * of CCMs from a remote MEP is the same CCM over and over.
+     */
+    bool isLastCcm(uint32_t slot, const uint8_t *frame, uint32_t size,
+            uint32_t skip, uint32_t len) const {
+        const uint8_t *memo = &memo_[slot * MEMO_SIZE];
+        uint32_t head = skip - ETHER_ADDR_LEN;
+
+        return memoSize_[slot] != 0 &&
+                memoSize_[slot] == size - ETHER_ADDR_LEN - len &&
+                memcmp(memo, frame + ETHER_ADDR_LEN, head) == 0 &&
+                memcmp(memo + head, frame + skip + len,
+                size - skip - len) == 0;
+    };
+
+    /* Keep the CCM accepted for isLastCcm(), if not too long */
+    void keepCcm(uint32_t slot, const uint8_t *frame, uint32_t size,
+            uint32_t skip, uint32_t len);
+
+    /* The next CCM of the remote MEP takes the full parse */
+    void forgetCcm(uint32_t slot) {
+        memoSize_[slot] = 0;
+    };
+
+    /* The intervals between the CCMs of the remote MEP */
+    IntervalStats &arrivals(uint32_t slot) {
+        return arrivals_[slot];
+    };
+
+    Cold &cold(uint32_t slot) {
+        return cold_[slot];
+    };
+
+    const Cold &cold(uint32_t slot) const {
+        return cold_[slot];
+    };
+
+    /* The rMEPwhile timers, by slot, in ms */
+    TimerWheel &timers() {
+        return timers_;
+    };
+
+    /* Bytes taken by the store, for diagnostics */
+    size_t memoryUsage() const;
+
+private:
+    static const uint16_t EMPTY = 0xffff;
+
+    uint16_t *index_[PAGES];
+
+    /* hot, one entry per slot */
+    vector<uint16_t> mepid_;
+    vector<uint8_t> state_;
+    vector<SeqStats> seq_;
+    vector<uint32_t> timeout_;
+    vector<uint8_t> memoSize_; /* of the CCM kept, 0 for none */
+    vector<uint8_t> memo_; /* MEMO_SIZE bytes per slot */
+    vector<IntervalStats> arrivals_;
+    TimerWheel timers_;
+
+    /* cold */
+    vector<Cold> cold_;
+};
+
+#endif /* The end of #ifndef _RMEP_STORE_H_ */
+
@@ -11,10 +11,14 @@
 #ifndef _RUNNABLE_H_
 #define _RUNNABLE_H_
 
+#include <stdint.h>
+#include <sched.h>
+
 #include <string>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
+#include <atomic>
 using namespace std;
 
 class Runnable {
@@ -22,18 +26,99 @@ public:
 
     enum state { INIT, STARTED, STOPPED };
 
+    /*
+     * How the thread is scheduled, applied by the thread itself as it
+     * starts: the CPUs it may run on, none set for any, and its policy,
+     * SCHED_OTHER, or SCHED_FIFO or SCHED_RR with a priority of 1 to 99
+     * for it to preempt everything else on the box
+     */
+    struct SchedAttr {
+        cpu_set_t cpus;
+        int policy;
+        int priority;
+
+        SchedAttr() {
+            CPU_ZERO(&cpus);
+            policy = SCHED_OTHER;
+            priority = 0;
+        }
+    };
+
+    /*
+     * How late the thread ran after it was due, e.g. past its deadline or
+     * after the frame it woke up for was received, in us: log2 buckets,
+     * bucket k from 2^(k - 1) us up to 2^k, the last one from 16 ms on
+     */
+    static const uint32_t LATENCY_BUCKETS = 16;
+
+    struct LatencyStats {
+        uint64_t wakeups;
+        uint64_t lateSum;
+        uint64_t lateMax;
+        uint64_t buckets[LATENCY_BUCKETS];
+    };
+
     Runnable(string name = "Runnable");
-    
+
     virtual ~Runnable();
 
     int init();
     thread *start();
     int stop();
-    
+
     virtual void task() = 0;
-           
+
+    const string &getName() const {
+        return name_;
+    };
+
+    bool isStarted() const {
+        return state_ == STARTED;
+    };
+
+    /* To be set before start() */
+    void setSchedAttr(const SchedAttr &attr) {
+        sched_ = attr;
+    };
+
+    const SchedAttr &getSchedAttr() const {
+        return sched_;
+    };
+
+    /* Thread safe, as the thread runs */
+    void getLatencyStats(LatencyStats &stats) const;
+
+    /*
+     * Parse "cpus[:policy[:priority]]": cpus as "2", "2-3" or "0,2-3",
+     * empty for any; policy "other", "fifo" or "rr"; EXIT_FAILURE if
+     * malformed
+     */
+    static int parseSchedAttr(const char *spec, SchedAttr &attr);
+
+    /*
+     * Lock the pages of the process, now and to come, in memory: no page
+     * fault on them holds a thread up. For the whole process, once.
+     */
+    static int lockMemory();
+
+    static uint32_t latencyBucket(uint64_t us) {
+        uint32_t k = us == 0 ? 0 : 64 - __builtin_clzll(us);
+
+        return k < LATENCY_BUCKETS ? k : LATENCY_BUCKETS - 1;
+    };
+
 protected:
-    
+
+    /*
+     * Take the calling thread as the thread of this: name it after the
+     * Runnable and apply its SchedAttr. By start() in the new thread, or
+     * by a Runnable run in a thread it did not start.
+     */
+    void attach();
+
+    /* The thread ran late us after it was due, by the thread itself */
+    void accountLatency(uint64_t late);
+
     string name_;
     thread *thread_;
     mutex *mutex_;
@@ -41,8 +126,19 @@ protected:
     enum state state_;
 
     friend ostream& operator<<(ostream& os, const Runnable& r);
-    
+
+private:
+    SchedAttr sched_;
+
+    atomic<uint64_t> wakeups_;
+    atomic<uint64_t> lateSum_;
+    atomic<uint64_t> lateMax_;
+    atomic<uint64_t> buckets_[LATENCY_BUCKETS];
+
 };
 
+ostream& operator<<(ostream& os, const Runnable::SchedAttr& attr);
+ostream& operator<<(ostream& os, const Runnable::LatencyStats& stats);
+
 #endif /* The end of #ifndef _RUNNABLE_H_ */
 
@@ -0,0 +1,179 @@
+/*
+ * @brief: Per source MAC and class policer for the frames received
+ *
+ *    Copyright (c) 2017
+ *    HCL Technologies Ltd.
+ *    All rights reserved.
+ *
+ * Created on March 7, 2017
+ */
+
+#ifndef _RX_POLICER_H_
+#define _RX_POLICER_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <iostream>
+#include <mutex>
+#include <vector>
+using namespace std;
+
+#include "ieee8021ag.h"
+
+/*
+ * A token bucket counting in 1/1000000 of a frame, rate in frames/s
+ */
+struct TokenBucket {
+    uint64_t tokens;
+    uint64_t lastSeen; /* usec */
+
+    /* Return true if a token is taken for a frame received at nowUsec */
+    bool consume(uint32_t rate, uint64_t burst, uint64_t nowUsec) {
+        /* refill, a clock going backwards just restarts the accounting */
+        if (nowUsec > lastSeen) {
+            tokens += (nowUsec - lastSeen) * rate;
+            if (tokens > burst) {
+                tokens = burst;
+            }
+        }
+        lastSeen = nowUsec;
+
+        if (tokens >= 1000000) {
+            tokens -= 1000000;
+            return true;
+        }
+        return false;
+    };
+};
+
+/*
+ * Token bucket per source MAC and class of frames, kept in a fixed size open
+ * addressing hash table. Sources not seen for AGE_USEC are aged out and
+ * their slot reused. When all the slots a source hashes to are taken by
+ * active sources, it shares the overflow bucket of its class with the
+ * others in the same situation, so neither a single bad peer nor a MAC
+ * spoofing flood can starve the engine.
+ *
+ * The frames are classified first, so that a flood of LBMs or LTMs from a
+ * peer never takes the tokens of its CCMs, and the CCMs and R-APS have a
+ * budget of their own. It is derived from the MEPs configured, as the
+ * engine adds them: CONTROL_HEADROOM times the CCMs/s a peer sends with a
+ * MEP in each of their MAs, plus RAPS_RATE, in bursts of 100 ms of it. A
+ * peer with 1000 MEPs at 3.33 ms gets its 300000 CCMs/s through, while a
+ * looped neighbor replicating them, or a peer gone mad, is cut down to
+ * that budget instead of starving the engine.
+ *
+ * The LBMs, LTMs and their replies are policed at DEFAULT_RATE, the
+ * CCMs and R-APS as soon as a MEP is configured.
+ */
+class RxPolicer {
+public:
+    static const uint32_t TABLE_SIZE = 256; /* must be power of 2 */
+    static const uint32_t MAX_PROBE = 8;
+    static const uint64_t AGE_USEC = 60 * 1000000ULL;
+
+    /* Default: 5000 frames/s with a burst of 500 frames per source */
+    static const uint32_t DEFAULT_RATE = 5000;
+    static const uint32_t DEFAULT_BURST = 500;
+
+    /*
+     * The budget of the CCMs and R-APS of a source: the CCMs/s of the MEPs
+     * times the headroom, plus the R-APS/s, in bursts of 100 ms of it and
+     * CONTROL_BURST frames at least
+     */
+    static const uint32_t CONTROL_HEADROOM = 2;
+    static const uint32_t RAPS_RATE = 100;
+    static const uint32_t CONTROL_BURST = 64;
+
+    /* The classes of frames received, each policed on its own */
+    enum RxClass {
+        RX_CONTROL, /* CCM and R-APS, by the budget of the MEPs */
+        RX_OAM, /* LBM, LBR, LTM, LTR and the other CFM opcodes */
+        RX_OTHER, /* not CFM */
+        RX_CLASSES
+    };
+
+    struct SourceStats {
+        uint8_t mac[ETHER_ADDR_LEN];
+        RxClass rxClass;
+        uint64_t passed;
+        uint64_t policed;
+    };
+
+    RxPolicer(uint32_t rate = DEFAULT_RATE, uint32_t burst = DEFAULT_BURST);
+
+    /*
+     * rate in frames per second per source and class, 0 disables the
+     * policer. Thread safe: the RX thread takes the new rate at its next
+     * frame.
+     */
+    void setRate(uint32_t rate, uint32_t burst);
+
+    /*
+     * Add rate CCMs/s to the budget of the CCMs and R-APS, those a peer
+     * sends for a MEP configured. Thread safe, as setRate().
+     */
+    void addControlRate(uint32_t rate);
+
+    /*
+     * Set the budget of the CCMs and R-APS per source outright, 0 lifts
+     * it, for good: the MEPs added later no longer derive it. Thread safe.
+     */
+    void setControlRate(uint32_t rate, uint32_t burst);
+
+    bool isEnabled() const {
+        return rate_.load(memory_order_relaxed) != 0 ||
+                controlRate_.load(memory_order_relaxed) != 0;
+    };
+
+    /* The class of the frame of size bytes, from its tagging and opcode */
+    static RxClass classify(const uint8_t *frame, uint32_t size);
+
+    /*
+     * Return true if the frame of class rxClass from src should be
+     * accepted, false if it is over the rate and should be dropped. Only
+     * called from the RX thread.
+     */
+    bool admit(const uint8_t *src, RxClass rxClass, uint64_t nowUsec);
+
+    /* Copy out the counters of the sources in the table, thread safe */
+    void getStats(vector<SourceStats> &stats) const;
+
+    uint64_t getOverflowPoliced() const;
+
+private:
+
+    struct Bucket {
+        uint8_t mac[ETHER_ADDR_LEN];
+        uint8_t used;
+        uint8_t rxClass;
+        TokenBucket tb;
+        uint64_t passed;
+        uint64_t policed;
+    };
+
+    static uint32_t hashSource(const uint8_t *mac, RxClass rxClass);
+
+    bool consume(Bucket &b, uint32_t rate, uint64_t burst, uint64_t nowUsec);
+
+    /* read by the RX thread as it admits a frame, set by any */
+    atomic<uint32_t> rate_;
+    atomic<uint64_t> burst_; /* in 1/1000000 of a frame, as tokens */
+    atomic<uint32_t> controlRate_;
+    atomic<uint64_t> controlBurst_;
+
+    /* CCMs/s of the MEPs configured, under mutex_ */
+    uint64_t ccmRate_;
+    bool controlSet_; /* by setControlRate(), not derived */
+
+    Bucket table_[TABLE_SIZE];
+    Bucket overflow_[RX_CLASSES];
+
+    mutable mutex mutex_;
+
+    friend ostream& operator<<(ostream& os, const RxPolicer& p);
+};
+
+#endif /* The end of #ifndef _RX_POLICER_H_ */
+
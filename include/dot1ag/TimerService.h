@@ -0,0 +1,92 @@
+/*
+ * @brief: Tickless timer of a worker thread, on timerfd and eventfd
+ *
+ *    Copyright (c) 2017
+ *    HCL Technologies Ltd.
+ *    All rights reserved.
+ *
+ * Created on March 7, 2017
+ */
+
+#ifndef _TIMER_SERVICE_H_
+#define _TIMER_SERVICE_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <ostream>
+using namespace std;
+
+/*
+ * The thread owning it sleeps in wait() till the single deadline armed, an
+ * absolute time in ns of CLOCK_MONOTONIC as MonoTime::nsec(), or till
+ * another thread calls wake(), e.g. as it queues a packet. With nothing
+ * armed it sleeps till woken: no wakeup is spent on polling. The deadline
+ * is a timerfd set in absolute time, so that it does not drift with the
+ * time spent in between, and the wakeups are counted with how late they
+ * came in. A thread that does its own I/O has it watch its fd as well:
+ * it sleeps on it, the deadline and the wakeups all at once.
+ *
+ * Note: arm(), watch() and wait() by the owner only, wake() from any
+ * thread.
+ */
+class TimerService {
+public:
+    static const uint64_t NONE64 = 0xffffffffffffffffULL;
+
+    struct Stats {
+        uint64_t wakeups; /* returns from wait(), whatever woke it up */
+        uint64_t expirations; /* of them, by the deadline */
+        uint64_t lateSum; /* us past the deadline, over the expirations */
+        uint64_t lateMax;
+    };
+
+    TimerService();
+
+    virtual ~TimerService();
+
+    /* (Re-)arm the deadline, in ns, NONE64 to disarm */
+    int arm(uint64_t deadline);
+
+    uint64_t getDeadline() const {
+        return deadline_;
+    };
+
+    /* Have wait() return as well once fd is readable, -1 for none */
+    void watch(int fd) {
+        watchFd_ = fd;
+    };
+
+    /*
+     * Sleep till the deadline, a wake() or the fd watched is readable,
+     * return true for the deadline
+     */
+    bool wait();
+
+    /* Have wait() return, now or as soon as it is called */
+    void wake();
+
+    void getStats(Stats &stats) const;
+
+    /* us the last expiry came in past the deadline */
+    uint64_t getLastLate() const {
+        return lastLate_;
+    };
+
+private:
+    int timerFd_;
+    int wakeFd_;
+    int watchFd_; /* -1 if none */
+    uint64_t deadline_; /* armed in timerFd_, NONE64 if none */
+    uint64_t lastLate_;
+
+    atomic<uint64_t> wakeups_;
+    atomic<uint64_t> expirations_;
+    atomic<uint64_t> lateSum_;
+    atomic<uint64_t> lateMax_;
+};
+
+ostream& operator<<(ostream& os, const TimerService::Stats& stats);
+
+#endif /* The end of #ifndef _TIMER_SERVICE_H_ */
+
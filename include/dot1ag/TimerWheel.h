@@ -0,0 +1,114 @@
+/*
+ * @brief: Hierarchical timing wheel for deadline ordered expiry
+ *
+ *    Copyright (c) 2017
+ *    HCL Technologies Ltd.
+ *    All rights reserved.
+ *
+ * Created on March 7, 2017
+ */
+
+#ifndef _TIMER_WHEEL_H_
+#define _TIMER_WHEEL_H_
+
+#include <stdint.h>
+
+#include <vector>
+using namespace std;
+
+/*
+ * Timers are identified by an index in [0, capacity), e.g. a remote MEP id,
+ * and each index has at most one deadline pending. The time unit is a tick
+ * (1 ms by the callers), and LEVELS wheels of SLOTS slots each cover
+ * SLOTS^LEVELS ticks; later deadlines are parked at the far end and simply
+ * re-inserted when they come down to level 0.
+ *
+ * arm()/cancel() are O(1). advance() touches only the slots of the ticks
+ * passed, plus the timers cascading down from the higher levels, so its cost
+ * does not depend on how many timers are pending; the idle ticks in between
+ * are skipped, as a tickless caller sleeps through them.
+ *
+ * Note: not thread safe, the owner serializes the calls.
+ */
+class TimerWheel {
+public:
+    static const uint32_t NONE = 0xffffffff;
+    static const uint64_t NONE64 = 0xffffffffffffffffULL;
+    static const uint32_t SLOT_BITS = 6;
+    static const uint32_t SLOTS = 1 << SLOT_BITS;
+    static const uint32_t LEVELS = 4;
+    static const uint32_t OVERDUE = LEVELS * SLOTS;
+
+    TimerWheel(uint32_t capacity = 0, uint64_t now = 0);
+
+    /* Grow the number of timer ids, pending timers are kept */
+    void resize(uint32_t capacity);
+
+    uint32_t capacity() const {
+        return nodes_.size();
+    };
+
+    /*
+     * (Re-)arm timer id to expire at tick expires, a tick already passed
+     * makes it expire on the next advance()
+     */
+    void arm(uint32_t id, uint64_t expires);
+
+    void cancel(uint32_t id);
+
+    bool isArmed(uint32_t id) const {
+        return nodes_[id].slot != NONE;
+    };
+
+    uint64_t getExpiry(uint32_t id) const {
+        return nodes_[id].expires;
+    };
+
+    /*
+     * Move the time forward to tick now, and append the ids of the timers
+     * expired by then to expired. An expired timer is disarmed.
+     */
+    void advance(uint64_t now, vector<uint32_t> &expired);
+
+    /*
+     * A lower bound of the next tick advance() will have something to do,
+     * NONE64 if no timer is pending.
+     */
+    uint64_t nextExpiry() const;
+
+    /* The last tick advanced to */
+    uint64_t now() const {
+        return next_ - 1;
+    };
+
+    uint32_t pending() const {
+        return pending_;
+    };
+
+    size_t memoryUsage() const {
+        return sizeof (*this) + nodes_.capacity() * sizeof (Node);
+    };
+
+private:
+
+    struct Node {
+        uint64_t expires;
+        uint32_t prev;
+        uint32_t next;
+        uint32_t slot; /* level * SLOTS + index, NONE if not armed */
+    };
+
+    void link(uint32_t id);
+    void unlink(uint32_t id);
+    void cascade(uint32_t level, uint32_t index);
+    void rebase(uint64_t now, vector<uint32_t> &expired);
+
+    vector<Node> nodes_;
+    /* plus one list for the timers armed already overdue */
+    uint32_t head_[LEVELS * SLOTS + 1];
+    uint64_t next_; /* the next tick to be processed */
+    uint32_t pending_;
+};
+
+#endif /* The end of #ifndef _TIMER_WHEEL_H_ */
+
@@ -0,0 +1,158 @@
+/*
+ * @brief: Bounds checked walk over the TLVs of a CFM PDU
+ *
+ *    Copyright (c) 2017
+ *    HCL Technologies Ltd.
+ *    All rights reserved.
+ *
+ * Created on March 7, 2017
+ */
+
+#ifndef _TLV_ITERATOR_H_
+#define _TLV_ITERATOR_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "ieee8021ag.h"
+#include "FrameLayout.h"
+
+/*
+ * The walk is on the RX path of every CCM: inlined into it even in a build
+ * not optimized, where a call per TLV would cost more than the TLV itself
+ */
+#define TLV_INLINE inline __attribute__((always_inline))
+
+/*
+ * A TLV as found in the frame: the value is not copied, and only decoded by
+ * the get*() of its type when asked for. These return EXIT_FAILURE if the
+ * TLV is not of that type or its value is too short for it.
+ */
+struct CfmTlv {
+    uint8_t type;
+    uint16_t length;
+    const uint8_t *value;
+
+    /* Port Status TLV or Interface Status TLV */
+    TLV_INLINE int getStatus(uint8_t &status) const {
+        if ((type != TLV_PORT_STATUS && type != TLV_INTERFACE_STATUS) ||
+                length < 1) {
+            return EXIT_FAILURE;
+        }
+        status = value[0];
+        return EXIT_SUCCESS;
+    };
+
+    /* Sender ID TLV, chassisId is NULL if the Chassis ID Length is 0 */
+    int getSenderId(uint8_t &chassisIdSubtype, const uint8_t *&chassisId,
+            uint8_t &chassisIdLength) const;
+
+    /* Organization-Specific TLV */
+    int getOrgSpecific(uint32_t &oui, uint8_t &subtype, const uint8_t *&data,
+            uint16_t &dataLength) const;
+};
+
+/*
+ * Walks the TLVs of a CFM PDU up to the End TLV, never reading beyond the
+ * frame. It takes no copy nor allocation, so it can live on the stack of
+ * the RX path:
+ *
+ *     TlvIterator tlvs(frame, size);
+ *     CfmTlv tlv;
+ *     while (tlvs.next(tlv)) {
+ *         ...
+ *     }
+ *     if (tlvs.isMalformed()) {
+ *         ...
+ *     }
+ */
+class TlvIterator {
+public:
+
+    /* The TLVs in [first, end) */
+    TLV_INLINE TlvIterator(const uint8_t *first, const uint8_t *end) {
+        if (first == NULL || first > end) {
+            first = end;
+        }
+        init(first, end);
+    };
+
+    /* The TLVs of the CFM PDU in frame, from its First TLV Offset on */
+    TlvIterator(const uint8_t *frame, uint32_t size) {
+        const struct cfmhdr *cfmhdr;
+        const uint8_t *pdu;
+
+        init(frame + size, frame + size);
+        cfmhdr = frameCfmHdr(classifyFrame(frame, size), frame);
+        if (cfmhdr == NULL) {
+            return;
+        }
+        pdu = (const uint8_t *) cfmhdr + sizeof (struct cfmhdr);
+        if (cfmhdr->tlv_offset > end_ - pdu) {
+            return;
+        }
+        init(pdu + cfmhdr->tlv_offset, frame + size);
+    };
+
+    /*
+     * Return the next TLV in tlv, false once the End TLV is reached or if
+     * the TLV left would run over the end of the frame. The walk stops on
+     * the TLV it could not take, once and for all.
+     */
+    TLV_INLINE bool next(CfmTlv &tlv) {
+        /* the Type and Length fields, one bound for both */
+        if (p_ >= lastHdr_) {
+            return false;
+        }
+        tlv.type = p_[0];
+        /* End TLV has the Type field only */
+        if (tlv.type == TLV_END) {
+            return false;
+        }
+        tlv.length = (p_[1] << 8) | p_[2];
+        tlv.value = p_ + TLV_HDR_SIZE;
+        if ((size_t) (end_ - tlv.value) < tlv.length) {
+            return false;
+        }
+        p_ = tlv.value + tlv.length;
+        return true;
+    };
+
+    /* true once the End TLV is reached, next() returning false */
+    TLV_INLINE bool isDone() const {
+        return p_ < end_ && p_[0] == TLV_END;
+    };
+
+    /*
+     * true if the TLVs ran over the end of the frame, once next() has
+     * returned false
+     */
+    TLV_INLINE bool isMalformed() const {
+        return !isDone();
+    };
+
+    /*
+     * Walk all the TLVs, return EXIT_SUCCESS if they end with an End TLV
+     * within the frame
+     */
+    static int validate(const uint8_t *frame, uint32_t size);
+
+private:
+    /* Type and Length */
+    static const size_t TLV_HDR_SIZE = 1 + sizeof (uint16_t);
+
+    TLV_INLINE void init(const uint8_t *first, const uint8_t *end) {
+        p_ = first;
+        end_ = end;
+        /* no TLV header fits from there on, an End TLV may */
+        lastHdr_ = (size_t) (end - first) >= TLV_HDR_SIZE ?
+                end - TLV_HDR_SIZE + 1 : first;
+    };
+
+    const uint8_t *p_; /* the TLV next, or the one the walk stopped on */
+    const uint8_t *end_;
+    const uint8_t *lastHdr_;
+};
+
+#endif /* The end of #ifndef _TLV_ITERATOR_H_ */
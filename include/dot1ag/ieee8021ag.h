@@ -51,12 +51,6 @@
 #include <net/if_ether.h>
 #endif
 
-/* compare timevals a to b using the comparison operator given in cmp */
-#define cfm_timevalcmp(a, b, cmp)               \
-        ((a.tv_sec == b.tv_sec) ?       \
-        (a.tv_usec cmp b.tv_usec) :     \
-        (a.tv_sec cmp b.tv_sec))
-
 #define ETYPE_8021Q     0x8100
 #define ETYPE_CFM       0x8902
 
@@ -215,6 +209,10 @@ struct cfm_tid {
 /* return the MD Level in a struct cfmhdr */
 #define GET_MD_LEVEL(s)         (((s)->octet1.md_level >> 5) & 0x07)
 
+/* CCM Flags: RDI, and the CCM Interval in the low order 3 bits */
+#define DOT1AG_CCFLAGS_RDI      0x80
+#define GET_CCM_INTERVAL(s)     ((s)->flags & 0x07)
+
 /* positions of headers in Ethernet frame */
 #define IS_TAGGED(s)            (*(s + ETHER_ADDR_LEN * 2) \
                                         == htons(ETYPE_8021Q))
@@ -370,7 +368,7 @@ struct rMEP {
         uint8_t recvdMacAddress[ETHER_ADDR_LEN];
         int recvdRDI;
         int rMEPCCMdefect;
-        struct timeval rMEPwhile;
+        uint64_t rMEPwhile;     /* ns of CLOCK_MONOTONIC, as MonoTime */
         int recvdInterval;
         int tlv_ps;   /* TLV Port Status */
         int tlv_is;   /* TLV Interface Status */
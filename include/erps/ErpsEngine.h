@@ -14,6 +14,9 @@
 #include <string>
 #include <deque>
 #include <map>
+#include <vector>
+#include <iomanip>
+#include <atomic>
 using namespace std;
 
 #include <pcap.h>
@@ -24,143 +27,720 @@ using namespace std;
 #include "dot1ag/Dot1agCcm.h"
 #include "dot1ag/Dot1agRAps.h"
 #include "dot1ag/Dot1agLbm.h"
-
-/*
- * To-do: using SIGALARM for scheduling periodically sending CCM/LBM messages 
- * The global variables used for timer signal
- */
-static uint32_t nextLBMtransID;
-static int next_packet;
-static int count; /* default is to send five LBMs */
+#include "dot1ag/Dot1agLtm.h"
+#include "dot1ag/RMepStore.h"
+#include "dot1ag/MaidMatcher.h"
+#include "dot1ag/MaDemux.h"
+#include "dot1ag/TimerWheel.h"
+#include "dot1ag/MepSnapshot.h"
+#include "dot1ag/EventLog.h"
+#include "dot1ag/TimerService.h"
+#include "dot1ag/CfmTransaction.h"
 
 class ErpsEngine : public NetIfListener {
 private:
 
-    /* Inner class used for sending CCMs and LBMs continually */
-    class TaskCfm : public Runnable {
-    public:
-
-        TaskCfm(ErpsEngine *engine) : erpsEngine(engine), Runnable("Task Cfm") {
-            this->mutex_ = new mutex();
-        }
-
-        ~TaskCfm() {
-            /* Note: mutex and cond_ have been taken care of by Runnable */
-        }
-
-        virtual void task();
+    NetIf *netIf0_;
+    NetIf *netIf1_;
 
-        void setInterval(int interval) {
-            CCMinterval = interval;
+    struct MaCfg;
+    class Shard;
+
+    /* A local MEP, with its own CCM, remote MEPs and defects */
+    struct MepCfg {
+        /* the defects, bit n - 1 for the one of priority n */
+        enum {
+            DEFECT_RDI_CCM = 0x01, /* someRDIdefect */
+            DEFECT_MAC_STATUS = 0x02, /* someMACstatusDefect */
+            DEFECT_REMOTE_CCM = 0x04, /* someRMEPCCMdefect */
+            DEFECT_ERROR_CCM = 0x08, /* errorCCMdefect */
+            DEFECT_XCON_CCM = 0x10, /* xconCCMdefect */
+            /* presentRDI, set in the CCMs we send */
+            DEFECTS_RDI = DEFECT_MAC_STATUS | DEFECT_REMOTE_CCM |
+            DEFECT_ERROR_CCM | DEFECT_XCON_CCM
         };
 
-        void setSkips(int skips) {
-            CCMSkips = skips;
+        /* the states of the Fault Notification Generator */
+        enum {
+            FNG_RESET,
+            FNG_DEFECT,
+            FNG_REPORTED,
+            FNG_CLEARING
         };
-    private:
-        ErpsEngine *erpsEngine;
-        int CCMinterval;
-        int CCMSkips;
-    };
 
+        Dot1agAttr attr; /* of its MA, but for the MEPID */
+        MaCfg *ma;
+        uint32_t index; /* in the MEPs of its shard, the id of its timers */
 
-    TaskCfm *taskCfm;
+        /* NULL for a MEP only listening, not sending CCMs */
+        Dot1agCcm *dot1agCcm;
+        uint32_t ccmSeq; /* of the last CCM sent */
+        MonoTime nextTx; /* in ns, for 3.33 ms to add up */
+        MonoTime txPhase; /* of its CCMs, into their interval */
+        uint32_t ccmInterval; /* us, as in the CCM Interval field we send */
+        IntervalStats txIntervals; /* between the CCMs sent, in us */
+
+        /*
+         * mac database, and updated by tracking CCMs received, with the
+         * rMEPwhile timers in ms
+         */
+        RMepStore rMEPdb;
+        vector<uint32_t> rMEPexpired;
+        uint32_t rMEPdown; /* remote MEPs in rMEPCCMdefect */
+        uint32_t rMEPmismatch; /* remote MEPs sending another interval */
+        uint32_t rMEPrdi; /* remote MEPs with recvdRDI */
+        uint32_t rMEPmacStatus; /* remote MEPs with their MAC not up */
+        uint64_t errorCCMwhile; /* ms, the errorCCMdefect lasts till then */
+        uint64_t xconCCMwhile; /* ms, the xconCCMdefect lasts till then */
+        uint8_t defects;
+
+        /*
+         * the remote MEPs with transitions to report, the first of them
+         * due at eventAt
+         */
+        vector<uint32_t> eventSlots;
+        uint64_t eventAt;
+
+        /* the fault alarm, of the defect of priority fngPriority */
+        uint8_t fngState;
+        uint8_t fngPriority;
+        uint64_t fngWhile; /* ms, 0 when not running */
+
+        /* the remote MEPs and defects above, as the readers see them */
+        MepSnapshot view;
+
+        /* no rMEPwhile timer runs out before this tick, as checkTimers */
+        uint64_t checkAt;
+
+        MepCfg(const Dot1agAttr *a, MaCfg *m) : attr(*a), ma(m), rMEPdb() {
+            index = 0;
+            dot1agCcm = NULL;
+            ccmSeq = 0;
+            ccmInterval = Dot1agCcm::decodeInterval(
+                    Dot1agCcm::encodeInterval(attr.CCMinterval));
+            if (ccmInterval == 0) {
+                /* 1 s, as Dot1agCcm sends then */
+                ccmInterval = Dot1agCcm::decodeInterval(4);
+            }
+            rMEPdown = 0;
+            rMEPmismatch = 0;
+            rMEPrdi = 0;
+            rMEPmacStatus = 0;
+            errorCCMwhile = 0;
+            xconCCMwhile = 0;
+            defects = 0;
+            fngState = FNG_RESET;
+            fngPriority = 0;
+            fngWhile = 0;
+            eventAt = TimerWheel::NONE64;
+            checkAt = TimerWheel::NONE64;
+            txIntervals.reset();
+        }
 
-    NetIf *netIf0_;
-    NetIf *netIf1_;
+        ~MepCfg() {
+            delete dot1agCcm;
+        }
+    };
 
-    /* The internal configuration data structure */
-    struct NetIfCfg {
-        const Dot1agAttr *dot1agAttr;
-        Dot1agCcm *dot1agCcm;
+    /*
+     * The context of a maintenance association, by its VLAN and MD level.
+     * Only ever touched by the thread of its shard once started.
+     */
+    struct MaCfg {
+        Dot1agAttr dot1agAttr;
+        MaidMatcher maidMatcher;
         Dot1agRAps *dot1agRAps;
         Dot1agLbm *dot1agLbm;
-        /* mac database, and updated by tracking CCMs received. */
-        struct rMEP rMEPdb[MAX_MEPID + 1];
+        Dot1agLtm *dot1agLtm;
+        Shard *shard;
 
-        NetIfCfg() {
-            dot1agAttr = NULL;
-            dot1agCcm = NULL;
+        /* the local MEPs, all fed with the CCMs received for the MA */
+        vector<MepCfg *> meps;
+
+        /*
+         * by processCcm(), of the CCM at hand: the local MEPs it refreshed
+         * the short way, not to be counted again on the full path
+         */
+        vector<uint8_t> refreshed;
+
+        /* the last LBM went unanswered, logged once till an LBR is back */
+        bool lbrLost;
+
+        MaCfg(const Dot1agAttr *attr) : dot1agAttr(*attr) {
             dot1agRAps = NULL;
             dot1agLbm = NULL;
+            dot1agLtm = NULL;
+            shard = NULL;
+            lbrLost = false;
+        }
+
+        ~MaCfg() {
+            for (size_t i = 0; i < meps.size(); i++) {
+                delete meps[i];
+            }
+            delete dot1agRAps;
+            delete dot1agLbm;
+            delete dot1agLtm;
         }
     };
 
-    NetIfCfg netIf0Cfg_;
+    /*
+     * A worker thread owning a share of the MAs with all their MEPs: it
+     * serves the frames steered to it, sends their CCMs and checks their
+     * rMEPwhile timers, and runs the coroutines of their LBMs and LTMs, so
+     * that the state of an MA is never shared between threads and takes no
+     * lock.
+     */
+    class Shard : public NetIfListener {
+    public:
 
-    int configNetIf(NetIfCfg *cfg, const Dot1agAttr *attr);
+        Shard(ErpsEngine *engine, uint32_t id);
 
-    void sendDot1agPacket(Dot1ag *dot1ag, uint32_t seq);
+        ~Shard() {
+            /* Note: mutex and cond_ have been taken care of by Runnable */
+        }
+
+        /* Queue the packet, and wake the shard up if it is asleep */
+        virtual int bufferPacket(Dot1ag *packet);
+
+        virtual void task();
+
+        ErpsEngine *erpsEngine;
+        uint32_t id;
+
+        /*
+         * The local MEPs of the shard, with their next CCM to send, in
+         * TX_TICK_NSEC ticks, and the next tick one of their rMEPwhile
+         * timers may run out, in ms, by index: a round only looks at the
+         * MEPs due, however many are configured.
+         */
+        vector<MepCfg *> meps;
+        TimerWheel txTimers;
+        vector<uint32_t> txDue;
+        TimerWheel checkTimers;
+        vector<uint32_t> checkDue;
+
+        /* the frames of the TX tick, sent together */
+        vector<Dot1ag *> txBatch;
+
+        /*
+         * The CCMs/s of its MEPs, and the most CCMs a TX tick sends, twice
+         * their share of a tick: a round that overran finds many more due
+         * at once, the most late of them go first and the others a tick
+         * later, so that the burst does not make the next round overrun.
+         * A MEP is only put off as far as TX_GAP_MAX allows it.
+         */
+        uint64_t txRate;
+        uint32_t txBurst;
+
+        /*
+         * The LBMs and LTMs outstanding of its MAs, matched with their
+         * replies by Transaction ID, and the coroutines awaiting them
+         */
+        TransactionTable transactions;
+
+        /*
+         * The first deadline of the wheels and of the transactions, in ns,
+         * NONE64 for none
+         */
+        uint64_t nextDeadline() const;
+
+        /*
+         * Sleeps till the first deadline of the wheels above or a packet:
+         * asleep is set under mutex_ once the queues are found empty, so a
+         * packet queued after that wakes the shard up.
+         */
+        TimerService timer;
+        atomic<bool> asleep;
+
+        /*
+         * CCMs sent, the times a MEP fell a whole interval behind or was
+         * put off to the next tick, and the TX ticks with frames to send,
+         * with the most frames of one
+         */
+        atomic<uint64_t> ccmsSent;
+        atomic<uint64_t> txSlips;
+        atomic<uint64_t> txDeferred; /* over the burst of a tick */
+        atomic<uint64_t> txBatches;
+        atomic<uint32_t> txBatchMax;
+
+        /*
+         * The frames served, and how long it took from their reception, as
+         * pcap stamped it, to their state taken in, in us: log2 buckets as
+         * the latencies of the threads
+         */
+        atomic<uint64_t> rxFrames;
+        atomic<uint64_t> rxLatencySum;
+        atomic<uint64_t> rxLatencyMax;
+        atomic<uint64_t> rxLatency[LATENCY_BUCKETS];
+    };
+
+    /*
+     * The phases of the CCMs in their interval, 2^TX_PHASE_BITS of them:
+     * the MEPs at an interval wake a shard up that many times an interval
+     * at most, however many they are
+     */
+    static const uint32_t TX_PHASE_BITS = 6;
 
-    void printRMEPState(const struct rMEP *rMEPdb, int rMEPid, const char *state) const {
-        cout << endl << endl;
-        cout << " rMEPid: " << rMEPid << " and mac: 0x" << hex << setfill('0') << setw(2) <<
-                (unsigned int) rMEPdb[rMEPid].recvdMacAddress[0] << ":" <<
-                (unsigned int) rMEPdb[rMEPid].recvdMacAddress[1] << ":" <<
-                (unsigned int) rMEPdb[rMEPid].recvdMacAddress[2] << ":" <<
-                (unsigned int) rMEPdb[rMEPid].recvdMacAddress[3] << ":" <<
-                (unsigned int) rMEPdb[rMEPid].recvdMacAddress[4] << ":" <<
-                (unsigned int) rMEPdb[rMEPid].recvdMacAddress[5] << " is " << state <<
-                endl << endl;
-        ;
+    /* The first TX tick not before t */
+    static uint64_t txTick(const MonoTime &t) {
+        return (t.nsec() + TX_TICK_NSEC - 1) / TX_TICK_NSEC;
     }
 
-    int checkRMEPdb(NetIfCfg &cfg) {
-        struct timeval now;
-        int status = EXIT_SUCCESS;
-        gettimeofday(&now, NULL);
-        /* has one of the remote MEP timers run out? */
-        for (int i = 1; i <= MAX_MEPID; i++) {
-            if (cfg.rMEPdb[i].active == 0) {
-                continue;
+    /*
+     * The MEPs set up so far by CCM interval (us), for the phase of the
+     * next one in its interval
+     */
+    map<uint32_t, uint32_t> txPhases_;
+
+    /*
+     * The MAs, indexed by maDemux_ with the VLAN and MD level received, and
+     * the shards they are spread over. Set up before startService(), only
+     * read afterwards.
+     */
+    vector<MaCfg *> mas_;
+    MaDemux maDemux_;
+    vector<Shard *> shards_;
+
+    int verbose_;
+
+    /*
+     * The frames are processed as they are received, in the thread of
+     * runToCompletion(), rather than queued to the shards
+     */
+    bool inline_;
+
+    /* a CCM the same as the last one of its remote MEP skips the parse */
+    bool ccmMemo_;
+
+    /* The shard to serve the packet received, by its MA if any */
+    uint32_t steer(const Dot1ag *dot1ag) const {
+        const struct cfmhdr *cfmhdr;
+        uint32_t ma;
+
+        if (shards_.size() == 1) {
+            return 0;
+        }
+        cfmhdr = dot1ag->getCfmHdr();
+        if (cfmhdr != NULL) {
+            ma = maDemux_.lookup(dot1ag->getVlan(), GET_MD_LEVEL(cfmhdr));
+            /* a CCM of a lower level goes to the MA it leaks into */
+            if (ma == MaDemux::NONE && cfmhdr->opcode == CFM_CCM) {
+                ma = maDemux_.lookupAbove(dot1ag->getVlan(),
+                        GET_MD_LEVEL(cfmhdr));
             }
-            /* send log entry on UP to DOWN transition */
-            if (cfm_timevalcmp(cfg.rMEPdb[i].rMEPwhile, now, <) &&
-                    (cfg.rMEPdb[i].rMEPCCMdefect == 0)) {
-                this->printRMEPState(cfg.rMEPdb, i, "DOWN");
-                cfg.rMEPdb[i].rMEPCCMdefect = 1;
-                status = EXIT_FAILURE;
+            if (ma != MaDemux::NONE) {
+                return mas_[ma]->shard->id;
             }
         }
-        return status;
+        /* of no MA of ours, e.g. LBMs: spread by VLAN */
+        return dot1ag->getVlan() % shards_.size();
+    };
+
+    /* Schedule the check of the rMEPwhile timers of the MEP */
+    void scheduleCheck(MepCfg &mep, uint64_t checkAt) {
+        mep.checkAt = checkAt;
+        if (checkAt != TimerWheel::NONE64) {
+            mep.ma->shard->checkTimers.arm(mep.index, checkAt);
+        }
+    }
+
+    MaCfg *addMa(const Dot1agAttr *attr);
+
+    int configMa(MaCfg *cfg, const Dot1agAttr *attr);
+
+    /* The MA of the packet received, NULL (and counted) if none */
+    MaCfg *demuxMa(const Dot1ag *dot1ag) {
+        const struct cfmhdr *cfmhdr = dot1ag->getCfmHdr();
+        uint32_t ma;
+
+        if (cfmhdr == NULL) {
+            return NULL;
+        }
+        ma = maDemux_.demux(dot1ag->getVlan(), GET_MD_LEVEL(cfmhdr));
+        return ma == MaDemux::NONE ? NULL : mas_[ma];
+    };
+
+    /*
+     * The MA of ours a CCM of an unknown VLAN and MD level leaks into, on
+     * its VLAN at a higher level, NULL if none
+     */
+    MaCfg *xconMa(const Dot1ag *dot1ag) {
+        uint32_t ma = maDemux_.lookupAbove(dot1ag->getVlan(),
+                GET_MD_LEVEL(dot1ag->getCfmHdr()));
+
+        return ma == MaDemux::NONE ? NULL : mas_[ma];
+    };
+
+    /*
+     * The phase of the next MEP sending every interval (us), into the
+     * interval, so that the CCMs of the MEPs at an interval go out evenly
+     * spread over it rather than all at once
+     */
+    MonoTime txPhase(uint32_t interval);
+
+    /* The first CCM of the MEP from now on, at its phase */
+    static MonoTime firstTx(const MepCfg &mep, const MonoTime &now);
+
+    /* Number the frame seq and queue it to the TX tick of the shard */
+    void queueDot1agPacket(Shard &shard, Dot1ag *dot1ag, uint32_t seq,
+            int verbose = 1);
+
+    /*
+     * Lay the CCMs of all the MEPs out from now on, at their phase: setting
+     * up thousands of MEPs may take longer than an interval, which would
+     * find them all due at once
+     */
+    void startTx(const MonoTime &now);
+
+    /*
+     * Start the coroutines sending the LBMs and LTMs of the MAs, in the
+     * thread of their shard from the first round on
+     */
+    void startTransactions();
+
+    /*
+     * Send an LBM of the MA every interval ms, each awaiting its LBR on
+     * its own, so that a slow or lost LBR holds none of the next LBMs up
+     */
+    CfmTask loopback(MaCfg &ma, uint32_t interval);
+
+    /* One LBM of the MA, and its LBR or the timeout */
+    CfmTask ping(MaCfg &ma);
+
+    /*
+     * Trace the route to the target of the MA over and over: an LTM, then
+     * the LTRs of every hop up to the timeout
+     */
+    CfmTask linktrace(MaCfg &ma);
+
+    /* Process the packet for the shard, account its latency and free it */
+    void serve(Shard &shard, Dot1ag *dot1ag);
+
+    /* Send the frames of the TX tick of the shard, all in one go */
+    void flushTx(Shard &shard);
+
+    /* Queue the CCM of the MEP due, and schedule the next one */
+    void sendCcm(MepCfg &mep, const MonoTime &now);
+
+    /*
+     * More MEPs due now than the burst of the shard: keep the most late in
+     * its txDue, and put the others off to the next ticks
+     */
+    void deferTx(Shard &shard, const MonoTime &now);
+
+    /* Publish the remote MEP as it is now to the readers of the MEP */
+    void publishRMep(MepCfg &mep, uint32_t slot, uint64_t lastSeen) {
+        MepSnapshot::Entry entry;
+        const RMepStore::Cold &cold = mep.rMEPdb.cold(slot);
+        const RMepStore::SeqStats &seq = mep.rMEPdb.seqStats(slot);
+
+        entry.mepid = mep.rMEPdb.getMepid(slot);
+        entry.state = mep.rMEPdb.state(slot);
+        entry.tlv_ps = cold.tlv_ps;
+        entry.tlv_is = cold.tlv_is;
+        memcpy(entry.mac, cold.recvdMacAddress, ETHER_ADDR_LEN);
+        entry.lastSeq = seq.last;
+        entry.received = seq.received;
+        entry.lost = seq.lost;
+        entry.gaps = seq.gaps;
+        entry.duplicates = seq.duplicates;
+        entry.reorders = seq.reorders;
+        entry.interval = cold.recvdInterval;
+        entry.lastSeen = lastSeen;
+        entry.arrivals = mep.rMEPdb.arrivals(slot);
+        mep.view.publish(slot, entry);
+    }
+
+    /* (Re-)arm rMEPwhile of the remote MEP, as of its own CCM interval */
+    void armRMep(MepCfg &mep, uint32_t slot, uint64_t now) {
+        uint64_t expires = now + mep.rMEPdb.timeout(slot);
+
+        mep.rMEPdb.timers().arm(slot, expires);
+        if (expires < mep.checkAt) {
+            this->scheduleCheck(mep, expires);
+        }
+    }
+
+    /*
+     * Take the CCM of a remote MEP in, received at nowUsec, its TLVs parsed
+     * already, its CCM interval decoded, in us, and its RDI flag; the frame
+     * of size bytes is kept for the next one alike, but for the sequence
+     * number at seqOffset
+     */
+    void updateRMep(MepCfg &mep, uint16_t rMEPid, const uint8_t *srcmac,
+            int tlv_ps, int tlv_is, uint32_t interval, bool rdi,
+            uint32_t seq, const uint8_t *frame, uint32_t size,
+            uint32_t seqOffset, uint64_t nowUsec);
+
+    /* rMEPwhile and the like: 3.5 times interval (us), in ms rounded up */
+    static uint64_t ccmWhile(uint32_t interval) {
+        return ((uint64_t) interval * 35 / 10 + 999) / 1000;
+    }
+
+    /*
+     * Set or clear the state bit of the remote MEP, counting the remote
+     * MEPs with it set in count; return whether it changed
+     */
+    static bool setRMepBit(RMepStore &rMEPdb, uint32_t slot, uint8_t bit,
+            bool set, uint32_t &count) {
+        uint8_t &state = rMEPdb.state(slot);
+
+        if (set == ((state & bit) != 0)) {
+            return false;
+        }
+        if (set) {
+            state |= bit;
+            count++;
+        } else {
+            state &= ~bit;
+            count--;
+        }
+        return true;
     }
 
     /*
-     * To-do: using SIGALARM for scheduling periodically sending CCM/LBM messages 
+     * A CCM in error (DEFECT_ERROR_CCM) or of another MA (DEFECT_XCON_CCM)
+     * received for the MA: the defect lasts 3.5 times its interval (us)
+     * for all the MEPs of the MA
      */
-    void scheduleTimer();
+    void raiseCcmDefect(MaCfg &cfg, uint8_t defect, uint32_t interval,
+            uint64_t now);
 
-    static void timeout_handler(int sig) {
-        next_packet = 1;
-        count--;
-        nextLBMtransID++;
-        cout << endl << "Timeout: thread_id: " << this_thread::get_id() << endl;
+    /*
+     * Work the defects of the MEP out again at now, run its fault alarm and
+     * schedule the check of the defect timers
+     */
+    void updateDefects(MepCfg &mep, uint64_t now);
+
+    /* Post the event of the MEP, of its remote MEP rMEPid if not 0 */
+    void postEvent(const MepCfg &mep, uint16_t rMEPid, uint8_t type,
+            uint32_t arg, uint32_t count, uint64_t now) {
+        EventLog::Event event;
+
+        event.time = now;
+        event.arg = arg;
+        event.count = count;
+        event.vlan = mep.attr.vlan;
+        event.mepid = mep.attr.mepid;
+        event.rMEPid = rMEPid;
+        event.type = type;
+        events_.post(mep.ma->shard->id, event);
+    }
+
+    /* Decay the flap penalty of the remote MEP to now */
+    static void decayPenalty(RMepStore::Cold &cold, uint32_t halfLife,
+            uint64_t now) {
+        if (now > cold.penaltyAt && cold.penalty > 0) {
+            cold.penalty = cold.penalty *
+                    exp2(-(double) (now - cold.penaltyAt) / halfLife);
+        }
+        cold.penaltyAt = now;
+    }
+
+    /*
+     * The remote MEP has just come up or gone down: dampen it if flapping,
+     * and have it reported at the end of the event window
+     */
+    void rMepTransition(MepCfg &mep, uint32_t slot, uint64_t now);
+
+    /* Report the transitions of the remote MEPs of the MEP due by now */
+    void flushEvents(MepCfg &mep, uint64_t now);
+
+    int checkRMEPdb(MepCfg &mep, uint64_t now);
+
+    /*
+     * Prints the state of the MEPs every so often from a thread of its own,
+     * off their snapshots: it never holds the shards up.
+     */
+    class Reporter : public Runnable {
+    public:
+
+        Reporter(const ErpsEngine *engine) : Runnable("ERPS Reporter"),
+        erpsEngine(engine), seconds(0) {
+        }
+
+        virtual void task();
+
+        const ErpsEngine *erpsEngine;
+        uint32_t seconds;
     };
 
+    Reporter reporter_;
+
+    /* Print how the thread is scheduled and how late it ran, if started */
+    static void printThread(ostream &os, const Runnable &thread);
+
+    /*
+     * The state changes of the MEPs, one producer per shard. A remote MEP
+     * going down weighs FLAP_PENALTY, which decays by half every half-life:
+     * its events are held back from SUPPRESS_LIMIT until the penalty has
+     * decayed down to REUSE_LIMIT.
+     */
+    EventLog events_;
+    static const uint32_t FLAP_PENALTY = 1000;
+    static const uint32_t SUPPRESS_LIMIT = 2000;
+    static const uint32_t REUSE_LIMIT = 750;
+    static const uint32_t MAX_PENALTY = 8000;
+
     friend ostream& operator<<(ostream& os, const ErpsEngine& ee);
 
 public:
 
-    ErpsEngine(NetIf *netIf0, const Dot1agAttr *attr, string name = "ERPS Engine");
+    /* workers: the number of shards, each served by a thread of its own */
+    ErpsEngine(NetIf *netIf0, const Dot1agAttr *attr, uint32_t workers = 1,
+            string name = "ERPS Engine");
 
     virtual ~ErpsEngine();
 
     /*
-     * Will start 2 thread: the engine itself in task(), and TaskCfm::task() 
+     * Queue the packet to the shard of its MA, thread safe; run to
+     * completion, process it right away in the thread receiving it
+     */
+    virtual int bufferPacket(Dot1ag *packet);
+
+    /*
+     * Add one more local MEP, attr->mepid, to the MA on attr->vlan and
+     * attr->md_level, which is set up with attr if it is new; a MEPID out of
+     * range makes a MEP only listening. To be called before startService().
+     */
+    int addMep(const Dot1agAttr *attr);
+
+    uint32_t getMaCount() const {
+        return mas_.size();
+    };
+
+    uint32_t getMepCount() const {
+        uint32_t count = 0;
+
+        for (size_t i = 0; i < shards_.size(); i++) {
+            count += shards_[i]->meps.size();
+        }
+        return count;
+    };
+
+    uint32_t getWorkerCount() const {
+        return shards_.size();
+    };
+
+    /*
+     * How the workers are scheduled, to be set before they start: with
+     * more than one of them and of the CPUs, each is pinned to one of the
+     * CPUs in turn. Run to completion, the one thread is scheduled so.
+     */
+    void setWorkerSchedAttr(const SchedAttr &attr);
+
+    /*
+     * Whether a CCM the same as the last one of its remote MEP but for the
+     * sequence number only refreshes it, without the full parse (default);
+     * to be set before the start
+     */
+    void setCcmMemo(bool on) {
+        ccmMemo_ = on;
+    };
+
+    /* Print the state of the MEPs every seconds, 0 (default) for never */
+    void setStatusInterval(uint32_t seconds) {
+        reporter_.seconds = seconds;
+    };
+
+    /*
+     * The tick of the TX wheels, finer than the ms of the rMEPwhile timers
+     * for the CCMs of a 3.33 ms interval to be spread out over it
+     */
+    static const uint64_t TX_TICK_NSEC = 250000;
+
+    /* The least txBurst of a shard, frames per TX tick */
+    static const uint32_t TX_BURST_MIN = 64;
+
+    /*
+     * The farthest a CCM is put off to, from the previous one of its MEP,
+     * in tenths of its interval: well short of the rMEPwhile of the peers
+     */
+    static const uint32_t TX_GAP_MAX = 25;
+
+    /*
+     * How the shards keep up with the CCMs to send, summed over them, and
+     * the intervals between the CCMs each MEP sent, over all of them
+     */
+    struct SchedStats {
+        uint64_t ccmsSent;
+        uint64_t txSlips;
+        uint64_t txDeferred;
+        uint64_t txBatches;
+        uint32_t txBatchMax; /* the most frames sent in one TX tick */
+        TimerService::Stats timer; /* lateMax the worst of the shards */
+
+        uint32_t txMeps; /* MEPs that sent two CCMs or more */
+        uint64_t txIntervals;
+        uint32_t txMin; /* us, the shortest of any MEP */
+        uint32_t txMax; /* us, the longest of any MEP */
+        double txMeanError; /* us, the worst |mean - nominal| of a MEP */
+        double txStddevMax; /* us, the worst of a MEP */
+        uint64_t txBuckets[IntervalStats::BUCKETS]; /* x nominal */
+
+        uint64_t rxFrames;
+        uint64_t rxLatencySum; /* us, from the time stamp of pcap */
+        uint64_t rxLatencyMax;
+        uint64_t rxLatency[LATENCY_BUCKETS]; /* under 2^k us */
+    };
+
+    void getSchedStats(SchedStats &stats) const;
+
+    /*
+     * Print the threads, then the defects and remote MEPs of every local
+     * MEP as last published by the shards, thread safe and never blocking
+     * them
+     */
+    void printStatus(ostream &os) const;
+
+    /* Bytes taken by the MAs and MEPs configured, for diagnostics */
+    size_t memoryUsage() const;
+
+    /*
+     * Will start the engine in task(), which starts the shards and waits
+     * for them
      */
     void startService();
 
+    /*
+     * Run the whole engine in the calling thread instead, the RX of netIf0
+     * included, for the small boxes: one event loop reads the frames and
+     * processes them right away, in the order received, then sends the
+     * CCMs and runs the timers due, and sleeps on the RX channel and the
+     * next deadline at once. No frame is handed over between threads; the
+     * event log and the status report keep their threads, off the path of
+     * the frames. The NetIf is not to be started then. Never returns.
+     */
+    void runToCompletion();
+
 
 protected:
     /* 
-     * This task is to handle received CFM packets and react accordingly 
+     * This task starts the shards, which handle received CFM packets and
+     * react accordingly, and waits for them
      */
     void task();
 
+    /* React to one CFM packet received */
+    void processPacket(Dot1ag *dot1ag);
+
     /*
-     * Handling CCMs received
+     * One round of a shard at now: resume the coroutines due, send the
+     * CCMs due with the LBMs and LTMs they queued, and check the rMEPwhile
+     * timers due; runCfm(now) runs all the shards at tick now (ms)
      */
-    int processCcm(NetIfCfg &cfg, const uint8_t *data, int verbose = 1);
+    void runCfm(Shard &shard, const MonoTime &now);
+    void runCfm(uint64_t now);
+
+    /*
+     * Handling CCMs received, by the layout the frame was classified to
+     */
+    int processCcm(MaCfg &cfg, const Dot1ag *dot1ag);
+
+    template <class Layout>
+    int processCcm(MaCfg &cfg, const uint8_t *data, uint32_t size,
+            int verbose = 1);
 
 
 };
@@ -0,0 +1,132 @@
+/*
+ * @brief: Micro benchmark of the MAID validation of the CCMs received
+ *
+ *    Copyright (c) 2017
+ *    Author: James Wang
+ *    All rights reserved.
+ *
+ * Created on March 7, 2017
+ *
+ * Usage: bench_maid [iterations]
+ *
+ * Times, in ns per CCM, the name by name MAID check processCcm() used to do
+ * against the MaidMatcher compare, for a CCM of a matching MAID and one
+ * differing in the last byte of the MA name.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "dot1ag/Dot1agCcm.h"
+#include "dot1ag/MaidMatcher.h"
+
+/* The MD/MA name checks of processCcm() before MaidMatcher */
+static int legacyMatch(const struct cfm_cc *cfm_cc, const char *md,
+        const char *ma) {
+    const uint8_t *md_namep = cfm_cc->maid.var_p;
+    uint8_t mdnl = 0;
+    uint8_t smanl;
+    char mdnamebuf[DOT1AG_MAX_MD_LENGTH + 1];
+
+    memset(mdnamebuf, '\0', sizeof (mdnamebuf));
+    if (cfm_cc->maid.format == 4) {
+        mdnl = cfm_cc->maid.length;
+        if ((mdnl < 1) || (mdnl > DOT1AG_MAX_MD_LENGTH)) {
+            return EXIT_FAILURE;
+        }
+        strncpy(mdnamebuf, (char *) md_namep, mdnl);
+        if (strncmp(mdnamebuf, md,
+                strlen(md) > mdnl ? strlen(md) : mdnl) != 0) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    char smanamebuf[MAID_SIZE - mdnl - 4 + 1];
+    memset(smanamebuf, '\0', sizeof (smanamebuf));
+    if (*(md_namep + mdnl) == 2) {
+        smanl = *(md_namep + mdnl + 1);
+        if (smanl < 1) {
+            return EXIT_FAILURE;
+        }
+        if (smanl + mdnl > MAID_SIZE - 4) {
+            smanl = MAID_SIZE - mdnl - 4;
+        }
+        strncpy(smanamebuf, (char *) (md_namep + mdnl + 2), smanl);
+        if (strncmp(smanamebuf, ma,
+                strlen(ma) > smanl ? strlen(ma) : smanl) != 0) {
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+static uint64_t nowNsec() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+int main(int argc, char **argv) {
+    long iterations = 10000000;
+    Dot1agAttr attr;
+    MaidMatcher matcher;
+    struct cfm_cc cc[2];
+    volatile int sink = 0;
+    uint64_t start;
+    double legacyNs[2];
+    double matcherNs[2];
+
+    if (argc > 1) {
+        iterations = atol(argv[1]);
+    }
+    if (iterations <= 0) {
+        fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    attr.md = "packetier-domain";
+    attr.ma = "erps-ring-1";
+    attr.mepid = 1;
+    attr.CCMinterval = 1000;
+
+    /* a CCM as we send it, and one with the MA name off by one byte */
+    Dot1agCcm ccm(&attr);
+    memcpy(&cc[0], POS_CFM_CC((uint8_t *) ccm.getPacketBuf().data()),
+            sizeof (cc[0]));
+    memcpy(&cc[1], &cc[0], sizeof (cc[1]));
+    cc[1].maid.var_p[strlen(attr.md) + 2 + strlen(attr.ma) - 1] ^= 1;
+
+    matcher.setMaid(attr.md, attr.ma);
+
+    for (int i = 0; i < 2; i++) {
+        if ((legacyMatch(&cc[i], attr.md, attr.ma) == EXIT_SUCCESS) !=
+                matcher.match(&cc[i].maid) || matcher.match(&cc[i].maid) !=
+                (i == 0)) {
+            fprintf(stderr, "MaidMatcher disagrees on CCM %d\n", i);
+            return EXIT_FAILURE;
+        }
+
+        start = nowNsec();
+        for (long n = 0; n < iterations; n++) {
+            sink = sink + legacyMatch(&cc[i], attr.md, attr.ma);
+            __asm__ __volatile__("" ::: "memory");
+        }
+        legacyNs[i] = (double) (nowNsec() - start) / iterations;
+
+        start = nowNsec();
+        for (long n = 0; n < iterations; n++) {
+            sink = sink + matcher.match(&cc[i].maid);
+            __asm__ __volatile__("" ::: "memory");
+        }
+        matcherNs[i] = (double) (nowNsec() - start) / iterations;
+    }
+
+    printf("MAID check, %ld iterations, ns per CCM\n", iterations);
+    printf("  %-10s %10s %10s\n", "", "legacy", "matcher");
+    printf("  %-10s %10.2f %10.2f\n", "match", legacyNs[0], matcherNs[0]);
+    printf("  %-10s %10.2f %10.2f\n", "mismatch", legacyNs[1], matcherNs[1]);
+    return EXIT_SUCCESS;
+}
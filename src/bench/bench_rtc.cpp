@@ -0,0 +1,271 @@
+/*
+ * @brief: Latency of the frames received, threaded against run to completion
+ *
+ *    Copyright (c) 2017
+ *    Author: James Wang
+ *    All rights reserved.
+ *
+ * Created on March 7, 2017
+ *
+ * Usage: bench_rtc [interface [mode [MAs [rate [seconds]]]]]
+ *
+ * Runs the engine on interface (lo) in mode: "threads" (default), with the
+ * RX thread of the NetIf queueing the frames to the shard, or "rtc", with
+ * ErpsEngine::runToCompletion() doing it all in one thread. MAs (100) MAs,
+ * one per VLAN from 1 on, each with a local MEP sending CCMs every second.
+ * A peer sends the CCMs of its own MEP in each MA in turn, rate (1000) of
+ * them a second, which the engine takes in as the state of the remote MEP.
+ *
+ * Reports, over seconds (5) after a second to settle, the time from the
+ * reception of a CCM, as pcap stamped it, to its remote MEP updated, with
+ * the CPU taken and the context switches of the threads of the engine per
+ * CCM, against the threads it takes.
+ *
+ * The engine logs to stdout, which is discarded: the results go to stderr.
+ * Opening the TX and RX channels requires superuser privilege, as erpsd
+ * does.
+ */
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+
+#include <thread>
+
+#include "dot1ag/Dot1agCcm.h"
+#include "dot1ag/NetIf.h"
+#include "erps/ErpsEngine.h"
+
+/* The peer sending the CCMs received, from a MAC other than ours */
+static const uint16_t PEER_MEPID = 2;
+static const uint8_t PEER_MAC[ETHER_ADDR_LEN] = {
+    0x02, 0x00, 0x00, 0x00, 0x00, 0x02
+};
+
+static uint64_t cpuNsec() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * The context switches of the threads of the process but the calling one,
+ * the peer, and how many they are
+ */
+static uint64_t contextSwitches(int &threads) {
+    char path[64 + NAME_MAX];
+    char line[128];
+    struct dirent *entry;
+    uint64_t switches = 0;
+    unsigned long long n;
+    DIR *dir;
+    FILE *file;
+
+    threads = 0;
+    dir = opendir("/proc/self/task");
+    if (dir == NULL) {
+        return 0;
+    }
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.' || atoi(entry->d_name) == getpid()) {
+            continue;
+        }
+        snprintf(path, sizeof (path), "/proc/self/task/%s/status",
+                entry->d_name);
+        if ((file = fopen(path, "r")) == NULL) {
+            continue;
+        }
+        while (fgets(line, sizeof (line), file) != NULL) {
+            if (sscanf(line, "voluntary_ctxt_switches: %llu", &n) == 1 ||
+                    sscanf(line, "nonvoluntary_ctxt_switches: %llu",
+                    &n) == 1) {
+                switches += n;
+            }
+        }
+        fclose(file);
+        threads++;
+    }
+    closedir(dir);
+    return switches;
+}
+
+/* The first bucket k the share p of the frames are in, all under 2^k us */
+static uint32_t percentile(const ErpsEngine::SchedStats &stats, double p) {
+    uint64_t count = 0;
+    uint32_t k;
+
+    for (k = 0; k < Runnable::LATENCY_BUCKETS - 1; k++) {
+        count += stats.rxLatency[k];
+        if (count >= p * stats.rxFrames) {
+            break;
+        }
+    }
+    return k;
+}
+
+int main(int argc, char **argv) {
+    const char *ifname = "lo";
+    const char *mode = "threads";
+    int mas = 100;
+    int rate = 1000;
+    int seconds = 5;
+    bool rtc;
+    Dot1agAttr attr;
+    Dot1agAttr peer;
+    ErpsEngine *engine = NULL;
+    ErpsEngine::SchedStats before;
+    ErpsEngine::SchedStats after;
+    vector<Dot1ag *> frames;
+    struct timespec next;
+    uint64_t frameNsec;
+    uint64_t cpu;
+    uint64_t switches;
+    uint64_t sent = 0;
+    uint64_t served;
+    uint32_t seq = 0;
+    int threads;
+
+    if (argc > 1) {
+        ifname = argv[1];
+    }
+    if (argc > 2) {
+        mode = argv[2];
+    }
+    if (argc > 3) {
+        mas = atoi(argv[3]);
+    }
+    if (argc > 4) {
+        rate = atoi(argv[4]);
+    }
+    if (argc > 5) {
+        seconds = atoi(argv[5]);
+    }
+    rtc = strcmp(mode, "rtc") == 0;
+    if ((!rtc && strcmp(mode, "threads") != 0) || mas <= 0 || mas > 4094 ||
+            rate <= 0 || seconds <= 0) {
+        fprintf(stderr, "usage: %s [interface [threads|rtc [MAs [rate "
+                "[seconds]]]]]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    /* the engine logs every state change, keep the results readable */
+    if (freopen("/dev/null", "w", stdout) == NULL) {
+        perror("/dev/null");
+        return EXIT_FAILURE;
+    }
+
+    /* the peer is a single source MAC, at any rate */
+    NetIf nif(ifname);
+    nif.getPolicer().setRate(0, 0);
+    nif.getPolicer().setControlRate(0, 0);
+    attr.md = "packetier-domain";
+    attr.ma = "erps-ring-1";
+    attr.md_level = 1;
+    attr.mepid = 1;
+    for (int n = 0; n < mas; n++) {
+        attr.vlan = 1 + n;
+        if (engine == NULL) {
+            engine = new ErpsEngine(&nif, &attr, 1, "RTC Engine");
+        } else if (engine->addMep(&attr) != EXIT_SUCCESS) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    /* a CCM of the peer for each MA */
+    peer.md = attr.md;
+    peer.ma = attr.ma;
+    peer.md_level = attr.md_level;
+    peer.mepid = PEER_MEPID;
+    for (int n = 0; n < mas; n++) {
+        peer.vlan = 1 + n;
+        Dot1agCcm ccm(&peer);
+        frames.push_back(ccm.clone());
+        memcpy(frames.back()->getPacketData() + ETHER_ADDR_LEN, PEER_MAC,
+                ETHER_ADDR_LEN);
+    }
+
+    if (rtc) {
+        new thread(&ErpsEngine::runToCompletion, engine);
+    } else {
+        nif.init();
+        nif.start();
+        new thread(&ErpsEngine::startService, engine);
+    }
+
+    /* the peer, paced in absolute time not to drift */
+    frameNsec = 1000000000ULL / rate;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    for (int phase = 0; phase < 2; phase++) {
+        uint64_t end = MonoTime::now().nsec() + (phase == 0 ? 1 :
+                seconds) * MonoTime::NSEC_PER_SEC;
+
+        if (phase == 1) {
+            engine->getSchedStats(before);
+            cpu = cpuNsec();
+            switches = contextSwitches(threads);
+            sent = 0;
+        }
+        while (MonoTime::now().nsec() < end) {
+            Dot1ag *frame = frames[seq % mas];
+
+            /* one CCM of every MA a round, numbered by the round */
+            frame->setTransId(1 + seq / mas);
+            if (nif.sendPacket(frame) == EXIT_SUCCESS) {
+                sent++;
+            }
+            seq++;
+
+            MonoTime t = MonoTime::fromTimespec(next) + MonoTime(frameNsec);
+            t.toTimespec(next);
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        }
+    }
+    /* the last ones in flight */
+    usleep(100000);
+    engine->getSchedStats(after);
+    cpu = cpuNsec() - cpu;
+    switches = contextSwitches(threads) - switches;
+    served = after.rxFrames - before.rxFrames;
+    for (uint32_t k = 0; k < Runnable::LATENCY_BUCKETS; k++) {
+        after.rxLatency[k] -= before.rxLatency[k];
+    }
+    after.rxFrames = served;
+
+    fprintf(stderr, "%s: %d MAs, %d CCMs/s received over %d s, %d threads "
+            "of the engine\n", rtc ? "run to completion" : "threaded", mas,
+            rate, seconds, threads);
+    fprintf(stderr, "  CCMs sent/served:               %9llu/%llu\n",
+            (unsigned long long) sent, (unsigned long long) served);
+    if (served == 0) {
+        fprintf(stderr, "  no CCM received, is the RX channel open?\n");
+        fflush(stderr);
+        _exit(EXIT_FAILURE);
+    }
+    fprintf(stderr, "  RX to state, mean:              %9.1f us\n",
+            (double) (after.rxLatencySum - before.rxLatencySum) / served);
+    fprintf(stderr, "  RX to state, 50%%/99%% under:     %9u/%u us\n",
+            1U << percentile(after, 0.5), 1U << percentile(after, 0.99));
+    fprintf(stderr, "  RX to state, max since start:   %9llu us\n",
+            (unsigned long long) after.rxLatencyMax);
+    fprintf(stderr, "  context switches per CCM:       %9.2f\n",
+            (double) switches / served);
+    fprintf(stderr, "  CPU per CCM, peer included:     %9.2f us\n",
+            (double) cpu / 1000 / served);
+    fprintf(stderr, "  us from RX:");
+    for (uint32_t k = 0; k < Runnable::LATENCY_BUCKETS; k++) {
+        if (after.rxLatency[k] > 0) {
+            fprintf(stderr, " <%u:%llu", 1U << k,
+                    (unsigned long long) after.rxLatency[k]);
+        }
+    }
+    fprintf(stderr, "\n");
+
+    /* the engine never returns */
+    fflush(stderr);
+    _exit(EXIT_SUCCESS);
+}
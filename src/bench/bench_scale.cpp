@@ -0,0 +1,270 @@
+/*
+ * @brief: Scale benchmark of the engine with thousands of local MEPs
+ *
+ *    Copyright (c) 2017
+ *    Author: James Wang
+ *    All rights reserved.
+ *
+ * Created on March 7, 2017
+ *
+ * Usage: bench_scale [interface [MEPs [MEPs per MA [seconds [workers]]]]]
+ *
+ * Sets up the engine with MEPs local MEPs (1000), that many per MA (1), one
+ * MA per VLAN from 1 on, all sending CCMs every second on interface (lo),
+ * and one remote MEP heard of in each MA. Reports the memory taken per MEP,
+ * the cost of a CCM received, the steady ones with the CCM memo on and off
+ * (each CCM parsed in full), and the CPU taken by the TX and rMEPwhile
+ * rounds of the shards over seconds (3) of wall clock time, scaled to 1000
+ * MEPs; then the same rounds with the MEPs configured but silent, on a 10
+ * minutes interval and heard of by no one.
+ *
+ * With workers (1) shards, the CCMs are also received by one thread per
+ * shard at once, each taking the MAs of its own shard as the shards would,
+ * for the throughput over all of them.
+ *
+ * The engine logs to stdout, which is discarded: the results go to stderr.
+ * Opening the TX channel requires superuser privilege, as erpsd does.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <thread>
+
+#include "dot1ag/Dot1agCcm.h"
+#include "dot1ag/NetIf.h"
+#include "erps/ErpsEngine.h"
+
+/* The peer sending the CCMs received */
+static const uint16_t PEER_MEPID = 8000;
+
+/* Drives the engine by hand, without its threads */
+class ScaleEngine : public ErpsEngine {
+public:
+
+    ScaleEngine(NetIf *netIf, const Dot1agAttr *attr, uint32_t workers) :
+    ErpsEngine(netIf, attr, workers, "Scale Engine") {
+    }
+
+    void receive(Dot1ag *dot1ag) {
+        processPacket(dot1ag);
+    }
+
+    void round(uint64_t now) {
+        runCfm(now);
+    }
+};
+
+static uint64_t nowNsec(clockid_t clock) {
+    struct timespec ts;
+
+    clock_gettime(clock, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * The CCMs of all the MAs received passes times, each one numbered next as
+ * its peer would, in ns per CCM
+ */
+static double receiveAll(ScaleEngine *engine, vector<Dot1ag *> &frames,
+        int passes) {
+    uint64_t start;
+    uint64_t elapsed = 0;
+
+    for (int k = 0; k < passes; k++) {
+        for (size_t n = 0; n < frames.size(); n++) {
+            frames[n]->setTransId(frames[n]->getTransId() + 1);
+        }
+        start = nowNsec(CLOCK_MONOTONIC);
+        for (size_t n = 0; n < frames.size(); n++) {
+            engine->receive(frames[n]);
+        }
+        elapsed += nowNsec(CLOCK_MONOTONIC) - start;
+    }
+    return (double) elapsed / frames.size() / passes;
+}
+
+/* Set up meps MEPs, mepsPerMa per MA, sending CCMs every interval ms */
+static ScaleEngine *setup(NetIf *nif, int meps, int mepsPerMa, int interval,
+        int workers) {
+    Dot1agAttr attr;
+    ScaleEngine *engine = NULL;
+
+    attr.md = "packetier-domain";
+    attr.ma = "erps-ring-1";
+    attr.md_level = 1;
+    attr.CCMinterval = interval;
+
+    for (int n = 0; n < meps; n++) {
+        attr.vlan = 1 + n / mepsPerMa;
+        attr.mepid = 1 + n % mepsPerMa;
+        if (engine == NULL) {
+            engine = new ScaleEngine(nif, &attr, workers);
+        } else if (engine->addMep(&attr) != EXIT_SUCCESS) {
+            exit(EXIT_FAILURE);
+        }
+    }
+    return engine;
+}
+
+/* The CCMs of the MAs of one shard, as its thread gets them */
+static void receiveShard(ScaleEngine *engine, vector<Dot1ag *> *frames,
+        int shard, int workers, int passes) {
+    for (int k = 0; k < passes; k++) {
+        for (size_t n = shard; n < frames->size(); n += workers) {
+            engine->receive((*frames)[n]);
+        }
+    }
+}
+
+/* CPU taken by the rounds of the shards over seconds, in ns */
+static uint64_t runRounds(ScaleEngine *engine, int seconds) {
+    uint64_t cpu = 0;
+    uint64_t start;
+    uint64_t end = NetIf::getTimeMsec() + seconds * 1000;
+
+    while (NetIf::getTimeMsec() < end) {
+        start = nowNsec(CLOCK_THREAD_CPUTIME_ID);
+        engine->round(NetIf::getTimeMsec());
+        cpu += nowNsec(CLOCK_THREAD_CPUTIME_ID) - start;
+        usleep(NetIf::WAKEUP / 1000);
+    }
+    return cpu;
+}
+
+int main(int argc, char **argv) {
+    const char *ifname = "lo";
+    int meps = 1000;
+    int mepsPerMa = 1;
+    int seconds = 3;
+    int interval = 1000;
+    int workers = 1;
+    int mas;
+    vector<thread *> threads;
+    double parallelNs;
+    vector<Dot1ag *> frames;
+    size_t idleBytes;
+    size_t bytes;
+    uint64_t start;
+    double firstNs;
+    double steadyNs;
+    double fullNs;
+    double rxPerSec;
+    uint64_t cpu;
+    uint64_t idleCpu;
+
+    if (argc > 1) {
+        ifname = argv[1];
+    }
+    if (argc > 2) {
+        meps = atoi(argv[2]);
+    }
+    if (argc > 3) {
+        mepsPerMa = atoi(argv[3]);
+    }
+    if (argc > 4) {
+        seconds = atoi(argv[4]);
+    }
+    if (argc > 5) {
+        workers = atoi(argv[5]);
+    }
+    if (meps <= 0 || mepsPerMa <= 0 || mepsPerMa > MAX_MEPID - 1 ||
+            seconds <= 0 || workers <= 0 ||
+            (meps + mepsPerMa - 1) / mepsPerMa > 4094) {
+        fprintf(stderr, "usage: %s [interface [MEPs [MEPs per MA "
+                "[seconds [workers]]]]]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    mas = (meps + mepsPerMa - 1) / mepsPerMa;
+
+    /* the engine logs every state change, keep the results readable */
+    if (freopen("/dev/null", "w", stdout) == NULL) {
+        perror("/dev/null");
+        return EXIT_FAILURE;
+    }
+
+    NetIf nif(ifname);
+    ScaleEngine *engine = setup(&nif, meps, mepsPerMa, interval, workers);
+    idleBytes = engine->memoryUsage();
+
+    /* a CCM of the peer for each MA */
+    Dot1agAttr peer;
+    peer.md = "packetier-domain";
+    peer.ma = "erps-ring-1";
+    peer.md_level = 1;
+    peer.mepid = PEER_MEPID;
+    peer.CCMinterval = interval;
+    for (int n = 0; n < mas; n++) {
+        peer.vlan = 1 + n;
+        Dot1agCcm ccm(&peer);
+        frames.push_back(ccm.clone());
+    }
+
+    /* the first CCM takes the remote MEP in, the next ones refresh it */
+    start = nowNsec(CLOCK_MONOTONIC);
+    for (int n = 0; n < mas; n++) {
+        engine->receive(frames[n]);
+    }
+    firstNs = (double) (nowNsec(CLOCK_MONOTONIC) - start) / mas;
+    bytes = engine->memoryUsage();
+
+    steadyNs = receiveAll(engine, frames, 100);
+    engine->setCcmMemo(false);
+    fullNs = receiveAll(engine, frames, 100);
+    engine->setCcmMemo(true);
+
+    /* the shards do not share any state, they go at it all at once */
+    start = nowNsec(CLOCK_MONOTONIC);
+    for (int w = 0; w < workers; w++) {
+        threads.push_back(new thread(receiveShard, engine, &frames, w,
+                workers, 100));
+    }
+    for (int w = 0; w < workers; w++) {
+        threads[w]->join();
+        delete threads[w];
+    }
+    parallelNs = (double) (nowNsec(CLOCK_MONOTONIC) - start) / mas / 100;
+
+    cpu = runRounds(engine, seconds);
+    delete engine;
+
+    /* the longest interval, once the first CCMs are out */
+    engine = setup(&nif, meps, mepsPerMa, 600000, workers);
+    engine->round(NetIf::getTimeMsec());
+    idleCpu = runRounds(engine, seconds);
+    delete engine;
+
+    for (size_t n = 0; n < frames.size(); n++) {
+        delete frames[n];
+    }
+
+    /* one CCM per MA and interval keeps every local MEP fed */
+    rxPerSec = (double) mas * 1000 / interval;
+
+    fprintf(stderr, "%d local MEPs, %d per MA, CCM interval %d ms, "
+            "%d workers on %u cores\n", meps, mepsPerMa, interval, workers,
+            thread::hardware_concurrency());
+    fprintf(stderr, "  memory per MEP, configured:      %8zu bytes\n",
+            idleBytes / meps);
+    fprintf(stderr, "  memory per MEP, one remote MEP:  %8zu bytes\n",
+            bytes / meps);
+    fprintf(stderr, "  CCM received, first:             %8.0f ns\n",
+            firstNs);
+    fprintf(stderr, "  CCM received, steady:            %8.0f ns\n",
+            steadyNs);
+    fprintf(stderr, "  CCM received, steady, no memo:   %8.0f ns\n",
+            fullNs);
+    fprintf(stderr, "  CCM received, all workers:       %8.0f ns "
+            "(%.2f M/s)\n", parallelNs, 1e3 / parallelNs);
+    fprintf(stderr, "CPU per 1000 MEPs, %% of a core\n");
+    fprintf(stderr, "  RX, steady CCMs:                 %8.3f\n",
+            steadyNs * rxPerSec / 1e7 * 1000 / meps);
+    fprintf(stderr, "  TX and rMEPwhile rounds:         %8.3f\n",
+            (double) cpu / seconds / 1e7 * 1000 / meps);
+    fprintf(stderr, "  rounds, MEPs silent:             %8.3f\n",
+            (double) idleCpu / seconds / 1e7 * 1000 / meps);
+    return EXIT_SUCCESS;
+}
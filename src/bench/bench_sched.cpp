@@ -0,0 +1,188 @@
+/*
+ * @brief: Benchmark of the CCM scheduler of the shards, down to 3.33 ms
+ *
+ *    Copyright (c) 2017
+ *    Author: James Wang
+ *    All rights reserved.
+ *
+ * Created on March 7, 2017
+ *
+ * Usage: bench_sched [interface [MEPs [interval [seconds [workers]]]]]
+ *
+ * Runs the engine with its own shard threads, MEPs local MEPs (1000), one
+ * MA per VLAN from 1 on, all sending CCMs every interval ms (3 for 3.33 ms)
+ * on interface (lo), for seconds (5) of wall clock time after a second to
+ * settle. Reports whether the shards kept up: the CCMs sent against the
+ * CCMs due, the times a MEP fell a whole interval behind, the wakeups of
+ * the shards and how late they came in after their deadline, and the CPU
+ * taken, scaled to 1000 MEPs. Then how evenly the CCMs were spread: the
+ * frames sent per TX tick, and the intervals between the CCMs of each MEP
+ * against the nominal one, the worst of any MEP, since the start.
+ *
+ * Fails if any of these intervals reached 3.5 nominal ones, the
+ * rMEPwhile of the peers: they would have raised a loss of continuity,
+ * whatever the mean looks like.
+ *
+ * The engine logs to stdout, which is discarded: the results go to stderr.
+ * Opening the TX channel requires superuser privilege, as erpsd does.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <thread>
+
+#include "dot1ag/Dot1agCcm.h"
+#include "dot1ag/NetIf.h"
+#include "erps/ErpsEngine.h"
+
+static uint64_t cpuNsec() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+int main(int argc, char **argv) {
+    const char *ifname = "lo";
+    int meps = 1000;
+    int interval = 3;
+    int seconds = 5;
+    int workers = 1;
+    Dot1agAttr attr;
+    ErpsEngine *engine = NULL;
+    ErpsEngine::SchedStats before;
+    ErpsEngine::SchedStats after;
+    MonoTime start;
+    double elapsed;
+    double due;
+    uint64_t cpu;
+    uint64_t wakeups;
+    uint64_t expirations;
+    uint64_t batches;
+    uint32_t intervalUsec;
+    int status;
+
+    if (argc > 1) {
+        ifname = argv[1];
+    }
+    if (argc > 2) {
+        meps = atoi(argv[2]);
+    }
+    if (argc > 3) {
+        interval = atoi(argv[3]);
+    }
+    if (argc > 4) {
+        seconds = atoi(argv[4]);
+    }
+    if (argc > 5) {
+        workers = atoi(argv[5]);
+    }
+    intervalUsec = Dot1agCcm::decodeInterval(
+            Dot1agCcm::encodeInterval(interval));
+    if (meps <= 0 || meps > 4094 || intervalUsec == 0 || seconds <= 0 ||
+            workers <= 0) {
+        fprintf(stderr, "usage: %s [interface [MEPs [interval "
+                "[seconds [workers]]]]]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    /* the engine logs every state change, keep the results readable */
+    if (freopen("/dev/null", "w", stdout) == NULL) {
+        perror("/dev/null");
+        return EXIT_FAILURE;
+    }
+
+    NetIf nif(ifname);
+    attr.md = "packetier-domain";
+    attr.ma = "erps-ring-1";
+    attr.md_level = 1;
+    attr.CCMinterval = interval;
+    attr.mepid = 1;
+    for (int n = 0; n < meps; n++) {
+        attr.vlan = 1 + n;
+        if (engine == NULL) {
+            engine = new ErpsEngine(&nif, &attr, workers, "Sched Engine");
+        } else if (engine->addMep(&attr) != EXIT_SUCCESS) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    /* the shards run on their own, as in erpsd */
+    new thread(&ErpsEngine::startService, engine);
+    sleep(1);
+
+    engine->getSchedStats(before);
+    cpu = cpuNsec();
+    start = MonoTime::now();
+    sleep(seconds);
+    engine->getSchedStats(after);
+    cpu = cpuNsec() - cpu;
+    elapsed = (double) (MonoTime::now() - start).nsec() / 1e9;
+
+    due = elapsed * meps * 1e6 / intervalUsec;
+    wakeups = after.timer.wakeups - before.timer.wakeups;
+    expirations = after.timer.expirations - before.timer.expirations;
+    batches = after.txBatches - before.txBatches;
+
+    fprintf(stderr, "%d local MEPs, CCM interval %u us, %d workers on %u "
+            "cores, %.2f s\n", meps, intervalUsec, workers,
+            thread::hardware_concurrency(), elapsed);
+    fprintf(stderr, "  CCMs sent/due:                  %9.0f/%.0f "
+            "(%.2f%%)\n", (double) (after.ccmsSent - before.ccmsSent), due,
+            (after.ccmsSent - before.ccmsSent) * 100.0 / due);
+    fprintf(stderr, "  MEPs a whole interval behind:   %9llu\n",
+            (unsigned long long) (after.txSlips - before.txSlips));
+    fprintf(stderr, "  CCMs put off to the next tick:  %9llu\n",
+            (unsigned long long) (after.txDeferred - before.txDeferred));
+    fprintf(stderr, "  wakeups per s:                  %9.0f\n",
+            wakeups / elapsed);
+    if (expirations > 0) {
+        fprintf(stderr, "  late after the deadline, mean:  %9llu us\n",
+                (unsigned long long) ((after.timer.lateSum -
+                before.timer.lateSum) / expirations));
+    }
+    fprintf(stderr, "  late after the deadline, max:   %9llu us\n",
+            (unsigned long long) after.timer.lateMax);
+    fprintf(stderr, "  CPU, %% of a core:               %9.3f\n",
+            cpu / elapsed / 1e7);
+    fprintf(stderr, "  CPU per 1000 MEPs, %% of a core: %9.3f\n",
+            cpu / elapsed / 1e7 * 1000 / meps);
+    if (batches > 0) {
+        fprintf(stderr, "  frames per TX tick, mean/max:  %9.1f/%u "
+                "(%llu us ticks)\n", (double) (after.ccmsSent -
+                before.ccmsSent) / batches, after.txBatchMax,
+                (unsigned long long) (ErpsEngine::TX_TICK_NSEC / 1000));
+    }
+    fprintf(stderr, "Intervals between the CCMs of a MEP, %u MEPs, %llu "
+            "intervals\n", after.txMeps,
+            (unsigned long long) after.txIntervals);
+    fprintf(stderr, "  shortest/longest of any MEP:    %9u/%u us\n",
+            after.txMin, after.txMax);
+    fprintf(stderr, "  worst |mean - nominal| of a MEP:%9.1f us\n",
+            after.txMeanError);
+    fprintf(stderr, "  worst stddev of a MEP:          %9.1f us\n",
+            after.txStddevMax);
+    fprintf(stderr, "  x nominal:");
+    for (uint32_t k = 0; k < IntervalStats::BUCKETS; k++) {
+        if (after.txBuckets[k] > 0) {
+            fprintf(stderr, " %.2f%s:%llu", IntervalStats::bucketLow(k),
+                    k ? "" : "-", (unsigned long long) after.txBuckets[k]);
+        }
+    }
+    fprintf(stderr, "\n");
+
+    /* a gap the peers take for a loss of continuity */
+    status = EXIT_SUCCESS;
+    if ((uint64_t) after.txMax * 10 >= (uint64_t) intervalUsec * 35) {
+        fprintf(stderr, "  LOC: longest interval %u us, rMEPwhile %u us\n",
+                after.txMax, intervalUsec * 35 / 10);
+        status = EXIT_FAILURE;
+    }
+
+    /* the shards never return */
+    fflush(stderr);
+    _exit(status);
+}
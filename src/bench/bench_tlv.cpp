@@ -0,0 +1,180 @@
+/*
+ * @brief: Micro benchmark of the TLV walk of the CCMs received
+ *
+ *    Copyright (c) 2017
+ *    Author: James Wang
+ *    All rights reserved.
+ *
+ * Created on March 7, 2017
+ *
+ * Usage: bench_tlv [iterations]
+ *
+ * Times, in ns per CCM over 5 rounds, the unchecked TLV loop processCcm()
+ * used to run against TlvIterator as processCcm() runs it now, from the
+ * first TLV at the offset of the layout to the end of the frame, both
+ * picking the Port and Interface Status out of the TLVs of our own CCM.
+ * The best and the worst round of each are reported: the bounds checks
+ * are meant to cost nothing measurable, not to make the walk faster, and
+ * a difference of the best rounds within the spread of the rounds is
+ * none.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "dot1ag/Dot1agCcm.h"
+#include "dot1ag/TlvIterator.h"
+
+/*
+ * The TLV loop of processCcm() before TlvIterator. Neither walk is inlined
+ * into the timing loops, for the compiler not to hoist one more than the
+ * other out of them: both are called once per CCM, as processCcm() is.
+ */
+static void __attribute__((noinline)) legacyWalk(uint8_t *data,
+        uint8_t &tlv_ps, uint8_t &tlv_is) {
+    uint8_t *p;
+    int more_tlvs;
+    int tlv_length;
+
+    p = POS_CFM_CC_TLVS(data);
+    more_tlvs = 1;
+    while (more_tlvs) {
+        tlv_length = ntohs(*(uint16_t *) (p + 1));
+        switch (*p) {
+            case TLV_END:
+                more_tlvs = 0;
+                break;
+            case TLV_PORT_STATUS:
+                tlv_ps = *(p + 3);
+                break;
+            case TLV_INTERFACE_STATUS:
+                tlv_is = *(p + 3);
+                break;
+            default:
+                break;
+        }
+        p += sizeof (uint16_t) + tlv_length + 1;
+    }
+}
+
+static int __attribute__((noinline)) iteratorWalk(const uint8_t *data,
+        uint32_t size, uint8_t &tlv_ps, uint8_t &tlv_is) {
+    TlvIterator tlvs(POS_CFM_CC_TLVS(data), data + size);
+    CfmTlv tlv;
+
+    while (tlvs.next(tlv)) {
+        switch (tlv.type) {
+            case TLV_PORT_STATUS:
+                tlv.getStatus(tlv_ps);
+                break;
+            case TLV_INTERFACE_STATUS:
+                tlv.getStatus(tlv_is);
+                break;
+            default:
+                break;
+        }
+    }
+    return tlvs.isDone() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* Timing rounds of each walk */
+static const int ROUNDS = 5;
+
+static uint64_t nowNsec() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+int main(int argc, char **argv) {
+    long iterations = 10000000;
+    Dot1agAttr attr;
+    uint8_t frame[Dot1ag::BUFFER_MAX_SIZE];
+    uint32_t size;
+    uint8_t ps = 0;
+    uint8_t is = 0;
+    volatile int sink = 0;
+    uint64_t start;
+    double legacyNs;
+    double legacyWorst;
+    double iteratorNs;
+    double iteratorWorst;
+    double ns;
+
+    if (argc > 1) {
+        iterations = atol(argv[1]);
+    }
+    if (iterations <= 0) {
+        fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    attr.md = "packetier-domain";
+    attr.ma = "erps-ring-1";
+    attr.mepid = 1;
+    attr.CCMinterval = 1000;
+
+    /* our own CCM: Sender ID, Port Status, Interface Status and End TLVs */
+    Dot1agCcm ccm(&attr);
+    size = ccm.getPacketSize();
+    memcpy(frame, ccm.getPacketBuf().data(), size);
+
+    if (iteratorWalk(frame, size, ps, is) != EXIT_SUCCESS ||
+            ps != DOT1AG_PS_UP || is != DOT1AG_IS_UP) {
+        fprintf(stderr, "TlvIterator failed on our own CCM\n");
+        return EXIT_FAILURE;
+    }
+    if (iteratorWalk(frame, size - 1, ps, is) == EXIT_SUCCESS ||
+            TlvIterator::validate(frame, size - 1) == EXIT_SUCCESS ||
+            TlvIterator::validate(frame, size) != EXIT_SUCCESS) {
+        fprintf(stderr, "TlvIterator missed the truncated End TLV\n");
+        return EXIT_FAILURE;
+    }
+
+    /* in turns, the first of them warming the CPU up, left out of the worst */
+    legacyNs = 0;
+    legacyWorst = 0;
+    iteratorNs = 0;
+    iteratorWorst = 0;
+    for (int round = 0; round < ROUNDS; round++) {
+        start = nowNsec();
+        for (long n = 0; n < iterations; n++) {
+            legacyWalk(frame, ps, is);
+            sink = sink + ps + is;
+            __asm__ __volatile__("" ::: "memory");
+        }
+        ns = (double) (nowNsec() - start) / iterations;
+        if (round == 0 || ns < legacyNs) {
+            legacyNs = ns;
+        }
+        if (round > 0 && ns > legacyWorst) {
+            legacyWorst = ns;
+        }
+
+        start = nowNsec();
+        for (long n = 0; n < iterations; n++) {
+            sink = sink + iteratorWalk(frame, size, ps, is);
+            sink = sink + ps + is;
+            __asm__ __volatile__("" ::: "memory");
+        }
+        ns = (double) (nowNsec() - start) / iterations;
+        if (round == 0 || ns < iteratorNs) {
+            iteratorNs = ns;
+        }
+        if (round > 0 && ns > iteratorWorst) {
+            iteratorWorst = ns;
+        }
+    }
+
+    printf("CCM TLV walk, %d x %ld iterations, ns per CCM\n", ROUNDS,
+            iterations);
+    printf("  %-10s %10s %10s\n", "", "legacy", "iterator");
+    printf("  %-10s %10.2f %10.2f\n", "best", legacyNs, iteratorNs);
+    printf("  %-10s %10.2f %10.2f\n", "worst", legacyWorst, iteratorWorst);
+    printf("  iterator %+.1f%% of legacy, best rounds\n",
+            (iteratorNs - legacyNs) * 100 / legacyNs);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,190 @@
+/*
+ * @brief: Benchmark of the CFM transactions, thousands of them at once
+ *
+ *    Copyright (c) 2017
+ *    Author: James Wang
+ *    All rights reserved.
+ *
+ * Created on March 7, 2017
+ *
+ * Usage: bench_txn [transactions [answered% [timeout]]]
+ *
+ * Starts transactions (10000) coroutines in one thread, each sending an LBM
+ * and awaiting its LBR, all outstanding at once on one TransactionTable as
+ * in a shard. A peer answers answered% (90) of them, in random order, plus
+ * as many LBRs of no LBM outstanding; the others time out after timeout ms
+ * (100). Reports the cost of starting a transaction, of matching its LBR and
+ * resuming its coroutine to the end, and of timing it out, with the memory
+ * a transaction takes, and checks that every LBM got its LBR or its timeout,
+ * once. No frame goes on the wire.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <random>
+
+#include "dot1ag/CfmTransaction.h"
+#include "dot1ag/Dot1agLbm.h"
+#include "dot1ag/MonoTime.h"
+
+static const char *PEER_MAC = "02:00:00:00:00:02";
+
+/* What became of the LBMs */
+struct Outcome {
+    uint64_t answered;
+    uint64_t timedOut;
+    uint64_t wrong; /* an LBR of another LBM, or twice resumed */
+};
+
+static uint64_t nowNsec() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Send one LBM, "on the wire", and await its LBR or the timeout */
+static CfmTask lbm(TransactionTable &table, const Dot1agLbm &lbmTemplate,
+        uint32_t timeout, vector<Dot1ag *> &wire, Outcome &outcome) {
+    Transaction lb(table, CFM_LBR, timeout);
+    Dot1ag *frame = lbmTemplate.clone();
+    Dot1ag *lbr;
+
+    frame->setTransId(lb.getTransId());
+    wire.push_back(frame);
+
+    lbr = co_await lb.reply();
+    if (lbr == NULL) {
+        outcome.timedOut++;
+    } else if (lbr->getTransId() == lb.getTransId()) {
+        outcome.answered++;
+    } else {
+        outcome.wrong++;
+    }
+}
+
+int main(int argc, char **argv) {
+    int transactions = 10000;
+    int answered = 90;
+    int timeout = 100;
+    Dot1agAttr attr;
+    uint8_t peerMac[ETHER_ADDR_LEN];
+    vector<Dot1ag *> wire;
+    vector<Dot1ag *> lbrs;
+    Outcome outcome = {0, 0, 0};
+    TransactionTable::Stats stats;
+    uint64_t frameBytes;
+    uint64_t tableBytes;
+    uint64_t openNsec;
+    uint64_t replyNsec;
+    uint64_t expireNsec;
+    uint64_t start;
+    uint32_t replies;
+    uint32_t strays;
+
+    if (argc > 1) {
+        transactions = atoi(argv[1]);
+    }
+    if (argc > 2) {
+        answered = atoi(argv[2]);
+    }
+    if (argc > 3) {
+        timeout = atoi(argv[3]);
+    }
+    if (transactions <= 0 || answered < 0 || answered > 100 ||
+            timeout <= 0) {
+        fprintf(stderr, "usage: %s [transactions [answered%% "
+                "[timeout]]]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    attr.md_level = 1;
+    attr.vlan = 1;
+    attr.remoteMac = PEER_MAC;
+    Dot1ag::eth_addr_parse(peerMac, PEER_MAC);
+    Dot1agLbm lbmTemplate(&attr);
+    TransactionTable table;
+
+    /* all of them outstanding at once, each in a coroutine of its own */
+    start = nowNsec();
+    for (int n = 0; n < transactions; n++) {
+        lbm(table, lbmTemplate, timeout, wire, outcome);
+    }
+    openNsec = nowNsec() - start;
+    frameBytes = CfmTask::getFrameBytes();
+    tableBytes = table.memoryUsage();
+
+    /*
+     * the peer: the LBRs of the share answered, in any order, and as many
+     * strays, of IDs outstanding by no LBM
+     */
+    replies = (uint64_t) transactions * answered / 100;
+    for (uint32_t n = 0; n < wire.size(); n++) {
+        if (n < replies) {
+            Dot1agLbm::convertDotagLbm2Lbr(wire[n], peerMac);
+            lbrs.push_back(wire[n]);
+        } else {
+            delete wire[n];
+        }
+    }
+    strays = lbrs.size();
+    for (uint32_t n = 0; n < strays; n++) {
+        lbrs.push_back(lbrs[n]->clone());
+        lbrs.back()->setTransId(lbrs[n]->getTransId() + transactions);
+    }
+    shuffle(lbrs.begin(), lbrs.end(), mt19937(1));
+
+    start = nowNsec();
+    for (size_t n = 0; n < lbrs.size(); n++) {
+        table.deliver(lbrs[n]);
+    }
+    replyNsec = nowNsec() - start;
+    for (size_t n = 0; n < lbrs.size(); n++) {
+        delete lbrs[n];
+    }
+
+    /* the others, once their time is up */
+    usleep((timeout + 2) * 1000);
+    start = nowNsec();
+    table.advance(MonoTime::now().msec());
+    expireNsec = nowNsec() - start;
+
+    table.getStats(stats);
+    fprintf(stderr, "%d transactions outstanding at once, %u answered, "
+            "%u strays, %d ms timeout\n", transactions, replies, strays,
+            timeout);
+    fprintf(stderr, "  start, LBM built:            %9.0f ns\n",
+            (double) openNsec / transactions);
+    if (lbrs.size() > 0) {
+        fprintf(stderr, "  LBR matched or not, resumed: %9.0f ns\n",
+                (double) replyNsec / lbrs.size());
+    }
+    if (transactions > (int) replies) {
+        fprintf(stderr, "  timed out, resumed:          %9.0f ns\n",
+                (double) expireNsec / (transactions - replies));
+    }
+    fprintf(stderr, "  coroutine frame:             %9.0f bytes\n",
+            (double) frameBytes / transactions);
+    fprintf(stderr, "  table, ID hash and wheel:    %9.0f bytes\n",
+            (double) tableBytes / transactions);
+    fprintf(stderr, "  answered/timed out/wrong:    %9llu/%llu/%llu\n",
+            (unsigned long long) outcome.answered,
+            (unsigned long long) outcome.timedOut,
+            (unsigned long long) outcome.wrong);
+    fprintf(stderr, "  pending/unmatched/frames left:%8u/%llu/%llu\n",
+            stats.pending, (unsigned long long) stats.unmatched,
+            (unsigned long long) CfmTask::getFrames());
+
+    if (outcome.answered != replies || outcome.wrong != 0 ||
+            outcome.timedOut != transactions - replies ||
+            stats.pending != 0 || stats.unmatched != strays ||
+            CfmTask::getFrames() != 0) {
+        fprintf(stderr, "  MISMATCH\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,293 @@
+/*
+ * @brief: Check of the expiry of the remote MEPs, and of the timing wheel
+ *
+ *    Copyright (c) 2017
+ *    Author: James Wang
+ *    All rights reserved.
+ *
+ * Created on March 7, 2017
+ *
+ * Usage: check_expiry [operations [seed [interface]]]
+ *
+ * Runs operations (200000) random operations on a TimerWheel and on a
+ * brute force reference, a deadline per id in an array: arm and re-arm,
+ * overdue and far beyond the wheels included, cancel, and advance by a
+ * tick, a few, a level or so, or a jump of hours. Every advance() must
+ * expire exactly the ids due by then, disarmed; pending() and
+ * getExpiry() must agree with the reference and nextExpiry() must be a
+ * lower bound of the next deadline. seed (1) makes it repeatable.
+ *
+ * Then, on interface (lo), has a local MEP hear one CCM of a remote MEP,
+ * at the CCM intervals 3.33, 10 and 100 ms, and checks that the remote MEP
+ * goes down as its rMEPwhile of 3.5 intervals runs out: not before 3
+ * intervals, and by 4 intervals and the 1 ms tick.
+ *
+ * The engine logs to stdout, which is discarded: the results go to stderr.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <random>
+#include <sstream>
+#include <string>
+
+#include "dot1ag/TimerWheel.h"
+#include "dot1ag/Dot1agCcm.h"
+#include "dot1ag/NetIf.h"
+#include "erps/ErpsEngine.h"
+
+/* The ids of the wheel, few for them to collide often */
+static const uint32_t IDS = 512;
+
+/* Drives the engine by hand, without its threads */
+class CheckEngine : public ErpsEngine {
+public:
+
+    CheckEngine(NetIf *netIf, const Dot1agAttr *attr) :
+    ErpsEngine(netIf, attr, 1, "Check Engine") {
+    }
+
+    void receive(Dot1ag *dot1ag) {
+        processPacket(dot1ag);
+    }
+
+    void round(uint64_t now) {
+        runCfm(now);
+    }
+};
+
+/* A delay from now, of any of the ranges the wheel handles on its own */
+static uint64_t randomDelay(mt19937_64 &rng) {
+    switch (rng() % 6) {
+        case 0:
+            return 0;
+        case 1:
+            return rng() % TimerWheel::SLOTS;
+        case 2:
+            return rng() % (TimerWheel::SLOTS * TimerWheel::SLOTS);
+        case 3:
+            return rng() % (1ULL << (TimerWheel::SLOT_BITS *
+                    TimerWheel::LEVELS));
+        case 4:
+            /* beyond the wheels, parked */
+            return (1ULL << (TimerWheel::SLOT_BITS * TimerWheel::LEVELS)) +
+                    rng() % (1ULL << 30);
+        default:
+            return rng() % 16;
+    }
+}
+
+static int checkWheel(long operations, uint64_t seed) {
+    mt19937_64 rng(seed);
+    vector<uint64_t> reference(IDS, (uint64_t) TimerWheel::NONE64);
+    vector<uint32_t> expired;
+    vector<uint32_t> due;
+    uint64_t now = 1000;
+    uint64_t next;
+    uint64_t earliest;
+    uint32_t pending;
+    uint32_t id;
+    long advances = 0;
+    long expiries = 0;
+    TimerWheel wheel(IDS, now);
+
+    for (long n = 0; n < operations; n++) {
+        id = rng() % IDS;
+        switch (rng() % 8) {
+            case 0:
+            case 1:
+            case 2:
+                reference[id] = now + randomDelay(rng);
+                wheel.arm(id, reference[id]);
+                break;
+            case 3:
+                /* overdue already */
+                reference[id] = now - rng() % (now + 1);
+                wheel.arm(id, reference[id]);
+                break;
+            case 4:
+                reference[id] = TimerWheel::NONE64;
+                wheel.cancel(id);
+                break;
+            default:
+                switch (rng() % 4) {
+                    case 0:
+                        now += 1;
+                        break;
+                    case 1:
+                        now += rng() % TimerWheel::SLOTS;
+                        break;
+                    case 2:
+                        now += rng() % (TimerWheel::SLOTS *
+                                TimerWheel::SLOTS * 2);
+                        break;
+                    default:
+                        /* one in a while, hours at once */
+                        now += rng() % 64 == 0 ? rng() % (1ULL << 34) :
+                                rng() % 1000;
+                        break;
+                }
+                expired.clear();
+                wheel.advance(now, expired);
+                due.clear();
+                for (uint32_t k = 0; k < IDS; k++) {
+                    if (reference[k] <= now) {
+                        due.push_back(k);
+                        reference[k] = TimerWheel::NONE64;
+                    }
+                }
+                sort(expired.begin(), expired.end());
+                if (expired != due) {
+                    fprintf(stderr, "  operation %ld: advance to %llu "
+                            "expired %zu ids, %zu due\n", n,
+                            (unsigned long long) now, expired.size(),
+                            due.size());
+                    return EXIT_FAILURE;
+                }
+                advances++;
+                expiries += expired.size();
+                break;
+        }
+
+        pending = 0;
+        earliest = TimerWheel::NONE64;
+        for (uint32_t k = 0; k < IDS; k++) {
+            if (reference[k] == TimerWheel::NONE64) {
+                if (wheel.isArmed(k)) {
+                    fprintf(stderr, "  operation %ld: id %u armed\n", n, k);
+                    return EXIT_FAILURE;
+                }
+                continue;
+            }
+            if (!wheel.isArmed(k) || wheel.getExpiry(k) != reference[k]) {
+                fprintf(stderr, "  operation %ld: id %u not armed at %llu\n",
+                        n, k, (unsigned long long) reference[k]);
+                return EXIT_FAILURE;
+            }
+            pending++;
+            earliest = min(earliest, reference[k]);
+        }
+        next = wheel.nextExpiry();
+        if (wheel.pending() != pending || (pending == 0 ?
+                next != TimerWheel::NONE64 : next > max(earliest, now + 1))) {
+            fprintf(stderr, "  operation %ld: %u pending, next expiry %llu, "
+                    "%u and %llu expected\n", n, wheel.pending(),
+                    (unsigned long long) next, pending,
+                    (unsigned long long) earliest);
+            return EXIT_FAILURE;
+        }
+    }
+    fprintf(stderr, "timing wheel: %ld operations, %ld advances, %ld "
+            "expiries, as the reference\n", operations, advances, expiries);
+    return EXIT_SUCCESS;
+}
+
+/* Whether the remote MEP is down, by the status of the engine */
+static bool isDown(CheckEngine &engine) {
+    ostringstream os;
+
+    engine.printStatus(os);
+    return os.str().find("rMEPid: 8000") != string::npos &&
+            os.str().find(" is DOWN ") != string::npos;
+}
+
+/*
+ * Hear one CCM of the remote MEP at interval ms (3 for 3.33), then run the
+ * rounds till it is down: not before 3 intervals, and by 4 and 2 ms
+ */
+static int checkRMep(const char *ifname, uint32_t interval) {
+    Dot1agAttr attr;
+    Dot1agAttr peer;
+    uint32_t usec = Dot1agCcm::decodeInterval(
+            Dot1agCcm::encodeInterval(interval));
+    uint64_t start;
+    uint64_t now;
+    uint64_t downAt = 0;
+
+    NetIf nif(ifname);
+
+    attr.md = "packetier-domain";
+    attr.ma = "erps-ring-1";
+    attr.md_level = 1;
+    attr.vlan = 1;
+    attr.CCMinterval = interval;
+    attr.mepid = 1;
+    CheckEngine engine(&nif, &attr);
+
+    peer.md = attr.md;
+    peer.ma = attr.ma;
+    peer.md_level = attr.md_level;
+    peer.vlan = attr.vlan;
+    peer.CCMinterval = interval;
+    peer.mepid = 8000;
+    Dot1agCcm ccm(&peer);
+    ccm.setTransId(1);
+
+    start = NetIf::getTimeUsec();
+    engine.receive(&ccm);
+    do {
+        now = NetIf::getTimeUsec();
+        engine.round(now / 1000);
+        if (isDown(engine)) {
+            downAt = now - start;
+            break;
+        }
+        usleep(usec / 10 > 200 ? usec / 10 : 200);
+    } while (now - start < (uint64_t) usec * 5);
+
+    fprintf(stderr, "remote MEP at %u us: down after %llu us, rMEPwhile "
+            "%u us\n", usec, (unsigned long long) downAt, usec * 35 / 10);
+
+    /* the tick of 1 ms, and the rounds a tenth of interval apart */
+    if (downAt < (uint64_t) usec * 3 || downAt == 0 ||
+            downAt > (uint64_t) usec * 4 + 2000) {
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv) {
+    long operations = 200000;
+    uint64_t seed = 1;
+    const char *ifname = "lo";
+    int status;
+
+    if (argc > 1) {
+        operations = atol(argv[1]);
+    }
+    if (argc > 2) {
+        seed = strtoull(argv[2], NULL, 0);
+    }
+    if (argc > 3) {
+        ifname = argv[3];
+    }
+    if (operations <= 0) {
+        fprintf(stderr, "usage: %s [operations [seed [interface]]]\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (freopen("/dev/null", "w", stdout) == NULL) {
+        perror("/dev/null");
+        return EXIT_FAILURE;
+    }
+
+    status = checkWheel(operations, seed);
+    if (status == EXIT_SUCCESS) {
+        status = checkRMep(ifname, 3);
+    }
+    if (status == EXIT_SUCCESS) {
+        status = checkRMep(ifname, 10);
+    }
+    if (status == EXIT_SUCCESS) {
+        status = checkRMep(ifname, 100);
+    }
+    if (status != EXIT_SUCCESS) {
+        fprintf(stderr, "  MISMATCH\n");
+    }
+    return status;
+}
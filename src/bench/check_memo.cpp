@@ -0,0 +1,165 @@
+/*
+ * @brief: Check of the CCMs taken the short way by some local MEPs only
+ *
+ *    Copyright (c) 2017
+ *    Author: James Wang
+ *    All rights reserved.
+ *
+ * Created on March 7, 2017
+ *
+ * Usage: check_memo [interface]
+ *
+ * Sets up an MA with two local MEPs on interface (lo) and feeds them the
+ * CCMs of one remote MEP, numbered 1 on, 2 ms apart. After the first ones
+ * a third local MEP is added: the next CCMs are the ones the first two
+ * accepted last and the third has not heard of, taking the short way for
+ * the first two and the full path for the third. Every local MEP must have
+ * counted each CCM once: no duplicate, as many received as sent, and no
+ * interval between two of them shorter than 1 ms.
+ *
+ * The engine logs to stdout, which is discarded: the results go to stderr.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sstream>
+#include <string>
+
+#include "dot1ag/Dot1agCcm.h"
+#include "dot1ag/NetIf.h"
+#include "erps/ErpsEngine.h"
+
+static const uint16_t PEER_MEPID = 8000;
+
+/* Drives the engine by hand, without its threads */
+class CheckEngine : public ErpsEngine {
+public:
+
+    CheckEngine(NetIf *netIf, const Dot1agAttr *attr) :
+    ErpsEngine(netIf, attr, 1, "Check Engine") {
+    }
+
+    void receive(Dot1ag *dot1ag) {
+        processPacket(dot1ag);
+    }
+};
+
+/*
+ * Check what each local MEP counted of the remote MEP, from the status:
+ * meps of them, each with received CCMs 2 ms apart at least and those
+ * first ones received by the MEPs added last
+ */
+static int check(CheckEngine &engine, int meps, uint32_t received,
+        uint32_t late) {
+    ostringstream os;
+    string line;
+    int mepid = 0;
+    int seen = 0;
+    int status = EXIT_SUCCESS;
+    unsigned int rMEPid;
+    unsigned int seq, rx, lost, gaps, dup, reorders;
+    unsigned int count, min;
+
+    engine.printStatus(os);
+    istringstream is(os.str());
+    while (getline(is, line)) {
+        const char *p;
+
+        if ((p = strstr(line.c_str(), "MEPid: ")) != NULL &&
+                strstr(line.c_str(), "rMEPid: ") == NULL) {
+            mepid = atoi(p + 7);
+        } else if ((p = strstr(line.c_str(), "rMEPid: ")) != NULL) {
+            if (sscanf(p, "rMEPid: %u", &rMEPid) != 1 ||
+                    sscanf(strstr(p, "seq: "), "seq: %u rx: %u lost: %u "
+                    "gaps: %u dup: %u late: %u", &seq, &rx, &lost, &gaps,
+                    &dup, &reorders) != 6) {
+                return EXIT_FAILURE;
+            }
+            fprintf(stderr, "  MEP %d: rMEP %u seq %u rx %u lost %u dup %u",
+                    mepid, rMEPid, seq, rx, lost, dup);
+            if (rMEPid != PEER_MEPID || dup != 0 || lost != 0 ||
+                    rx != (mepid <= 2 ? received : received - late)) {
+                status = EXIT_FAILURE;
+            }
+            seen++;
+        } else if ((p = strstr(line.c_str(), "intervals: ")) != NULL) {
+            if (sscanf(p, "intervals: %u min/mean/max: %u", &count,
+                    &min) != 2) {
+                return EXIT_FAILURE;
+            }
+            fprintf(stderr, " intervals %u min %u us\n", count, min);
+            if (count > 0 && min < 1000) {
+                status = EXIT_FAILURE;
+            }
+        }
+    }
+    return seen == meps ? status : EXIT_FAILURE;
+}
+
+int main(int argc, char **argv) {
+    const char *ifname = "lo";
+    Dot1agAttr attr;
+    Dot1agAttr peer;
+    uint32_t seq = 0;
+    int status;
+
+    if (argc > 1) {
+        ifname = argv[1];
+    }
+
+    if (freopen("/dev/null", "w", stdout) == NULL) {
+        perror("/dev/null");
+        return EXIT_FAILURE;
+    }
+
+    NetIf nif(ifname);
+
+    attr.md = "packetier-domain";
+    attr.ma = "erps-ring-1";
+    attr.md_level = 1;
+    attr.vlan = 1;
+    attr.CCMinterval = 1000;
+    attr.mepid = 1;
+    CheckEngine engine(&nif, &attr);
+    attr.mepid = 2;
+    if (engine.addMep(&attr) != EXIT_SUCCESS) {
+        return EXIT_FAILURE;
+    }
+
+    peer.md = attr.md;
+    peer.ma = attr.ma;
+    peer.md_level = attr.md_level;
+    peer.vlan = attr.vlan;
+    peer.CCMinterval = attr.CCMinterval;
+    peer.mepid = PEER_MEPID;
+    Dot1agCcm ccm(&peer);
+
+    /* the first CCM takes the remote MEP in, the next one is memoized */
+    for (int n = 0; n < 3; n++) {
+        ccm.setTransId(++seq);
+        engine.receive(&ccm);
+        usleep(2000);
+    }
+
+    /* one local MEP more, not hearing of the remote MEP yet */
+    attr.mepid = 3;
+    if (engine.addMep(&attr) != EXIT_SUCCESS) {
+        return EXIT_FAILURE;
+    }
+    for (int n = 0; n < 3; n++) {
+        ccm.setTransId(++seq);
+        engine.receive(&ccm);
+        usleep(2000);
+    }
+
+    fprintf(stderr, "%u CCMs, MEPs 1 and 2 from the first, 3 from the "
+            "fourth on\n", seq);
+    status = check(engine, 3, seq, 3);
+    if (status != EXIT_SUCCESS) {
+        fprintf(stderr, "  MISMATCH\n");
+    }
+    return status;
+}
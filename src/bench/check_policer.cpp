@@ -0,0 +1,178 @@
+/*
+ * @brief: Check of the RX policer, the CCMs of a flooding peer included
+ *
+ *    Copyright (c) 2017
+ *    Author: James Wang
+ *    All rights reserved.
+ *
+ * Created on March 7, 2017
+ *
+ * Usage: check_policer [meps [copies]]
+ *
+ * Feeds an RxPolicer one second of frames, on a clock of its own: a peer
+ * sending the CCMs of meps (1000) MEPs at 3.33 ms, the budget the engine
+ * derives for them, and a looped neighbor sending copies (4) of each of
+ * them. Every CCM of the peer must pass, while the neighbor is cut down to
+ * the budget of the CCMs and R-APS. Then a flood of LBMs from the peer must
+ * be cut down to the rate of the LBMs without touching its CCMs, and the
+ * policer must let everything through once turned off.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dot1ag/RxPolicer.h"
+#include "dot1ag/Dot1agCcm.h"
+#include "dot1ag/Dot1agLbm.h"
+
+static const uint8_t PEER_MAC[ETHER_ADDR_LEN] = {
+    0x02, 0x00, 0x00, 0x00, 0x00, 0x02
+};
+static const uint8_t LOOP_MAC[ETHER_ADDR_LEN] = {
+    0x02, 0x00, 0x00, 0x00, 0x00, 0x03
+};
+
+/* The CCM interval of the MEPs, us */
+static const uint32_t INTERVAL = 3333;
+
+/* What became of the frames of a source */
+struct Count {
+    uint64_t passed;
+    uint64_t policed;
+};
+
+static void admit(RxPolicer &policer, const uint8_t *frame, uint32_t size,
+        const uint8_t *src, uint64_t nowUsec, Count &count) {
+    if (policer.admit(src, RxPolicer::classify(frame, size), nowUsec)) {
+        count.passed++;
+    } else {
+        count.policed++;
+    }
+}
+
+int main(int argc, char **argv) {
+    int meps = 1000;
+    int copies = 4;
+    Dot1agAttr attr;
+    RxPolicer policer;
+    Count peer = {0, 0};
+    Count loop = {0, 0};
+    Count lbms = {0, 0};
+    uint64_t now = 1000000;
+    uint64_t budget;
+    uint64_t allowed;
+    uint64_t at = 0;
+    uint32_t ccmSize;
+    uint32_t lbmSize;
+    int status = EXIT_SUCCESS;
+
+    if (argc > 1) {
+        meps = atoi(argv[1]);
+    }
+    if (argc > 2) {
+        copies = atoi(argv[2]);
+    }
+    if (meps <= 0 || copies <= (int) RxPolicer::CONTROL_HEADROOM) {
+        fprintf(stderr, "usage: %s [meps [copies, over %u]]\n", argv[0],
+                RxPolicer::CONTROL_HEADROOM);
+        return EXIT_FAILURE;
+    }
+
+    attr.md = "packetier-domain";
+    attr.ma = "erps-ring-1";
+    attr.md_level = 1;
+    attr.vlan = 1;
+    attr.CCMinterval = 3;
+    attr.mepid = 8000;
+    attr.remoteMac = "02:00:00:00:00:01";
+    Dot1agCcm ccm(&attr);
+    Dot1agLbm lbm(&attr);
+    ccmSize = ccm.getPacketSize();
+    lbmSize = lbm.getPacketSize();
+
+    /* the CCMs are not policed till a MEP is configured */
+    for (int n = 0; n < 1000; n++) {
+        admit(policer, ccm.getPacketBuf().data(), ccmSize, LOOP_MAC, now,
+                loop);
+    }
+    if (loop.policed != 0) {
+        fprintf(stderr, "  CCMs policed with no MEP configured\n");
+        status = EXIT_FAILURE;
+    }
+    loop.passed = 0;
+
+    /* as ErpsEngine::addMep() does */
+    for (int n = 0; n < meps; n++) {
+        policer.addControlRate((1000000 + INTERVAL - 1) / INTERVAL);
+    }
+    budget = (uint64_t) meps * ((1000000 + INTERVAL - 1) / INTERVAL) *
+            RxPolicer::CONTROL_HEADROOM + RxPolicer::RAPS_RATE;
+
+    /* one second of CCMs, each MEP at its own time into the interval */
+    now += 60 * 1000000ULL;
+    for (uint64_t t = 0; t < 1000000; t += INTERVAL) {
+        for (int n = 0; n < meps; n++) {
+            at = now + t + (uint64_t) INTERVAL * n / meps;
+            admit(policer, ccm.getPacketBuf().data(), ccmSize, PEER_MAC, at,
+                    peer);
+            for (int c = 0; c < copies; c++) {
+                admit(policer, ccm.getPacketBuf().data(), ccmSize, LOOP_MAC,
+                        at, loop);
+            }
+        }
+    }
+    /* the burst, 100 ms of the budget, then the budget */
+    allowed = budget / 10 + budget * (at - now) / 1000000;
+    fprintf(stderr, "%d MEPs at 3.33 ms, budget %llu frames/s: peer "
+            "passed %llu policed %llu, looped x%d passed %llu policed %llu\n",
+            meps, (unsigned long long) budget,
+            (unsigned long long) peer.passed,
+            (unsigned long long) peer.policed, copies,
+            (unsigned long long) loop.passed,
+            (unsigned long long) loop.policed);
+    if (peer.policed != 0 || loop.passed > allowed + 1 ||
+            loop.passed < allowed - allowed / 100) {
+        status = EXIT_FAILURE;
+    }
+
+    /* a flood of LBMs at once takes none of the tokens of the CCMs */
+    now += 1000000;
+    policer.setRate(100, 10);
+    peer.passed = 0;
+    for (int n = 0; n < 1000; n++) {
+        admit(policer, lbm.getPacketBuf().data(), lbmSize, PEER_MAC, now,
+                lbms);
+        admit(policer, ccm.getPacketBuf().data(), ccmSize, PEER_MAC, now,
+                peer);
+    }
+    fprintf(stderr, "1000 LBMs at rate 100 burst 10: passed %llu, the CCMs "
+            "along passed %llu policed %llu\n",
+            (unsigned long long) lbms.passed,
+            (unsigned long long) peer.passed,
+            (unsigned long long) peer.policed);
+    if (lbms.passed != 10 || peer.policed != 0) {
+        status = EXIT_FAILURE;
+    }
+
+    /* turned off, nothing is policed */
+    policer.setRate(0, 0);
+    policer.setControlRate(0, 0);
+    loop.policed = 0;
+    lbms.policed = 0;
+    for (int n = 0; n < 1000; n++) {
+        admit(policer, ccm.getPacketBuf().data(), ccmSize, LOOP_MAC, now,
+                loop);
+        admit(policer, lbm.getPacketBuf().data(), lbmSize, LOOP_MAC, now,
+                lbms);
+    }
+    if (policer.isEnabled() || loop.policed != 0 || lbms.policed != 0) {
+        fprintf(stderr, "  frames policed with the policer off\n");
+        status = EXIT_FAILURE;
+    }
+
+    if (status != EXIT_SUCCESS) {
+        fprintf(stderr, "  MISMATCH\n");
+    }
+    return status;
+}
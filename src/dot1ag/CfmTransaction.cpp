@@ -0,0 +1,252 @@
+/*
+ * @brief: CFM request/response transactions, as C++20 coroutines
+ *
+ *    Copyright (c) 2017
+ *    Author: James Wang
+ *    All rights reserved.
+ *
+ * Created on March 7, 2017
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <utility>
+
+#include "dot1ag/CfmTransaction.h"
+#include "dot1ag/MonoTime.h"
+
+atomic<uint64_t> CfmTask::frames_(0);
+atomic<uint64_t> CfmTask::frameBytes_(0);
+
+void *CfmTask::promise_type::operator new(size_t size) {
+    frames_.fetch_add(1, memory_order_relaxed);
+    frameBytes_.fetch_add(size, memory_order_relaxed);
+    return ::operator new(size);
+}
+
+void CfmTask::promise_type::operator delete(void *frame, size_t size) {
+    frames_.fetch_sub(1, memory_order_relaxed);
+    frameBytes_.fetch_sub(size, memory_order_relaxed);
+    ::operator delete(frame);
+}
+
+TransactionTable::TransactionTable() : timers_(0, nowMsec()) {
+    /* as Dot1agLbm, not to reuse the IDs of a previous run */
+    nextTransId_ = (uint32_t) random() ^ (uint32_t) time(0);
+    opened_.store(0, memory_order_relaxed);
+    replies_.store(0, memory_order_relaxed);
+    unmatched_.store(0, memory_order_relaxed);
+    expired_.store(0, memory_order_relaxed);
+    pending_.store(0, memory_order_relaxed);
+    sleeping_.store(0, memory_order_relaxed);
+}
+
+TransactionTable::~TransactionTable() {
+    vector<coroutine_handle<> > suspended;
+
+    /*
+     * a coroutine waits on one slot at a time: destroying it runs the
+     * destructors of its Transactions, which close their slots here
+     */
+    for (size_t i = 0; i < slots_.size(); i++) {
+        if (!slots_[i].used) {
+            continue;
+        }
+        if (slots_[i].sleeper) {
+            suspended.push_back(slots_[i].sleeper);
+        } else if (slots_[i].transaction->waiter_) {
+            suspended.push_back(slots_[i].transaction->waiter_);
+        }
+    }
+    for (size_t i = 0; i < suspended.size(); i++) {
+        suspended[i].destroy();
+    }
+}
+
+uint64_t TransactionTable::nowMsec() {
+    return MonoTime::now().msec();
+}
+
+uint32_t TransactionTable::allocSlot() {
+    uint32_t slot;
+
+    if (free_.empty()) {
+        slot = slots_.size();
+        slots_.push_back(Slot());
+        timers_.resize(slots_.size());
+    } else {
+        slot = free_.back();
+        free_.pop_back();
+    }
+    slots_[slot].transaction = NULL;
+    slots_[slot].sleeper = coroutine_handle<>();
+    slots_[slot].used = true;
+    return slot;
+}
+
+void TransactionTable::freeSlot(uint32_t slot) {
+    timers_.cancel(slot);
+    slots_[slot].used = false;
+    slots_[slot].transaction = NULL;
+    slots_[slot].sleeper = coroutine_handle<>();
+    free_.push_back(slot);
+}
+
+uint32_t TransactionTable::open(Transaction *transaction,
+        uint32_t timeoutMsec) {
+    uint32_t slot = allocSlot();
+
+    /* the next ID not outstanding, 0 left out as for not numbered */
+    do {
+        nextTransId_++;
+    } while (nextTransId_ == 0 || byTransId_.count(nextTransId_) != 0);
+
+    transaction->transId_ = nextTransId_;
+    transaction->openedAt_ = nowMsec();
+    slots_[slot].transaction = transaction;
+    byTransId_[nextTransId_] = slot;
+    timers_.arm(slot, transaction->openedAt_ + timeoutMsec);
+
+    opened_.fetch_add(1, memory_order_relaxed);
+    pending_.store(byTransId_.size(), memory_order_relaxed);
+    return slot;
+}
+
+void TransactionTable::close(Transaction *transaction) {
+    byTransId_.erase(transaction->transId_);
+    freeSlot(transaction->slot_);
+    pending_.store(byTransId_.size(), memory_order_relaxed);
+}
+
+void TransactionTable::park(coroutine_handle<> handle, uint32_t msec) {
+    uint32_t slot = allocSlot();
+
+    slots_[slot].sleeper = handle;
+    timers_.arm(slot, nowMsec() + msec);
+    sleeping_.fetch_add(1, memory_order_relaxed);
+}
+
+bool TransactionTable::deliver(Dot1ag *frame) {
+    const struct cfmhdr *cfmhdr = frame->getCfmHdr();
+    unordered_map<uint32_t, uint32_t>::const_iterator it;
+    Transaction *transaction;
+    coroutine_handle<> waiter;
+
+    if (cfmhdr == NULL) {
+        return false;
+    }
+    it = byTransId_.find(frame->getTransId());
+    if (it == byTransId_.end()) {
+        unmatched_.fetch_add(1, memory_order_relaxed);
+        return false;
+    }
+    transaction = slots_[it->second].transaction;
+    /* past its timeout, a late reply is as good as none */
+    if (transaction->opcode_ != cfmhdr->opcode || transaction->expired_) {
+        unmatched_.fetch_add(1, memory_order_relaxed);
+        return false;
+    }
+
+    /* the frame is freed by its receiver: keep its content only */
+    transaction->replies_.push_back(new Dot1ag(move(*frame)));
+    replies_.fetch_add(1, memory_order_relaxed);
+
+    /* resumed last: it may well close the transaction and open others */
+    waiter = transaction->waiter_;
+    if (waiter) {
+        transaction->waiter_ = coroutine_handle<>();
+        waiter.resume();
+    }
+    return true;
+}
+
+void TransactionTable::advance(uint64_t now) {
+    coroutine_handle<> waiter;
+
+    due_.clear();
+    timers_.advance(now, due_);
+    for (size_t i = 0; i < due_.size(); i++) {
+        uint32_t slot = due_[i];
+        Slot &entry = slots_[slot];
+
+        /*
+         * a coroutine resumed before may have closed it, and its slot been
+         * taken again and re-armed since
+         */
+        if (!entry.used || timers_.isArmed(slot)) {
+            continue;
+        }
+        if (entry.sleeper) {
+            waiter = entry.sleeper;
+            freeSlot(slot);
+            sleeping_.fetch_sub(1, memory_order_relaxed);
+            waiter.resume();
+            continue;
+        }
+
+        /* the slot stays taken till the transaction goes out of scope */
+        Transaction *transaction = entry.transaction;
+        if (transaction->expired_) {
+            continue;
+        }
+        transaction->expired_ = true;
+        expired_.fetch_add(1, memory_order_relaxed);
+        waiter = transaction->waiter_;
+        if (waiter) {
+            transaction->waiter_ = coroutine_handle<>();
+            waiter.resume();
+        }
+    }
+}
+
+void TransactionTable::getStats(Stats &stats) const {
+    stats.opened = opened_.load(memory_order_relaxed);
+    stats.replies = replies_.load(memory_order_relaxed);
+    stats.unmatched = unmatched_.load(memory_order_relaxed);
+    stats.expired = expired_.load(memory_order_relaxed);
+    stats.pending = pending_.load(memory_order_relaxed);
+    stats.sleeping = sleeping_.load(memory_order_relaxed);
+}
+
+size_t TransactionTable::memoryUsage() const {
+    /* roughly, a node and a bucket per entry of the hash table */
+    return sizeof (*this) + slots_.capacity() * sizeof (Slot) +
+            free_.capacity() * sizeof (uint32_t) + timers_.memoryUsage() -
+            sizeof (timers_) + byTransId_.bucket_count() * sizeof (void *) +
+            byTransId_.size() * (sizeof (pair<uint32_t, uint32_t>) +
+            2 * sizeof (void *));
+}
+
+ostream& operator<<(ostream& os, const TransactionTable::Stats& stats) {
+    os << "transactions: " << stats.opened << " pending: " << stats.pending <<
+            " replies: " << stats.replies << " unmatched: " <<
+            stats.unmatched << " timed out: " << stats.expired <<
+            " sleeping: " << stats.sleeping;
+    return os;
+}
+
+Transaction::Transaction(TransactionTable &table, uint8_t opcode,
+        uint32_t timeoutMsec) : table_(table), opcode_(opcode),
+expired_(false), current_(NULL) {
+    slot_ = table_.open(this, timeoutMsec);
+}
+
+Transaction::~Transaction() {
+    table_.close(this);
+    delete current_;
+    for (size_t i = 0; i < replies_.size(); i++) {
+        delete replies_[i];
+    }
+}
+
+Dot1ag *Transaction::nextReply() {
+    delete current_;
+    current_ = NULL;
+    if (!replies_.empty()) {
+        current_ = replies_.front();
+        replies_.pop_front();
+    }
+    return current_;
+}
@@ -19,17 +19,32 @@
 
 #include "dot1ag/NetIf.h"
 
-Dot1ag::Dot1ag() : buf{0}, attr(), packetSize(0), dstMacString("") {
+Dot1ag::Dot1ag() : buf(), tagging(FRAME_NOT_CFM), rxStamp(0), attr(),
+dstMacString("") {
 }
 
-Dot1ag::Dot1ag(const uint8_t * data, uint32_t len) : buf{0}
-, packetSize(0), dstMacString("") {
-    memcpy(buf, data, len);
-    this->packetSize = len;
+Dot1ag::Dot1ag(const uint8_t * data, uint32_t len) : buf(data, len),
+tagging(classifyFrame(buf.data(), buf.size())), rxStamp(0), attr(),
+dstMacString("") {
 }
 
-Dot1ag::Dot1ag(const Dot1agAttr * attr) : attr(attr) {
-    struct ether_header *p = (struct ether_header *) buf;
+Dot1ag::Dot1ag(PacketBuf &&pkt) : buf(std::move(pkt)),
+tagging(classifyFrame(buf.data(), buf.size())), rxStamp(0), attr(),
+dstMacString("") {
+}
+
+Dot1ag::Dot1ag(Dot1ag &&other) : buf(std::move(other.buf)),
+tagging(other.tagging), rxStamp(other.rxStamp), attr(other.attr),
+dstMacString(std::move(other.dstMacString)) {
+}
+
+Dot1ag::Dot1ag(const Dot1agAttr * attr) : buf(), tagging(FRAME_NOT_CFM),
+rxStamp(0), attr(attr) {
+    struct ether_header *p;
+
+    /* room for the Ether header to be filled below */
+    buf.resize(sizeof (struct ether_header));
+    p = etherHeader();
 
     /* set destination MAC address */
     if (attr->remoteMac == NULL) {
@@ -42,12 +57,18 @@ Dot1ag::Dot1ag(const Dot1agAttr * attr) : attr(attr) {
     if (attr->ifname == NULL) {
         memcpy (p->ether_shost, attr->srcMac, ETHER_ADDR_LEN);
     } else {
-        NetIf::getSrcMac(etherHeader_p->ether_shost, attr->ifname);
+        NetIf::getSrcMac(p->ether_shost, attr->ifname);
     }
 
     setVlanAndSize(attr->vlan);
 }
 
+Dot1ag *Dot1ag::clone() const {
+    Dot1ag *copy = new Dot1ag(buf.clone());
+    copy->attr = this->attr;
+    return copy;
+}
+
 /* Parse a MAC address */
 int Dot1ag::eth_addr_parse(uint8_t *addr, const char *str) {
     unsigned int cval;
@@ -135,14 +156,14 @@ void Dot1ag::eaprint(uint8_t *ea) {
 
 void Dot1ag::printPacket() {
     cout << endl;
-    cout << "  Packets with " << packetSize << " bytes: " << endl;
-    for (int i = 0; i < this->packetSize; i++) {
+    cout << "  Packets with " << buf.size() << " bytes: " << endl;
+    for (int i = 0; i < buf.size(); i++) {
         if (i % 16 == 0) {
             cout << endl;
             cout << "  0x" << hex << setfill('0') << setw(2) << i << " : ";
         }
-        cout << hex << setfill('0') << setw(2) << (unsigned int) buf[i];
-        if ((i % 16 != 15) && (i != (this->packetSize - 1))) {
+        cout << hex << setfill('0') << setw(2) << (unsigned int) buf.data()[i];
+        if ((i % 16 != 15) && (i != (buf.size() - 1))) {
             cout << ":";
         }
     }
@@ -205,13 +226,20 @@ void Dot1ag::tci_setvid(uint16_t vid, uint16_t *tci) {
 void Dot1ag::addCfmHdr(uint8_t md_level, uint8_t flags, uint8_t first_tlv,
         uint8_t opcode, uint8_t version) {
 
-    struct cfmhdr *p = CFMHDR(buf);
+    struct cfmhdr *p;
 
     /* MD level must be in range 0-7 */
     if (md_level > 7) {
         fprintf(stderr, "cfm_addhdr: allowed MD level range is 0-7\n");
         md_level = 0;
     }
+
+    // do not forget to add the cfm header to the packet size
+    if (buf.append(sizeof (struct cfmhdr)) == NULL) {
+        return;
+    }
+    p = CFMHDR(buf.data());
+
     /* set whole octet to 0, version is set to 0 too */
     p->octet1.version = version;
     /* MD Level is the high order 3 bits */
@@ -219,14 +247,14 @@ void Dot1ag::addCfmHdr(uint8_t md_level, uint8_t flags, uint8_t first_tlv,
     p->opcode = opcode;
     p->flags = flags;
     p->tlv_offset = first_tlv;
-
-    // do not forget to add the cfm header to packetSize
-    this->packetSize += sizeof (struct cfmhdr);
 }
 
 void Dot1ag::setVlanAndSize(uint16_t vlan) {
-    struct ether_header *p = (struct ether_header *) buf;
-    this->packetSize = sizeof (struct ether_header);
+    struct ether_header *p;
+    uint8_t *tag;
+
+    buf.resize(sizeof (struct ether_header));
+    p = etherHeader();
     if (vlan > 0) {
         /* set ethertype to 802.1Q tagging */
         p->ether_type = htons(ETYPE_8021Q);
@@ -238,16 +266,17 @@ void Dot1ag::setVlanAndSize(uint16_t vlan) {
          * +--------+-------+---------+
          *     PCP     CFI      VID
          */
+        tag = buf.append(ETHER_DOT1Q_LEN);
 
         /* set PCP and CFI to zero */
-        *((uint16_t *) (buf + this->packetSize)) = htons(vlan & 0xfff);
-        this->packetSize += 2;
+        *((uint16_t *) tag) = htons(vlan & 0xfff);
 
         /* set Ethernet type to CFM (0x8902) */
-        *((uint16_t *) (buf + this->packetSize)) = htons(ETYPE_CFM);
-        this->packetSize += 2;
+        *((uint16_t *) (tag + 2)) = htons(ETYPE_CFM);
+        tagging = FRAME_DOT1Q;
     } else {
         p->ether_type = htons(ETYPE_CFM);
+        tagging = FRAME_UNTAGGED;
     }
 
 }
@@ -255,21 +284,26 @@ void Dot1ag::setVlanAndSize(uint16_t vlan) {
 int Dot1ag::addTLV(uint8_t type, uint16_t len, const uint8_t *value) {
     uint8_t *p = NULL;
 
+    /* End TLV has the Type field only */
+    p = buf.append(type > TLV_END ? 1 + sizeof (uint16_t) + len : 1);
+    if (p == NULL) {
+        fprintf(stderr, "addTLV: no room for TLV %d\n", type);
+        return -1;
+    }
+
     /* Type */
-    *(uint8_t *) (buf + this->packetSize) = type;
-    this->packetSize += sizeof (uint8_t);
+    *p = type;
+    p += sizeof (uint8_t);
 
     if (type > TLV_END) {
         /* minimal length of 1 */
-        *(uint16_t *) (buf + this->packetSize) = htons(len);
-        this->packetSize += sizeof (uint16_t);
+        *(uint16_t *) p = htons(len);
+        p += sizeof (uint16_t);
 
         /* Values */
-        p = buf + this->packetSize;
         memcpy(p, value, len);
-        this->packetSize += len;
     }
-    return this->packetSize;
+    return buf.size();
 }
 
 int Dot1ag::addTLV(uint8_t type, uint8_t value) {
@@ -278,6 +312,7 @@ int Dot1ag::addTLV(uint8_t type, uint8_t value) {
 
 const string * Dot1ag::getDstMacString() {
     stringstream ss;
+    uint8_t *remotemac = etherHeader()->ether_dhost;
 
     if (this->dstMacString.empty()) {
         /* Create the dstMac string, for debug purpose */
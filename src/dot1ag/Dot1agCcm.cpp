@@ -15,43 +15,18 @@
 Dot1agCcm::Dot1agCcm(const Dot1agAttr *attr) : Dot1ag(attr) {
     
     uint8_t flags = 0;
-    int CCMinterval = 4; /* default to 1 sec */
+    int CCMinterval;
 
    setDstMac(ETHER_CFM_GROUP); // set CFM multicat mac as destination
            
     /* The last bype of the dstmac is 3y, y = md_level */
-    this->etherHeader_p->ether_dhost[5] = 0x30 + (attr->md_level & 0x0F);
+    etherHeader()->ether_dhost[5] = 0x30 + (attr->md_level & 0x0F);
 
     /* least-significant three bits are the CCM Interval */
-    switch (attr->CCMinterval) {
-        case 10:
-            /* 10 ms */
-            CCMinterval = 2;
-            break;
-        case 100:
-            /* 100 ms */
-            CCMinterval = 3;
-            break;
-        case 1000:
-            /* 1 sec */
-            CCMinterval = 4;
-            break;
-        case 10000:
-            /* 10 sec */
-            CCMinterval = 5;
-            break;
-        case 60000:
-            /* 1 min */
-            CCMinterval = 6;
-            break;
-        case 600000:
-            /* 10 min */
-            CCMinterval = 7;
-            break;
-        default:
-            /* 1 sec */
-            CCMinterval = 4;
-            break;
+    CCMinterval = encodeInterval(attr->CCMinterval);
+    if (CCMinterval == 0) {
+        /* 1 sec */
+        CCMinterval = 4;
     }
     flags |= (CCMinterval & 0x07);
 
@@ -77,34 +52,45 @@ Dot1agCcm::Dot1agCcm(const Dot1agAttr *attr) : Dot1ag(attr) {
 void Dot1agCcm::addCcm(uint8_t md_level, const char *md, const char *ma, uint16_t mepid,
         uint32_t CCIsentCCMs) {
 
-    int i;
     struct cfm_cc *cfm_cc;
-    uint8_t *p;
-    int mdnl;
-    int smanl;
-    int max_smanl;
 
-    cfm_cc = (struct cfm_cc *) (buf + this->packetSize);
+    cfm_cc = (struct cfm_cc *) buf.append(sizeof (struct cfm_cc));
+    if (cfm_cc == NULL) {
+        return;
+    }
 
     /* add 4 octet Sequence Number to packet */
     cfm_cc->seqNumber = htonl(CCIsentCCMs);
     CCIsentCCMs++;
     cfm_cc->mepid = htons(mepid);
-    
+
+    encodeMaid(&cfm_cc->maid, md, ma);
+
+    /* field defined by ITU-T Y.1731, transmit as 0 */
+    memset(cfm_cc->y1731, 0, sizeof (cfm_cc->y1731));
+}
+
+void Dot1agCcm::encodeMaid(struct cfm_maid *maid, const char *md,
+        const char *ma) {
+    uint8_t *p;
+    int mdnl;
+    int smanl;
+    int max_smanl;
+
+    memset(maid, 0, sizeof (struct cfm_maid));
+
     /*
      * To-do: Always assume character string format for now, 
      * use character string (4) as Maintenance Domain Name Format
      */
-    cfm_cc->maid.format = 4;
-    cfm_cc->maid.length = strlen(md);
-    if (cfm_cc->maid.length > DOT1AG_MAX_MD_LENGTH) {
-        cfm_cc->maid.length = DOT1AG_MAX_MD_LENGTH;
+    maid->format = 4;
+    maid->length = strlen(md);
+    if (maid->length > DOT1AG_MAX_MD_LENGTH) {
+        maid->length = DOT1AG_MAX_MD_LENGTH;
     }
     
     /* set p to start of variable part in MAID */
-    p = cfm_cc->maid.var_p;
-    /* fill variable part of MAID with 0 */
-    memset(p, 0, sizeof (cfm_cc->maid.var_p));
+    p = maid->var_p;
     
     /* copy Maintenance Domain Name to MAID */
     mdnl = strlen(md);
@@ -128,19 +114,12 @@ void Dot1agCcm::addCcm(uint8_t md_level, const char *md, const char *ma, uint16_
     
     /* copy Short MA Name to MAID */
     memcpy(p, ma, smanl);
-    /* field defined by ITU-T Y.1731, transmit as 0 */
-    memset(cfm_cc->y1731, 0, sizeof (cfm_cc->y1731));
-
-    this->packetSize += sizeof (struct cfm_cc);
-
 }
 
 int Dot1agCcm::cfmMatchCcm(const uint8_t *data) const {
     struct cfmencap *cfmencap;
     struct cfmhdr *cfmhdr;
     int i;
-    uint8_t *dst = etherHeader_p->ether_dhost;
-    uint8_t *src = etherHeader_p->ether_shost;
 
     cfmencap = (struct cfmencap *) data;
 
@@ -164,3 +143,28 @@ int Dot1agCcm::cfmMatchCcm(const uint8_t *data) const {
     return (1);
 }
 
+
+/*
+ * The CCM Interval field, from 1 (3.33 ms) to 7 (10 min), in us; 0 is not
+ * a valid interval
+ */
+static const uint32_t ccmIntervalUsec[8] = {
+    0, 3333, 10000, 100000, 1000000, 10000000, 60000000, 600000000
+};
+
+int Dot1agCcm::encodeInterval(uint32_t ms) {
+    /* 3.33 ms does not make a whole ms, 3 stands for it */
+    if (ms == 3) {
+        return 1;
+    }
+    for (int code = 2; code < 8; code++) {
+        if (ccmIntervalUsec[code] == ms * 1000) {
+            return code;
+        }
+    }
+    return 0;
+}
+
+uint32_t Dot1agCcm::decodeInterval(uint8_t code) {
+    return ccmIntervalUsec[code & 0x07];
+}
@@ -20,6 +20,9 @@
 using namespace std;
 
 #include "dot1ag/Dot1agLbm.h"
+#include "dot1ag/TlvIterator.h"
+
+const uint32_t Dot1agLbm::LBR_TIMEOUT;
 
 Dot1agLbm::Dot1agLbm(const Dot1agAttr *attr) : Dot1ag(attr) {
     uint32_t nextLBMtransID;
@@ -35,8 +38,8 @@ Dot1agLbm::Dot1agLbm(const Dot1agAttr *attr) : Dot1ag(attr) {
     /* initialize transaction ID with random value */
     nextLBMtransID = random();
     
+    buf.append(sizeof (struct cfm_tid));
     setTransId(nextLBMtransID);
-    packetSize += sizeof (uint32_t);
 
     /*
      *  finally add Sender ID TLV
@@ -52,26 +55,28 @@ Dot1agLbm::Dot1agLbm(const Dot1agAttr *attr) : Dot1ag(attr) {
 /*
  * Return 1 if the frame in buf matches the expected LBR, return 0 otherwise
  */
-int Dot1agLbm::cfm_matchlbr(const uint8_t *data) {
+int Dot1agLbm::cfm_matchlbr(const uint8_t *data, uint32_t size) {
+    return cfm_matchlbr(data, size, this->getTransId());
+}
+
+int Dot1agLbm::cfm_matchlbr(const uint8_t *data, uint32_t size,
+        uint32_t transId) {
     struct cfmencap *cfmencap;
-    struct cfmhdr *cfmhdr;
+    const struct cfmhdr *cfmhdr;
+    int verbose;
     int i;
-    uint8_t *dst = etherHeader_p->ether_dhost;
-    uint8_t *src = etherHeader_p->ether_shost;
+    uint8_t *dst = etherHeader()->ether_dhost;
+    uint8_t *src = etherHeader()->ether_shost;
 
+    /* traced only if asked for, it is called on the event loop */
+    verbose = this->attr != NULL && this->attr->verbose;
     cfmencap = (struct cfmencap *) data;
 
-    /* Check ethertype */
-    if (IS_TAGGED(data)) {
-        if (cfmencap->ethertype != htons(ETYPE_CFM)) {
-            return (EXIT_FAILURE);
-        }
-    } else {
-        if (cfmencap->tpid != htons(ETYPE_CFM)) {
-            return (EXIT_FAILURE);
-        }
+    /* Check ethertype, whatever the tagging */
+    cfmhdr = frameCfmHdr(classifyFrame(data, size), data);
+    if (cfmhdr == NULL) {
+        return (EXIT_FAILURE);
     }
-    cout << "  CFM EtherType mached..." << endl;
     for (i = 0; i < ETHER_ADDR_LEN; i++) {
         if (cfmencap->dstmac[i] != src[i]) {
             return (EXIT_FAILURE);
@@ -80,37 +85,65 @@ int Dot1agLbm::cfm_matchlbr(const uint8_t *data) {
             return (EXIT_FAILURE);
         }
     }
-    cout << "  Ether Mac addresss matched..." << endl;
-    cfmhdr = CFMHDR(data);
     if (cfmhdr->opcode != CFM_LBR) {
         return (EXIT_FAILURE);
     }
-    cout << "  CFM opcode matched..." << endl;
-    
-        struct cfm_tid *p;
 
-    p = POS_CFM_TID(data);
-    
-    if (ntohl(p->transID) != this->getTransId()) {
-        cout << "  TID mismatched: mine is " << this->getTransId() << " while received: " << ntohl(p->transID) << endl;
+    /* the Transaction ID and TLVs must end within the frame */
+    if (TlvIterator::validate(data, size) != EXIT_SUCCESS ||
+            (const uint8_t *) (cfmhdr + 1) + sizeof (struct cfm_tid) >
+            data + size) {
+        if (verbose) {
+            fprintf(stderr, "LBR with malformed TLVs, discard frame\n");
+        }
+        return (EXIT_FAILURE);
+    }
+
+    const struct cfm_tid *p;
+
+    p = (const struct cfm_tid *) (cfmhdr + 1);
+
+    if (ntohl(p->transID) != transId) {
+        if (verbose) {
+            fprintf(stderr, "LBR of transaction ID %u, expected %u\n",
+                    ntohl(p->transID), transId);
+        }
         return (EXIT_FAILURE);
     }
-    cout << "  CFM TID matched." << endl;
     return (EXIT_SUCCESS);
 }
 
 int Dot1agLbm::convertDotagLbm2Lbr(Dot1ag *lb, const uint8_t *localMac) {
-        uint8_t *lb_frame = lb->getPacketData();
-        
-	struct cfmhdr *cfmhdr;
-	struct ether_header *lbr_ehdr;
-	int i;
+	/*
+	 * a multicast source is dropped silently by validateLbm(), as any
+	 * frame on the RX path: a flood of them must not flood the log too
+	 */
+	return convertLbm2Lbr(lb->getPacketData(), lb->getPacketSize(),
+		localMac);
+}
+
+int Dot1agLbm::validateLbm(const uint8_t *frame, uint32_t size,
+        const uint8_t *localMac) {
+	const struct cfmhdr *cfmhdr;
+	const struct ether_header *lbm_ehdr;
+
+	/* CFM header, Transaction ID and End TLV at least */
+	cfmhdr = frameCfmHdr(classifyFrame(frame, size), frame);
+	if (cfmhdr == NULL) {
+		return EXIT_FAILURE;
+	}
+	if ((const uint8_t *) cfmhdr - frame + sizeof (struct cfmhdr) +
+		sizeof (struct cfm_tid) + 1 > size) {
+		return EXIT_FAILURE;
+	}
+	if (cfmhdr->opcode != CFM_LBM) {
+		return EXIT_FAILURE;
+	}
 
-	lbr_ehdr = (struct ether_header *) lb_frame;
+	lbm_ehdr = (const struct ether_header *) frame;
 
 	/* check for valid source mac address */
-	if (ETHER_IS_MCAST(lbr_ehdr->ether_shost)) {
-		fprintf(stderr, "LBR received from multicast address\n");
+	if (ETHER_IS_MCAST(lbm_ehdr->ether_shost)) {
 		return EXIT_FAILURE;
 	}
 
@@ -118,11 +151,22 @@ int Dot1agLbm::convertDotagLbm2Lbr(Dot1ag *lb, const uint8_t *localMac) {
 	 * Destination mac address should be either our MAC address or the
 	 * CCM group address.
 	 */
-	if (!(ETHER_IS_CCM_GROUP(lbr_ehdr->ether_dhost) ||
-		ETHER_IS_EQUAL(lbr_ehdr->ether_dhost, localMac))) {
+	if (!(ETHER_IS_CCM_GROUP(lbm_ehdr->ether_dhost) ||
+		ETHER_IS_EQUAL(lbm_ehdr->ether_dhost, localMac))) {
 		/* silently drop LBM */
 		return EXIT_FAILURE;
 	}
+	return EXIT_SUCCESS;
+}
+
+void Dot1agLbm::turnLbm2Lbr(uint8_t *frame, FrameTagging tagging,
+        const uint8_t *localMac) {
+	struct ether_header *lbr_ehdr;
+	struct cfmhdr *cfmhdr;
+	int i;
+
+	lbr_ehdr = (struct ether_header *) frame;
+	cfmhdr = (struct cfmhdr *) frameCfmHdr(tagging, frame);
 
 	/* set proper src and dst mac addresses */
 	for (i = 0; i < ETHER_ADDR_LEN; i++) {
@@ -130,8 +174,14 @@ int Dot1agLbm::convertDotagLbm2Lbr(Dot1ag *lb, const uint8_t *localMac) {
 		lbr_ehdr->ether_shost[i] = localMac[i];
 	}
 
-	cfmhdr = CFMHDR(lb_frame);
 	cfmhdr->opcode = CFM_LBR;
+}
 
+int Dot1agLbm::convertLbm2Lbr(uint8_t *frame, uint32_t size,
+        const uint8_t *localMac) {
+	if (validateLbm(frame, size, localMac) != EXIT_SUCCESS) {
+		return EXIT_FAILURE;
+	}
+	turnLbm2Lbr(frame, classifyFrame(frame, size), localMac);
 	return EXIT_SUCCESS;
 }
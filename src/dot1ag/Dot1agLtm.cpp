@@ -1,58 +1,26 @@
 /*
- * To change this license header, choose License Headers in Project Properties.
- * To change this template file, choose Tools | Templates
- * and open the template in the editor.
+ * @brief: Dot1ag CMF_LTM PDU Encapsulation with type/length media
+ *
+ *    Copyright (c) 2017
+ *    Author: James Wang
+ *    All rights reserved.
+ *
+ * Created on March 7, 2017
  */
 
-#include "config.h"
-
-#include <stdint.h>
-#include <unistd.h>
-#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
-#include <sys/socket.h>
-#include <net/if.h>
-#include <time.h>
-
-#include <sys/ioctl.h>
-
-#ifdef HAVE_NET_BPF_H
-#include <sys/types.h>
-#include <net/bpf.h>
-#include <ifaddrs.h>
-#include <net/if_dl.h>
-#else
-#include <netpacket/packet.h>
-#endif
-
-
-
-#include <pcap.h>
-
 
-#include "dot1ag/Dot1ag.h"
-
-Dot1agLtm::Dot1agLtm(int vlan, uint8_t *srcmac, uint8_t *dstmac): buf{0},
-            currentPos (buf), packetSize(sizeof(struct ether_header)) {
-        int i;
-        struct ether_header *p = (struct ether_header *) buf;
-
-        /* set destination MAC address */
-        for (i = 0; i < ETHER_ADDR_LEN; i++) {
-                p->ether_dhost[i] = dstmac[i];
-        }
-
-        /* set source MAC address */
-        for (i = 0; i < ETHER_ADDR_LEN; i++) {
-                p->ether_shost[i] = srcmac[i];
-        }
-
-        
-}
+#include <iostream>
+using namespace std;
 
+#include "dot1ag/Dot1agLtm.h"
+#include "dot1ag/TlvIterator.h"
 
+const uint32_t Dot1agLtm::LTR_TIMEOUT;
+const uint8_t Dot1agLtm::FLAG_USE_FDB_ONLY;
 
 /*
  *  Linktrace Message Format
@@ -73,90 +41,68 @@ Dot1agLtm::Dot1agLtm(int vlan, uint8_t *srcmac, uint8_t *dstmac): buf{0},
  *  | END TLV (0)               |
  *  +---------------------------+
  */
-
-void Dot1agLtm::cfm_addltm(uint32_t transID, uint8_t ttl, uint8_t *orig_mac,
-                uint8_t *target_mac) {
-
-        struct cfm_ltm *p;
-        int i;
-
-        p = POS_CFM_LTM(buf);
-        p->transID = htonl(transID);
-        p->ttl = ttl;
-        for (i = 0; i < ETHER_ADDR_LEN; i++) {
-                p->orig_mac[i] = orig_mac[i];
-                p->target_mac[i] = target_mac[i];
-        }
+Dot1agLtm::Dot1agLtm(const Dot1agAttr *attr, uint8_t ttl) : Dot1ag(attr) {
+    /* 01:80:C2:00:00:38 to 3F, by the MD level */
+    uint8_t group[ETHER_ADDR_LEN] = {0x01, 0x80, 0xc2, 0x00, 0x00, 0x38};
+    uint8_t egressId[2 + ETHER_ADDR_LEN] = {0};
+    struct cfm_ltm *p;
+
+    group[ETHER_ADDR_LEN - 1] |= attr->md_level & 0x07;
+    setDstMac(group);
+
+    /* add CFM common header to packet */
+    addCfmHdr(attr->md_level, FLAG_USE_FDB_ONLY, FIRST_TLV_LTM, CFM_LTM,
+            DOT1AG_VERSION_0);
+
+    if (buf.append(sizeof (struct cfm_ltm)) == NULL) {
+        return;
+    }
+    p = POS_CFM_LTM(buf.data());
+    p->transID = 0;
+    p->ttl = ttl;
+    memcpy(p->orig_mac, etherHeader()->ether_shost, ETHER_ADDR_LEN);
+    memset(p->target_mac, 0, ETHER_ADDR_LEN);
+    if (attr->remoteMac != NULL) {
+        Dot1ag::eth_addr_parse(p->target_mac, attr->remoteMac);
+    }
+
+    /* the LTM Egress Identifier: unique ID 0 of the MEP, and its MAC */
+    memcpy(egressId + 2, etherHeader()->ether_shost, ETHER_ADDR_LEN);
+    addTLV(TLV_LTM_EGRESS_IDENTIFIER, sizeof (egressId), egressId);
+
+    /* end packet with End TLV field */
+    addTLV(TLV_END, 0);
 }
 
+void Dot1agLtm::setTtl(uint8_t ttl) {
+    struct cfm_ltm *p;
 
-void Dot1agLtm::cfm_ltm_setttl(uint8_t ttl) {
-        struct cfm_ltm *p;
-
-        p = POS_CFM_LTM(buf);
-        p->ttl = ttl;
-}
-
-void Dot1agLtm::cfm_ltm_settransid(uint32_t trans_id) {
-        struct cfm_ltm *p;
-
-        p = POS_CFM_LTM(buf);
-        p->transID = htonl(trans_id);
-}
-
-
-void Dot1agLtm::cfm_addltr(uint32_t transID, uint8_t ttl, uint8_t action) {
-        struct cfm_ltr *p;
-
-        p = POS_CFM_LTR(buf);
-        p->transID = htonl(transID);
-        p->ttl = ttl;
-        p->action = action;
+    p = POS_CFM_LTM(buf.data());
+    p->ttl = ttl;
 }
 
-
-/*
- * Return 1 if the frame in buf matches the expected LTR, return 0 otherwise
- */
-int Dot1agLtm::cfm_matchltr(uint8_t *dst, uint16_t vlan, uint8_t md_level,
-                         uint32_t trans_id, int *hit_target) {
-        struct cfmencap *encap;
-        struct cfmhdr *cfmhdr;
-        struct cfm_ltr *ltr;
-        int i;
-
-        encap = (struct cfmencap *) buf;
-
-        /* Check ethertype */
-        if (IS_TAGGED(buf)) {
-                if (encap->ethertype != htons(ETYPE_CFM)) {
-                        return (0);
-                }
-        } else {
-                if (encap->tpid != htons(ETYPE_CFM)) {
-                        return (0);
-                }
-        }
-
-        for (i = 0; i < ETHER_ADDR_LEN; i++) {
-                if (encap->dstmac[i] != dst[i]) {
-                        return 0;
-                }
-        }
-        cfmhdr = CFMHDR(buf);
-        /* check if this is an LTR frame */
-        if (cfmhdr->opcode != CFM_LTR) {
-                return 0;
-        }
-        ltr = (struct cfm_ltr *) POS_CFM_LTR(buf);
-        /* check for correct nextTransID */
-        if (ntohl(ltr->transID) != trans_id) {
-                return 0;
-        }
-
-        if (ltr->action == ACTION_RLYHIT) {
-                *hit_target = 1;
-        }
-        return 1;
+int Dot1agLtm::parseLtr(const uint8_t *frame, uint32_t size,
+        const uint8_t *localMac, uint8_t &ttl, uint8_t &action) {
+    const struct ether_header *ehdr = (const struct ether_header *) frame;
+    const struct cfmhdr *cfmhdr;
+    const struct cfm_ltr *ltr;
+
+    cfmhdr = frameCfmHdr(classifyFrame(frame, size), frame);
+    if (cfmhdr == NULL || cfmhdr->opcode != CFM_LTR) {
+        return EXIT_FAILURE;
+    }
+    /* the LTRs go back to the Original MAC Address of the LTM */
+    if (!ETHER_IS_EQUAL(ehdr->ether_dhost, localMac)) {
+        return EXIT_FAILURE;
+    }
+    /* the fields and TLVs must end within the frame */
+    if (TlvIterator::validate(frame, size) != EXIT_SUCCESS ||
+            (const uint8_t *) (cfmhdr + 1) + sizeof (struct cfm_ltr) >
+            frame + size) {
+        return EXIT_FAILURE;
+    }
+    ltr = (const struct cfm_ltr *) (cfmhdr + 1);
+    ttl = ltr->ttl;
+    action = ltr->action;
+    return EXIT_SUCCESS;
 }
-
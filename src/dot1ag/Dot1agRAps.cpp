@@ -8,10 +8,11 @@
  * Created on March 7, 2017
  */
 
-#include "dot1ag/net_common.h";
+#include "dot1ag/net_common.h"
 
 #include "dot1ag/Dot1agRAps.h"
 #include "dot1ag/NetIf.h"
+#include "dot1ag/TlvIterator.h"
 
 Dot1agRAps::Dot1agRAps(const Dot1agAttr *attr) : Dot1ag(attr) {
 
@@ -22,7 +23,7 @@ Dot1agRAps::Dot1agRAps(const Dot1agAttr *attr) : Dot1ag(attr) {
     /* add CFM common header to packet */
     addCfmHdr(attr->md_level, 0, FIRST_TLV_RAPS, CFM_RAPS, DOT1AG_VERSION_1);
 
-    addRAps(ERP_PKTIO_PDU_REQUEST_SIGNAL_FAIL, etherHeader_p->ether_shost);
+    addRAps(ERP_PKTIO_PDU_REQUEST_SIGNAL_FAIL, etherHeader()->ether_shost);
 
     /* end packet with End TLV field */
     addTLV(TLV_END, 0);    
@@ -31,61 +32,86 @@ Dot1agRAps::Dot1agRAps(const Dot1agAttr *attr) : Dot1ag(attr) {
 void Dot1agRAps::addRAps(uint8_t request, uint8_t *nid) {
 
     struct raps_pdu *p;
+    uint8_t nodeID[ETHER_ADDR_LEN];
     int i;
 
-    /* Move pointer to the start of R-APS pdu position */
-    p = (struct raps_pdu *) POS_CFM_PDU(buf);
+    /* nid may point into our own frame, which moves when growing */
+    memcpy(nodeID, nid, ETHER_ADDR_LEN);
+
+    /* Make room for the R-APS pdu, right behind the CFM header */
+    if (buf.append(sizeof (struct raps_pdu)) == NULL) {
+        return;
+    }
+    p = (struct raps_pdu *) POS_CFM_PDU(buf.data());
 
     p->subcode = request;
 
     for (i = 0; i < ETHER_ADDR_LEN; i++) {
-        p->nodeID[i] = nid[i];
+        p->nodeID[i] = nodeID[i];
     }
-
-    packetSize += sizeof (struct raps_pdu);
 }
 
-int Dot1agRAps::cfmMatchRAps(const uint8_t *data) const {
-    struct cfmencap *cfmencap;
-    struct cfmhdr *cfmhdr;
-    int i;
-    uint8_t *dst = etherHeader_p->ether_dhost;
-    uint8_t *src = etherHeader_p->ether_shost;
-
-    cfmencap = (struct cfmencap *) data;
+template <class Layout>
+int Dot1agRAps::matchRAps(const uint8_t *data, uint32_t size) const {
+    const struct cfmhdr *cfmhdr;
 
-    /* Check ethertype */
-    if (IS_TAGGED(data)) {
-        if (cfmencap->ethertype != htons(ETYPE_CFM)) {
-            return (0);
-        }
-    } else {
-        if (cfmencap->tpid != htons(ETYPE_CFM)) {
-            return (0);
-        }
-    }
-    cout << "  CFM EtherType matched..." << endl;
-    
     /*
+    const uint8_t *dst = ((const struct ether_header *) buf.data())->ether_dhost;
+    const uint8_t *src = ((const struct ether_header *) buf.data())->ether_shost;
     for (i = 0; i < ETHER_ADDR_LEN; i++) {
-        if (cfmencap->dstmac[i] != src[i]) {
+        if (data[i] != src[i]) {
             return (0);
         }
-        if (cfmencap->srcmac[i] != dst[i]) {
+        if (Layout::srcMac(data)[i] != dst[i]) {
             return (0);
         }
     }
     cout << "  Eth Mac addresss matched..." << endl;
      */
-    
-    cfmhdr = CFMHDR(data);
+
+    cfmhdr = Layout::cfmhdr(data);
     if (cfmhdr->opcode != CFM_RAPS) {
         return (0);
     }
     cout << "  CFM opcode matched..." << endl;
 
+    /* the R-APS PDU is followed by the End TLV, within the frame */
+    if (size < Layout::PDU_OFFSET + sizeof (struct raps_pdu)) {
+        cout << "  Truncated R-APS PDU" << endl;
+        return (0);
+    }
+    TlvIterator tlvs(Layout::firstTlv(data), data + size);
+    CfmTlv tlv;
+    while (tlvs.next(tlv)) {
+        ;
+    }
+    if (!tlvs.isDone()) {
+        cout << "  Malformed TLVs" << endl;
+        return (0);
+    }
+
     return (1);
 }
 
+int Dot1agRAps::cfmMatchRAps(const Dot1ag *packet) const {
+    const uint8_t *data = packet->getPacketBuf().data();
+    uint32_t size = packet->getPacketSize();
+
+    /* the frame was classified when received, pick its layout */
+    switch (packet->getTagging()) {
+        case FRAME_UNTAGGED:
+            cout << "  CFM EtherType matched..." << endl;
+            return matchRAps<UntaggedLayout>(data, size);
+        case FRAME_DOT1Q:
+            cout << "  CFM EtherType matched..." << endl;
+            return matchRAps<Dot1qLayout>(data, size);
+        case FRAME_DOT1AD:
+            cout << "  CFM EtherType matched..." << endl;
+            return matchRAps<Dot1adLayout>(data, size);
+        default:
+            return (0);
+    }
+}
+
 uint8_t Dot1agRAps::rApsDstMac[ETHER_ADDR_LEN] = {0x01, 0x19, 0xA7, 0x00, 0x00, 0x01};
 
@@ -0,0 +1,153 @@
+/*
+ * @brief: Non-blocking sink of the state change events of the MEPs
+ *
+ *    Copyright (c) 2017
+ *    Author: James Wang
+ *    All rights reserved.
+ *
+ * Created on March 7, 2017
+ */
+
+#include <stdlib.h>
+
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <chrono>
+
+#include "dot1ag/EventLog.h"
+#include "dot1ag/MonoTime.h"
+
+const uint32_t EventLog::DEFAULT_CAPACITY;
+const uint32_t EventLog::DRAIN_MSEC;
+
+EventLog::EventLog(uint32_t producers, uint32_t capacity, string name) :
+Runnable(name) {
+    /* round up to a power of 2, for the index to wrap with a mask */
+    capacity_ = 1;
+    while (capacity_ < capacity) {
+        capacity_ <<= 1;
+    }
+    for (uint32_t i = 0; i < producers; i++) {
+        Ring *ring = new Ring();
+
+        ring->head.store(0, memory_order_relaxed);
+        ring->tail.store(0, memory_order_relaxed);
+        ring->dropped.store(0, memory_order_relaxed);
+        ring->events.resize(capacity_);
+        rings_.push_back(ring);
+    }
+    asleep_.store(false, memory_order_relaxed);
+}
+
+EventLog::~EventLog() {
+    for (size_t i = 0; i < rings_.size(); i++) {
+        delete rings_[i];
+    }
+}
+
+const char *EventLog::typeName(uint8_t type) {
+    static const char *names[] = {
+        "UP", "DOWN", "FLAPPED", "SUPPRESSED (flapping)", "REUSED",
+        "sending another CCM interval", "fault alarm", "fault alarm reset",
+        "R-APS SF sent", "LBR lost", "LBR received again"
+    };
+
+    return type < sizeof (names) / sizeof (names[0]) ? names[type] : "?";
+}
+
+uint32_t EventLog::drain(ostream &os) {
+    static const char *defects[] = {
+        "none", "DefRDICCM", "DefMACstatus", "DefRemoteCCM",
+        "DefErrorCCM", "DefXconCCM"
+    };
+    ostringstream out;
+    uint32_t drained = 0;
+
+    for (size_t i = 0; i < rings_.size(); i++) {
+        Ring &ring = *rings_[i];
+        uint32_t tail = ring.tail.load(memory_order_relaxed);
+        uint32_t head = ring.head.load(memory_order_acquire);
+
+        for (; tail != head; tail++, drained++) {
+            const Event &event = ring.events[tail & (capacity_ - 1)];
+
+            out << "  :: " << event.time << " vlan: " << event.vlan <<
+                    " MEPid: " << event.mepid;
+            if (event.rMEPid != 0) {
+                out << " rMEPid: " << event.rMEPid;
+            }
+            out << " " << typeName(event.type);
+            switch (event.type) {
+                case RMEP_UP:
+                case RMEP_DOWN:
+                case RMEP_FLAPPED:
+                    if (event.count > 1 || event.type == RMEP_FLAPPED) {
+                        out << " (" << event.count << " transitions)";
+                    }
+                    break;
+                case RMEP_INTERVAL_MISMATCH:
+                    out << ": " << event.arg << " us";
+                    break;
+                case FAULT_ALARM:
+                case FAULT_ALARM_RESET:
+                    out << ": " << (event.arg < 6 ? defects[event.arg] : "?");
+                    break;
+                case LBR_LOST:
+                case LBR_RECEIVED:
+                    out << ", tid: " << event.arg;
+                    break;
+                default:
+                    break;
+            }
+            out << endl;
+        }
+        /* the slots are the producer's again */
+        ring.tail.store(tail, memory_order_release);
+    }
+    if (drained > 0) {
+        os << out.str() << flush;
+    }
+    return drained;
+}
+
+uint64_t EventLog::getDropped() const {
+    uint64_t dropped = 0;
+
+    for (size_t i = 0; i < rings_.size(); i++) {
+        dropped += rings_[i]->dropped.load(memory_order_relaxed);
+    }
+    return dropped;
+}
+
+bool EventLog::isPending() const {
+    for (size_t i = 0; i < rings_.size(); i++) {
+        if (rings_[i]->head.load(memory_order_relaxed) !=
+                rings_[i]->tail.load(memory_order_relaxed)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void EventLog::task() {
+    MonoTime due;
+    MonoTime now;
+
+    while (1) {
+        /* an event posted from now on wakes the log up */
+        asleep_.store(true, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (!this->isPending()) {
+            waker_.wait();
+        }
+        asleep_.store(false, memory_order_relaxed);
+
+        /* the events of a burst come out together */
+        due = MonoTime::now() + MonoTime::fromMsec(DRAIN_MSEC);
+        this_thread::sleep_for(chrono::milliseconds(DRAIN_MSEC));
+        now = MonoTime::now();
+        this->accountLatency(now > due ? (now - due).usec() : 0);
+        this->drain(cout);
+    }
+}
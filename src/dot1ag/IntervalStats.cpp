@@ -0,0 +1,51 @@
+/*
+ * @brief: Streaming statistics of the intervals between CCMs received
+ *
+ *    Copyright (c) 2017
+ *    Author: James Wang
+ *    All rights reserved.
+ *
+ * Created on March 7, 2017
+ */
+
+#include <string.h>
+
+#include <iomanip>
+
+#include "dot1ag/IntervalStats.h"
+
+const uint32_t IntervalStats::BUCKETS;
+const uint32_t IntervalStats::NOMINAL_BUCKET;
+const uint64_t IntervalStats::FIRST_RATIO;
+const uint32_t IntervalStats::FIRST_INDEX;
+
+void IntervalStats::reset() {
+    last_ = 0;
+    count_ = 0;
+    min_ = 0;
+    max_ = 0;
+    mean_ = 0;
+    m2_ = 0;
+    memset(buckets_, 0, sizeof (buckets_));
+}
+
+double IntervalStats::bucketLow(uint32_t k) {
+    uint32_t index = k + FIRST_INDEX;
+
+    return (double) ((4 + (index & 3)) << (index / 4 - 2)) / 256;
+}
+
+void IntervalStats::print(ostream &os) const {
+    ios::fmtflags flags = os.flags();
+
+    os << "intervals: " << count_ << " min/mean/max: " << min_ << "/" <<
+            fixed << setprecision(0) << mean_ << "/" << max_ <<
+            " us stddev: " << getStddev() << " us" << endl;
+    os << "     x nominal:";
+    for (uint32_t k = 0; k < BUCKETS; k++) {
+        os << " " << setprecision(2) << bucketLow(k) << (k ? "" : "-") <<
+                ":" << buckets_[k];
+    }
+    os << endl;
+    os.flags(flags);
+}
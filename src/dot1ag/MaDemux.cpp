@@ -0,0 +1,62 @@
+/*
+ * @brief: Demultiplexing CFM frames to their MA by VLAN and MD level
+ *
+ *    Copyright (c) 2017
+ *    Author: James Wang
+ *    All rights reserved.
+ *
+ * Created on March 7, 2017
+ */
+
+#include "dot1ag/net_common.h"
+
+#include "dot1ag/MaDemux.h"
+
+MaDemux::MaDemux() : size_(0), unknown_(0) {
+    for (uint32_t i = 0; i < PAGES; i++) {
+        pages_[i] = NULL;
+    }
+}
+
+MaDemux::~MaDemux() {
+    for (uint32_t i = 0; i < PAGES; i++) {
+        delete [] pages_[i];
+    }
+}
+
+int MaDemux::add(uint16_t vlan, uint8_t level, uint32_t ma) {
+    uint16_t *page;
+    uint16_t *entry;
+
+    if (vlan >= VLANS || level >= LEVELS || ma >= NONE) {
+        return EXIT_FAILURE;
+    }
+
+    page = pages_[vlan >> PAGE_BITS];
+    if (page == NULL) {
+        page = new uint16_t[PAGE_VLANS * LEVELS];
+        for (uint32_t i = 0; i < PAGE_VLANS * LEVELS; i++) {
+            page[i] = NONE;
+        }
+        pages_[vlan >> PAGE_BITS] = page;
+    }
+
+    entry = &page[((vlan & (PAGE_VLANS - 1)) << 3) | level];
+    if (*entry != NONE) {
+        return EXIT_FAILURE;
+    }
+    *entry = ma;
+    size_++;
+    return EXIT_SUCCESS;
+}
+
+size_t MaDemux::memoryUsage() const {
+    size_t bytes = sizeof (*this);
+
+    for (uint32_t i = 0; i < PAGES; i++) {
+        if (pages_[i] != NULL) {
+            bytes += PAGE_VLANS * LEVELS * sizeof (uint16_t);
+        }
+    }
+    return bytes;
+}
@@ -0,0 +1,73 @@
+/*
+ * @brief: Matching the MAID of CCMs received against ours
+ *
+ *    Copyright (c) 2017
+ *    Author: James Wang
+ *    All rights reserved.
+ *
+ * Created on March 7, 2017
+ */
+
+#include "dot1ag/net_common.h"
+
+#include "dot1ag/MaidMatcher.h"
+#include "dot1ag/Dot1agCcm.h"
+
+void MaidMatcher::setMaid(const char *md, const char *ma) {
+    Dot1agCcm::encodeMaid((struct cfm_maid *) image_, md, ma);
+}
+
+int MaidMatcher::decodeNames(const struct cfm_maid *maid,
+        char md[DOT1AG_MAX_MD_LENGTH + 1], char ma[MAID_SIZE - 4 + 1]) {
+    const uint8_t *p = maid->var_p;
+    uint8_t mdnl = 0;
+    uint8_t smanl;
+
+    md[0] = '\0';
+    ma[0] = '\0';
+
+    /*
+     * MAID field size is 48 octets
+     * MD Name Format: 1 octet
+     * MD Name Length: 1 octet
+     * Short MA Name Format: 1 octet
+     * Short MA Name Length: 1 octet
+     * MD Name + Short MA Name <= 48 - 4
+     * Zero padding at the end
+     */
+    switch (maid->format) {
+        case 1:
+            /* No Maintenance Domain Name present, no length either */
+            p = &maid->length;
+            break;
+        case 4:
+            /* Character string */
+            mdnl = maid->length;
+            if ((mdnl < 1) || (mdnl > DOT1AG_MAX_MD_LENGTH)) {
+                return EXIT_FAILURE;
+            }
+            memcpy(md, p, mdnl);
+            md[mdnl] = '\0';
+            break;
+        default:
+            /* other formats are not decoded, only skipped */
+            mdnl = maid->length;
+            if (mdnl > DOT1AG_MAX_MD_LENGTH) {
+                return EXIT_FAILURE;
+            }
+            break;
+    }
+    p += mdnl;
+
+    /* Short MA Name Format starts after MD Name */
+    if (*p == 2) {
+        /* Character String */
+        smanl = *(p + 1);
+        if ((smanl < 1) || (smanl > (const uint8_t *) maid + MAID_SIZE - p - 2)) {
+            return EXIT_FAILURE;
+        }
+        memcpy(ma, p + 2, smanl);
+        ma[smanl] = '\0';
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,105 @@
+/*
+ * @brief: State of a local MEP and its remote MEPs, published for readers
+ *         on other threads
+ *
+ *    Copyright (c) 2017
+ *    Author: James Wang
+ *    All rights reserved.
+ *
+ * Created on March 7, 2017
+ */
+
+#include "dot1ag/MepSnapshot.h"
+
+#include <stdlib.h>
+
+MepSnapshot::MepSnapshot() {
+    for (uint32_t k = 0; k < PAGES; k++) {
+        pages_[k].store(NULL, memory_order_relaxed);
+    }
+    size_.store(0, memory_order_relaxed);
+    defects_.store(0, memory_order_relaxed);
+    tx_.seq.store(0, memory_order_relaxed);
+    for (uint32_t w = 0; w < WORDS; w++) {
+        tx_.words[w].store(0, memory_order_relaxed);
+    }
+}
+
+MepSnapshot::~MepSnapshot() {
+    for (uint32_t k = 0; k < PAGES; k++) {
+        delete [] pages_[k].load(memory_order_relaxed);
+    }
+}
+
+MepSnapshot::Cell *MepSnapshot::cellFor(uint32_t slot) {
+    uint32_t index;
+    uint32_t k = pageOf(slot, index);
+    Cell *page;
+
+    if (k >= PAGES) {
+        return NULL;
+    }
+    page = pages_[k].load(memory_order_relaxed);
+    if (page == NULL) {
+        page = new Cell[pageSize(k)];
+        for (uint32_t i = 0; i < pageSize(k); i++) {
+            page[i].seq.store(0, memory_order_relaxed);
+            for (uint32_t w = 0; w < WORDS; w++) {
+                page[i].words[w].store(0, memory_order_relaxed);
+            }
+        }
+        /* the page is filled in before a reader can see it */
+        pages_[k].store(page, memory_order_release);
+    }
+    return &page[index];
+}
+
+int MepSnapshot::read(uint32_t slot, Entry &entry) const {
+    uint32_t index;
+    uint32_t k;
+
+    if (slot >= size()) {
+        return EXIT_FAILURE;
+    }
+    k = pageOf(slot, index);
+
+    /* a slot below size() taken but never published yet reads as 0 */
+    return load(pages_[k].load(memory_order_acquire)[index], &entry,
+            sizeof (entry));
+}
+
+int MepSnapshot::readTx(IntervalStats &tx) const {
+    return load(tx_, &tx, sizeof (tx));
+}
+
+int MepSnapshot::load(const Cell &cell, void *data, size_t size) {
+    uint64_t words[WORDS];
+    uint32_t before;
+    uint32_t after;
+
+    do {
+        before = cell.seq.load(memory_order_acquire);
+        for (uint32_t i = 0; i < WORDS; i++) {
+            words[i] = cell.words[i].load(memory_order_relaxed);
+        }
+        atomic_thread_fence(memory_order_acquire);
+        after = cell.seq.load(memory_order_relaxed);
+    } while ((before & 1) || before != after);
+
+    if (before == 0) {
+        return EXIT_FAILURE;
+    }
+    memcpy(data, words, size);
+    return EXIT_SUCCESS;
+}
+
+size_t MepSnapshot::memoryUsage() const {
+    size_t bytes = sizeof (*this);
+
+    for (uint32_t k = 0; k < PAGES; k++) {
+        if (pages_[k].load(memory_order_relaxed) != NULL) {
+            bytes += pageSize(k) * sizeof (Cell);
+        }
+    }
+    return bytes;
+}
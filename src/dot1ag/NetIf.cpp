@@ -10,6 +10,7 @@
 
 #include "dot1ag/net_common.h"
 
+#include <poll.h>
 #include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <net/if.h>
@@ -24,7 +25,10 @@
 #endif
 
 #include "dot1ag/NetIf.h"
+#include "dot1ag/Dot1agLbm.h"
 
+const uint32_t NetIf::TX_BATCH;
+const uint32_t NetIf::RX_BUDGET;
 
 NetIf::NetIf(const char *ifname, string name) :
 txBuffer(), ifname_(ifname), rxBuffer(), Runnable(name + " - " + string(ifname)) {
@@ -32,16 +36,40 @@ txBuffer(), ifname_(ifname), rxBuffer(), Runnable(name + " - " + string(ifname))
     this->mutex_ = new mutex();
     this->cond_ = new condition_variable();
     this->rx = new RX(this);
+    this->pcap_ = NULL;
 
     getSrcMac(this->localMac, ifname);
+
+    this->txSock_ = -1;
+    this->ifindex_ = -1;
+    openTxChannel();
+
+    this->lbrRate_ = 0;
+    this->lbrBurst_ = 0;
+    memset(&this->lbrBucket_, 0, sizeof (this->lbrBucket_));
+    for (uint32_t i = 0; i < LBR_VLANS; i++) {
+        this->lbrLevels_[i].store(0, memory_order_relaxed);
+    }
+    this->lbrReflected_ = 0;
+    this->lbrRateLimited_ = 0;
+    this->lbrInvalid_ = 0;
+    this->lbrTxErrors_ = 0;
 }
 
 NetIf::~NetIf() {
     /* Note: mutex and cond_ have been taken care of by Runnable */
 
+    if (this->txSock_ >= 0) {
+        close(this->txSock_);
+    }
+
     if (this->rx != NULL) {
         delete this->rx;
     }
+
+    if (this->pcap_ != NULL) {
+        pcap_close(this->pcap_);
+    }
 }
 
 int NetIf::registerListener(uint16_t etherType, NetIfListener *listener) {
@@ -60,22 +88,40 @@ pcap_t * NetIf::setupPcap() {
 
     /*
      * Filter on CFM frames, i.e. ether[12:2] == 0x8902 for untagged
-     * frames or ether[16:2] == 0x8902 for tagged frames. Destination
-     * MAC address should be our MAC address.
+     * frames, ether[16:2] == 0x8902 for tagged frames or ether[20:2] ==
+     * 0x8902 for double tagged ones. Destination MAC address should be
+     * our MAC address.
      */
     sprintf(filter_src, "not ether src %02x:%02x:%02x:%02x:%02x:%02x and "
             "(ether[12:2] == 0x%x or "
-            " (ether[12:2] == 0x%x and ether[16:2] == 0x%x))",
+            " (ether[12:2] == 0x%x and ether[16:2] == 0x%x) or "
+            " (ether[12:2] == 0x%x and ether[16:2] == 0x%x and "
+            "  ether[20:2] == 0x%x))",
             this->localMac[0], localMac[1], localMac[2],
             localMac[3], localMac[4], localMac[5],
-            ETYPE_CFM, ETYPE_8021Q, ETYPE_CFM);
+            ETYPE_CFM, ETYPE_8021Q, ETYPE_CFM,
+            ETYPE_8021AD, ETYPE_8021Q, ETYPE_CFM);
 
     /* open pcap device for listening */
-    handle = pcap_open_live(ifname_, BUFSIZ, 1, 200, errbuf);
+    handle = pcap_create(ifname_, errbuf);
     if (handle == NULL) {
         perror(errbuf);
         return (handle);
     }
+    pcap_set_snaplen(handle, BUFSIZ);
+    pcap_set_promisc(handle, 1);
+    pcap_set_timeout(handle, 200);
+
+    /*
+     * a frame is ours as soon as received, rather than once a buffer of
+     * them is full or the timeout above has run out
+     */
+    pcap_set_immediate_mode(handle, 1);
+    if (pcap_activate(handle) < 0) {
+        pcap_perror(handle, "pcap_activate");
+        pcap_close(handle);
+        return NULL;
+    }
 
     /* Compile and apply the filter */
 
@@ -129,6 +175,13 @@ int NetIf::bufferPacket(Dot1ag* packet) {
                 hex << setfill('0') << setw(4) << (uint32_t) etype << endl;
         cout << dec;
 
+        /* nobody to take it from rxBuffer with the NetIf not started */
+        if (this->thread_ == NULL) {
+            packet->printPacket();
+            delete packet;
+            return EXIT_SUCCESS;
+        }
+
         mutex_->lock();
         rxBuffer.push_back(packet);
 
@@ -143,6 +196,76 @@ int NetIf::bufferPacket(Dot1ag* packet) {
     return EXIT_SUCCESS;
 }
 
+void NetIf::setLbrFastPath(uint32_t rate, uint32_t burst) {
+    if (burst == 0) {
+        burst = 1;
+    }
+    this->lbrRate_ = rate;
+    this->lbrBurst_ = (uint64_t) burst * 1000000;
+    this->lbrBucket_.tokens = this->lbrBurst_;
+}
+
+void NetIf::getLbrFastPathStats(LbrFastPathStats &stats) const {
+    stats.reflected = this->lbrReflected_;
+    stats.rateLimited = this->lbrRateLimited_;
+    stats.invalid = this->lbrInvalid_;
+    stats.txErrors = this->lbrTxErrors_;
+}
+
+void NetIf::addLbrMa(uint16_t vlan, uint8_t level) {
+    if (vlan < LBR_VLANS && level < 8) {
+        this->lbrLevels_[vlan].fetch_or(1 << level, memory_order_relaxed);
+    }
+}
+
+bool NetIf::reflectLbm(uint8_t *frame, uint32_t size, uint64_t nowUsec) {
+    const struct cfmhdr *cfmhdr;
+    FrameTagging tagging;
+    uint16_t vlan;
+
+    /* classified here, as a reflected LBM never makes it to a Dot1ag */
+    tagging = classifyFrame(frame, size);
+    cfmhdr = frameCfmHdr(tagging, frame);
+    if (cfmhdr == NULL || cfmhdr->opcode != CFM_LBM) {
+        return false;
+    }
+
+    /* of an MA of ours only, the slow path knows what to do with others */
+    switch (tagging) {
+        case FRAME_DOT1Q:
+            vlan = Dot1qLayout::vlan(frame);
+            break;
+        case FRAME_DOT1AD:
+            vlan = Dot1adLayout::vlan(frame);
+            break;
+        default:
+            vlan = 0;
+            break;
+    }
+    if (!(this->lbrLevels_[vlan].load(memory_order_relaxed) &
+            (1 << GET_MD_LEVEL(cfmhdr)))) {
+        return false;
+    }
+
+    /* a token is only spent on an LBM to be answered */
+    if (Dot1agLbm::validateLbm(frame, size, this->localMac) != EXIT_SUCCESS) {
+        this->lbrInvalid_++;
+        return true;
+    }
+    if (!this->lbrBucket_.consume(this->lbrRate_, this->lbrBurst_, nowUsec)) {
+        this->lbrRateLimited_++;
+        return true;
+    }
+
+    Dot1agLbm::turnLbm2Lbr(frame, tagging, this->localMac);
+    if (transmit(frame, size) == EXIT_SUCCESS) {
+        this->lbrReflected_++;
+    } else {
+        this->lbrTxErrors_++;
+    }
+    return true;
+}
+
 /*
  * Note: BPF is prefered for eth raw packet sending
  */
@@ -238,6 +361,26 @@ int NetIf::sendPacket(const char *ifname) {
     return 0;
 }
 
+/* No persistent channel with BPF, a device is opened per frame */
+int NetIf::openTxChannel() {
+    return EXIT_FAILURE;
+}
+
+int NetIf::transmit(const uint8_t *data, uint32_t size) {
+    return NetIf::sendPacket(this->ifname_, (uint8_t *) data, size);
+}
+
+uint32_t NetIf::transmitBatch(Dot1ag * const *packets, uint32_t count) {
+    uint32_t sent = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (this->sendPacket(packets[i]) == EXIT_SUCCESS) {
+            sent++;
+        }
+    }
+    return sent;
+}
+
 #else
 
 int NetIf::getSrcMac(uint8_t *ea, const char *dev) {
@@ -272,11 +415,127 @@ int NetIf::getSrcMac(uint8_t *ea, const char *dev) {
 
 }
 
+int NetIf::openTxChannel() {
+    struct ifreq req;
+
+    /* protocol 0: the socket is for sending only, nothing is received */
+    if ((this->txSock_ = socket(PF_PACKET, SOCK_RAW, 0)) < 0) {
+        perror("opening TX socket");
+        return (EXIT_FAILURE);
+    }
+
+    /* get interface index */
+    memset(&req, 0, sizeof (req));
+    strncpy(req.ifr_name, this->ifname_, sizeof (req.ifr_name) - 1);
+    if (ioctl(this->txSock_, SIOCGIFINDEX, &req)) {
+        perror(this->ifname_);
+        close(this->txSock_);
+        this->txSock_ = -1;
+        return (EXIT_FAILURE);
+    }
+    this->ifindex_ = req.ifr_ifindex;
+
+    return EXIT_SUCCESS;
+}
+
+int NetIf::transmit(const uint8_t *data, uint32_t size) {
+    struct sockaddr_ll addr_out;
+    uint8_t pad[ETHER_MIN_LEN];
+
+    if (this->txSock_ < 0) {
+        return NetIf::sendPacket(this->ifname_, (uint8_t *) data, size);
+    }
+
+    /* minimum size of Ethernet frames is ETHER_MIN_LEN octets */
+    if (size < ETHER_MIN_LEN) {
+        memset(pad, 0, sizeof (pad));
+        memcpy(pad, data, size);
+        data = pad;
+        size = ETHER_MIN_LEN;
+    }
+
+    /* set socket address parameters */
+    memset(&addr_out, 0, sizeof (addr_out));
+    addr_out.sll_family = AF_PACKET;
+    addr_out.sll_protocol = htons(ETH_P_ALL);
+    addr_out.sll_halen = ETH_ALEN;
+    addr_out.sll_ifindex = this->ifindex_;
+    addr_out.sll_pkttype = PACKET_OTHERHOST;
+
+    if ((sendto(this->txSock_, data, size, 0, (struct sockaddr *) &addr_out,
+            sizeof (addr_out))) < 0) {
+        perror("sendto");
+        return (EXIT_FAILURE);
+    }
+    return EXIT_SUCCESS;
+}
+
+uint32_t NetIf::transmitBatch(Dot1ag * const *packets, uint32_t count) {
+    static const uint8_t zeros[ETHER_MIN_LEN] = {0};
+    struct sockaddr_ll addr_out;
+    struct mmsghdr msgs[TX_BATCH];
+    struct iovec iov[TX_BATCH][2];
+    uint32_t sent = 0;
+    uint32_t done = 0;
+    uint32_t n;
+    int status;
+
+    if (this->txSock_ < 0) {
+        for (uint32_t i = 0; i < count; i++) {
+            if (this->sendPacket(packets[i]) == EXIT_SUCCESS) {
+                sent++;
+            }
+        }
+        return sent;
+    }
+
+    memset(&addr_out, 0, sizeof (addr_out));
+    addr_out.sll_family = AF_PACKET;
+    addr_out.sll_protocol = htons(ETH_P_ALL);
+    addr_out.sll_halen = ETH_ALEN;
+    addr_out.sll_ifindex = this->ifindex_;
+    addr_out.sll_pkttype = PACKET_OTHERHOST;
+
+    while (done < count) {
+        n = count - done < TX_BATCH ? count - done : TX_BATCH;
+        memset(msgs, 0, n * sizeof (msgs[0]));
+        for (uint32_t i = 0; i < n; i++) {
+            Dot1ag *packet = packets[done + i];
+            uint32_t size = packet->getPacketSize();
+
+            iov[i][0].iov_base = packet->getPacketData();
+            iov[i][0].iov_len = size;
+            /* padded to ETHER_MIN_LEN octets, out of a shared zero buffer */
+            iov[i][1].iov_base = (void *) zeros;
+            iov[i][1].iov_len = size < ETHER_MIN_LEN ? ETHER_MIN_LEN - size : 0;
+            msgs[i].msg_hdr.msg_name = &addr_out;
+            msgs[i].msg_hdr.msg_namelen = sizeof (addr_out);
+            msgs[i].msg_hdr.msg_iov = iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 2;
+        }
+
+        status = sendmmsg(this->txSock_, msgs, n, 0);
+        if (status < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            /* the first frame failed: drop it, go on with the others */
+            perror("sendmmsg");
+            done++;
+            continue;
+        }
+        sent += status;
+        done += status;
+    }
+    return sent;
+}
+
 int NetIf::sendPacket(const char * ifname, uint8_t *data, uint32_t size) {
     int ifindex;
     int s;
     struct ifreq req;
     struct sockaddr_ll addr_out;
+    uint8_t pad[ETHER_MIN_LEN];
 
 
     if (geteuid() != 0) {
@@ -286,6 +545,9 @@ int NetIf::sendPacket(const char * ifname, uint8_t *data, uint32_t size) {
 
     /* minimum size of Ethernet frames is ETHER_MIN_LEN octets */
     if (size < ETHER_MIN_LEN) {
+        memset(pad, 0, sizeof (pad));
+        memcpy(pad, data, size);
+        data = pad;
         size = ETHER_MIN_LEN;
     }
 
@@ -328,77 +590,121 @@ ostream & operator<<(ostream& os, const NetIf &nif) {
     return os;
 }
 
-void NetIf::RX::task() {
-    int n;
-    struct cfmhdr *cfmhdr;
-    struct pcap_pkthdr *pcap_hdr; /* header returned by pcap */
-    const u_char *data;
-
-    fd_set fdset;
+int NetIf::openRx() {
+    int fd;
     int opts;
 
-    pcap_t *pcapHandle = netIf->setupPcap();
-    int pcap_fd = pcap_get_selectable_fd(pcapHandle);
+    this->pcap_ = this->setupPcap();
+    if (this->pcap_ == NULL) {
+        return -1;
+    }
+    fd = pcap_get_selectable_fd(this->pcap_);
 
     /* set pcap file descriptor to non-blocking */
-    opts = fcntl(pcap_fd, F_GETFL);
+    opts = fcntl(fd, F_GETFL);
     if (opts < 0) {
         perror("F_GETFL on pcap fd");
-        exit(EXIT_FAILURE);
+        return -1;
     }
     opts = (opts | O_NONBLOCK);
-    if (fcntl(pcap_fd, F_SETFL, opts) < 0) {
+    if (fcntl(fd, F_SETFL, opts) < 0) {
         perror("F_SETFL on pcap fd");
-        exit(EXIT_FAILURE);
+        return -1;
     }
+    return fd;
+}
 
+uint32_t NetIf::receive(uint32_t budget, uint64_t *late) {
+    struct pcap_pkthdr *pcap_hdr; /* header returned by pcap */
+    const u_char *data;
+    Dot1ag *dot1ag;
+    uint64_t nowUsec;
+    uint64_t stamp;
+    uint64_t date;
+    uint32_t n;
+
+    for (n = 0; n < budget; n++) {
+        switch (pcap_next_ex(this->pcap_, &pcap_hdr, &data)) {
+            case 1:
+                break;
+            case 0:
+                /* nothing more for now */
+                return n;
+            case -1:
+                pcap_perror(this->pcap_, "pcap_next_ex");
+                return n;
+            default:
+                pcap_perror(this->pcap_, "pcap_next_ex() unexpected value");
+                return n;
+        }
+        if (n == 0 && late != NULL) {
+            stamp = (uint64_t) pcap_hdr->ts.tv_sec * 1000000 +
+                    pcap_hdr->ts.tv_usec;
+            date = getDateUsec();
+            *late = date > stamp ? date - stamp : 0;
+        }
+        if (pcap_hdr->caplen < ETHER_HDR_LEN) {
+            continue;
+        }
 
-    Dot1ag *dot1ag = NULL;
-    struct timeval tval;
+        /*
+         * police by source MAC and class before spending anything more on
+         * it, as of now rather than the time stamp of pcap, which is the
+         * date
+         */
+        nowUsec = MonoTime::now().usec();
+        if (this->policer_.isEnabled() && !this->policer_.admit(
+                data + ETHER_ADDR_LEN, RxPolicer::classify(data,
+                pcap_hdr->caplen), nowUsec)) {
+            continue;
+        }
+
+        /*
+         * The frame is ours until the next pcap_next_ex(), so the LBM is
+         * turned into the LBR right in the pcap buffer.
+         */
+        if (this->lbrRate_ != 0 && this->reflectLbm((uint8_t *) data,
+                pcap_hdr->caplen, nowUsec)) {
+            continue;
+        }
+
+        dot1ag = new Dot1ag((uint8_t *) data, uint32_t(pcap_hdr->caplen));
+        dot1ag->setRxStamp(pcap_hdr->ts);
+        this->bufferPacket(dot1ag);
+    }
+    return n;
+}
+
+void NetIf::RX::task() {
+    struct pollfd pfd;
+    uint64_t late;
+    int n;
+
+    pfd.fd = netIf->openRx();
+    if (pfd.fd < 0) {
+        exit(EXIT_FAILURE);
+    }
+    pfd.events = POLLIN;
 
     /* listen for CFM frames */
     while (1) {
-        int n;
-        const u_char *data;
-
         /*
-         * Wait for Ether frames, and 
-         * set timer to be used in select call
+         * Wait for Ether frames, at most WAKEUP us for a frame left in the
+         * buffer of pcap to be picked up in any case
          */
-        tval.tv_sec = 0;
-        tval.tv_usec = WAKEUP;
-
-        FD_ZERO(&fdset);
-        FD_SET(pcap_fd, &fdset);
-        n = select(pcap_fd + 1, &fdset, NULL, NULL, &tval);
+        n = poll(&pfd, 1, WAKEUP / 1000);
         if (n == -1) {
             if (errno == EINTR)
                 continue;
-            perror("select");
+            perror("poll");
             exit(EXIT_FAILURE);
         }
 
         if (n == 0)
             continue; /* pcap_fd not ready */
-        n = pcap_next_ex(pcapHandle, &pcap_hdr, &data);
-        switch (n) {
-            case -1:
-                pcap_perror(pcapHandle, "pcap_next_ex");
-                break;
-            case 0:
-                break;
-            case 1:
-                cfmhdr = CFMHDR(data);
-                dot1ag = new Dot1ag((uint8_t *) data, uint32_t(pcap_hdr->caplen));
-                //                dot1ag->printPacket();
-                netIf->bufferPacket(dot1ag);
-
-                break;
-            default:
-                pcap_perror(pcapHandle, "pcap_next_ex() unexpected value");
-                break;
+        if (netIf->receive(RX_BUDGET, &late) > 0) {
+            this->accountLatency(late);
         }
     }
 
 }
-
@@ -12,19 +12,87 @@
 
 #include "dot1ag/NetIfListener.h"
 
-NetIfListener::NetIfListener(string name) : txBuffer(), rxBuffer(), Runnable(name) {
+const uint32_t NetIfListener::RX_QUEUE_DEPTH[RX_CLASS_MAX] = {
+    64, /* RX_RAPS */
+    1024, /* RX_CCM */
+    128, /* RX_LB_LT */
+    64 /* RX_OTHER */
+};
+
+NetIfListener::NetIfListener(string name) : Runnable(name), txBuffer() {
     this->mutex_ = new mutex();
     this->cond_ = new condition_variable();
+
+    memset(rxStats, 0, sizeof (rxStats));
+    memset(rxSkipped, 0, sizeof (rxSkipped));
 }
 
 NetIfListener::~NetIfListener() {
     /* Note: mutex and cond_ have been taken care of by Runnable */
+
+    for (int c = 0; c < RX_CLASS_MAX; c++) {
+        while (!rxBuffer[c].empty()) {
+            delete rxBuffer[c].front();
+            rxBuffer[c].pop_front();
+        }
+    }
+}
+
+NetIfListener::RxClass NetIfListener::classifyPacket(const Dot1ag *packet) {
+    const struct cfmhdr *cfmhdr;
+
+    /* the tagging is known since the frame was received */
+    cfmhdr = packet->getCfmHdr();
+    if (cfmhdr == NULL) {
+        return RX_OTHER;
+    }
+
+    switch (cfmhdr->opcode) {
+        case CFM_RAPS:
+            return RX_RAPS;
+        case CFM_CCM:
+            return RX_CCM;
+        case CFM_LBM:
+        case CFM_LBR:
+        case CFM_LTM:
+        case CFM_LTR:
+            return RX_LB_LT;
+        default:
+            return RX_OTHER;
+    }
+}
+
+const char *NetIfListener::rxClassName(int rxClass) {
+    switch (rxClass) {
+        case RX_RAPS:
+            return "R-APS";
+        case RX_CCM:
+            return "CCM";
+        case RX_LB_LT:
+            return "LB/LT";
+        default:
+            return "other";
+    }
 }
 
 int NetIfListener::bufferPacket(Dot1ag* packet) {
+    RxClass c = classifyPacket(packet);
+
     mutex_->lock();
 
-    this->rxBuffer.push_back(packet);
+    if (this->rxBuffer[c].size() >= RX_QUEUE_DEPTH[c]) {
+        rxStats[c].dropped++;
+        mutex_->unlock();
+        delete packet;
+        return EXIT_FAILURE;
+    }
+
+    this->rxBuffer[c].push_back(packet);
+    rxStats[c].enqueued++;
+    rxStats[c].depth = rxBuffer[c].size();
+    if (rxStats[c].depth > rxStats[c].highWater) {
+        rxStats[c].highWater = rxStats[c].depth;
+    }
 
     /* To unlock and notify others to the packet is ready */
     mutex_->unlock();
@@ -33,8 +101,76 @@ int NetIfListener::bufferPacket(Dot1ag* packet) {
     return EXIT_SUCCESS;
 }
 
+Dot1ag *NetIfListener::popPacket() {
+    Dot1ag *packet;
+    int c;
+    int served = RX_CLASS_MAX;
+
+    /* the starvation guard goes first: the highest class waited too long */
+    for (c = 0; c < RX_CLASS_MAX; c++) {
+        if (!rxBuffer[c].empty() && rxSkipped[c] >= RX_STARVATION_LIMIT) {
+            served = c;
+            rxStats[c].starved++;
+            break;
+        }
+    }
+
+    /* otherwise strict priority */
+    if (served == RX_CLASS_MAX) {
+        for (c = 0; c < RX_CLASS_MAX; c++) {
+            if (!rxBuffer[c].empty()) {
+                served = c;
+                break;
+            }
+        }
+    }
+
+    if (served == RX_CLASS_MAX) {
+        return NULL;
+    }
+
+    packet = rxBuffer[served].front();
+    rxBuffer[served].pop_front();
+    rxStats[served].depth = rxBuffer[served].size();
+    rxSkipped[served] = 0;
+
+    /* account the wait of the other classes still having frames queued */
+    for (c = 0; c < RX_CLASS_MAX; c++) {
+        if (c != served && !rxBuffer[c].empty()) {
+            rxSkipped[c]++;
+        }
+    }
+
+    return packet;
+}
+
+uint32_t NetIfListener::rxDepth() const {
+    uint32_t depth = 0;
+
+    for (int c = 0; c < RX_CLASS_MAX; c++) {
+        depth += rxBuffer[c].size();
+    }
+    return depth;
+}
+
+void NetIfListener::getRxQueueStats(RxQueueStats stats[RX_CLASS_MAX]) const {
+    lock_guard<mutex> lg(*(this->mutex_));
+
+    memcpy(stats, rxStats, sizeof (rxStats));
+}
+
 ostream & operator<<(ostream& os, const NetIfListener &nifl) {
-    os << nifl.name_ +  " rx size: " << nifl.rxBuffer.size() << endl;
+    NetIfListener::RxQueueStats stats[NetIfListener::RX_CLASS_MAX];
+
+    nifl.getRxQueueStats(stats);
+    os << nifl.name_ + " rx queues:" << endl;
+    for (int c = 0; c < NetIfListener::RX_CLASS_MAX; c++) {
+        os << "  " << setw(6) << left << NetIfListener::rxClassName(c) <<
+                right << " depth: " << stats[c].depth <<
+                " (max " << stats[c].highWater << ")" <<
+                " enqueued: " << stats[c].enqueued <<
+                " dropped: " << stats[c].dropped <<
+                " starved: " << stats[c].starved << endl;
+    }
     return os;
 }
-
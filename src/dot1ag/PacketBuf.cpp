@@ -0,0 +1,116 @@
+/*
+ * @brief: Right-sized, move-only storage for Ether frames
+ *
+ *    Copyright (c) 2017
+ *    Author: James Wang
+ *    All rights reserved.
+ *
+ * Created on March 7, 2017
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "dot1ag/PacketBuf.h"
+
+PacketBuf::PacketBuf(const uint8_t *data, uint32_t len) : data_(inline_),
+size_(0), capacity_(INLINE_SIZE), inline_() {
+    if (len > MAX_SIZE) {
+        len = MAX_SIZE;
+    }
+    reserve(len);
+    memcpy(data_, data, len);
+    size_ = len;
+}
+
+PacketBuf::PacketBuf(PacketBuf &&other) : data_(inline_), size_(other.size_),
+capacity_(INLINE_SIZE), inline_() {
+    if (other.isInline()) {
+        memcpy(inline_, other.inline_, other.size_);
+    } else {
+        /* steal the heap buffer */
+        data_ = other.data_;
+        capacity_ = other.capacity_;
+        other.data_ = other.inline_;
+        other.capacity_ = INLINE_SIZE;
+    }
+    other.size_ = 0;
+}
+
+PacketBuf &PacketBuf::operator=(PacketBuf &&other) {
+    if (this == &other) {
+        return *this;
+    }
+    if (!isInline()) {
+        delete [] data_;
+        data_ = inline_;
+        capacity_ = INLINE_SIZE;
+    }
+    if (other.isInline()) {
+        memcpy(inline_, other.inline_, other.size_);
+    } else {
+        data_ = other.data_;
+        capacity_ = other.capacity_;
+        other.data_ = other.inline_;
+        other.capacity_ = INLINE_SIZE;
+    }
+    size_ = other.size_;
+    other.size_ = 0;
+    return *this;
+}
+
+PacketBuf::~PacketBuf() {
+    if (!isInline()) {
+        delete [] data_;
+    }
+}
+
+int PacketBuf::reserve(uint32_t len) {
+    uint8_t *p;
+    uint32_t capacity;
+
+    if (len <= capacity_) {
+        return EXIT_SUCCESS;
+    }
+    if (len > MAX_SIZE) {
+        return EXIT_FAILURE;
+    }
+
+    /* double up to avoid re-allocating for every TLV added */
+    capacity = capacity_ * 2;
+    if (capacity < len) {
+        capacity = len;
+    }
+    if (capacity > MAX_SIZE) {
+        capacity = MAX_SIZE;
+    }
+
+    p = new uint8_t[capacity]();
+    memcpy(p, data_, size_);
+    if (!isInline()) {
+        delete [] data_;
+    }
+    data_ = p;
+    capacity_ = capacity;
+    return EXIT_SUCCESS;
+}
+
+int PacketBuf::resize(uint32_t len) {
+    if (reserve(len) != EXIT_SUCCESS) {
+        return EXIT_FAILURE;
+    }
+    if (len > size_) {
+        memset(data_ + size_, 0, len - size_);
+    }
+    size_ = len;
+    return EXIT_SUCCESS;
+}
+
+uint8_t *PacketBuf::append(uint32_t len) {
+    uint32_t pos = size_;
+
+    if (resize(size_ + len) != EXIT_SUCCESS) {
+        return NULL;
+    }
+    return data_ + pos;
+}
@@ -0,0 +1,105 @@
+/*
+ * @brief: Sparse store of the remote MEPs learnt from CCMs
+ *
+ *    Copyright (c) 2017
+ *    Author: James Wang
+ *    All rights reserved.
+ *
+ * Created on March 7, 2017
+ */
+
+#include <string.h>
+
+#include "dot1ag/RMepStore.h"
+
+const uint32_t RMepStore::MEMO_SIZE;
+const uint32_t RMepStore::REORDER_WINDOW;
+
+RMepStore::RMepStore() : timers_() {
+    for (uint32_t i = 0; i < PAGES; i++) {
+        index_[i] = NULL;
+    }
+}
+
+RMepStore::~RMepStore() {
+    for (uint32_t i = 0; i < PAGES; i++) {
+        delete [] index_[i];
+    }
+}
+
+uint32_t RMepStore::insert(uint16_t mepid) {
+    uint16_t *page;
+    uint32_t slot;
+    Cold cold;
+    SeqStats seq;
+    IntervalStats arrivals;
+
+    if (mepid > MAX_MEPID) {
+        return NONE;
+    }
+
+    page = index_[mepid >> PAGE_BITS];
+    if (page == NULL) {
+        page = new uint16_t[PAGE_SIZE];
+        for (uint32_t i = 0; i < PAGE_SIZE; i++) {
+            page[i] = EMPTY;
+        }
+        index_[mepid >> PAGE_BITS] = page;
+    }
+    if (page[mepid & (PAGE_SIZE - 1)] != EMPTY) {
+        return page[mepid & (PAGE_SIZE - 1)];
+    }
+
+    slot = mepid_.size();
+    page[mepid & (PAGE_SIZE - 1)] = slot;
+
+    memset(&cold, 0, sizeof (cold));
+    memset(&seq, 0, sizeof (seq));
+    arrivals.reset();
+    mepid_.push_back(mepid);
+    state_.push_back(0);
+    seq_.push_back(seq);
+    timeout_.push_back(0);
+    memoSize_.push_back(0);
+    memo_.resize(memo_.size() + MEMO_SIZE);
+    arrivals_.push_back(arrivals);
+    cold_.push_back(cold);
+    timers_.resize(slot + 1);
+
+    return slot;
+}
+
+void RMepStore::keepCcm(uint32_t slot, const uint8_t *frame, uint32_t size,
+        uint32_t skip, uint32_t len) {
+    uint8_t *memo = &memo_[slot * MEMO_SIZE];
+    uint32_t head = skip - ETHER_ADDR_LEN;
+
+    if (skip < ETHER_ADDR_LEN || skip + len > size ||
+            size - ETHER_ADDR_LEN - len > MEMO_SIZE) {
+        memoSize_[slot] = 0;
+        return;
+    }
+    memcpy(memo, frame + ETHER_ADDR_LEN, head);
+    memcpy(memo + head, frame + skip + len, size - skip - len);
+    memoSize_[slot] = size - ETHER_ADDR_LEN - len;
+}
+
+size_t RMepStore::memoryUsage() const {
+    size_t bytes = sizeof (*this);
+
+    for (uint32_t i = 0; i < PAGES; i++) {
+        if (index_[i] != NULL) {
+            bytes += PAGE_SIZE * sizeof (uint16_t);
+        }
+    }
+    bytes += mepid_.capacity() * sizeof (uint16_t);
+    bytes += state_.capacity() * sizeof (uint8_t);
+    bytes += seq_.capacity() * sizeof (SeqStats);
+    bytes += timeout_.capacity() * sizeof (uint32_t);
+    bytes += memoSize_.capacity() * sizeof (uint8_t);
+    bytes += memo_.capacity() * sizeof (uint8_t);
+    bytes += arrivals_.capacity() * sizeof (IntervalStats);
+    bytes += cold_.capacity() * sizeof (Cold);
+    bytes += timers_.memoryUsage() - sizeof (timers_);
+    return bytes;
+}
@@ -15,6 +15,8 @@
 #include <time.h>
 #include <signal.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
 
 #include <iostream>
 #include <string>
@@ -25,7 +27,16 @@ using namespace std;
 
 #include "dot1ag/Runnable.h"
 
-Runnable::Runnable(string name) : name_(name) {
+const uint32_t Runnable::LATENCY_BUCKETS;
+
+Runnable::Runnable(string name) : name_(name), thread_(NULL), mutex_(NULL),
+cond_(NULL), state_(INIT) {
+    wakeups_.store(0, memory_order_relaxed);
+    lateSum_.store(0, memory_order_relaxed);
+    lateMax_.store(0, memory_order_relaxed);
+    for (uint32_t k = 0; k < LATENCY_BUCKETS; k++) {
+        buckets_[k].store(0, memory_order_relaxed);
+    }
 }
 
 Runnable::~Runnable() {
@@ -42,11 +53,15 @@ Runnable::~Runnable() {
 
 int Runnable::init() {
     this->state_ = INIT;
+    return EXIT_SUCCESS;
 }
 
 thread *Runnable::start() {
     cout << endl << *this << " :: To start ..." << endl;    
-    this->thread_ = new thread([ = ]{task();});
+    this->thread_ = new thread([this]{
+        attach();
+        task();
+    });
     this->state_ = STARTED;
     cout << *this << " :: started" << endl << endl;
     return this->thread_;
@@ -54,6 +69,186 @@ thread *Runnable::start() {
 
 int Runnable::stop() {
     this->state_ = STOPPED;
+    return EXIT_SUCCESS;
+}
+
+void Runnable::attach() {
+    struct sched_param param;
+    int err;
+
+    this->state_ = STARTED;
+
+    /* as ps -L and top show it, 15 characters at most */
+    pthread_setname_np(pthread_self(), name_.substr(0, 15).c_str());
+
+    if (CPU_COUNT(&sched_.cpus) > 0) {
+        err = pthread_setaffinity_np(pthread_self(), sizeof (sched_.cpus),
+                &sched_.cpus);
+        if (err != 0) {
+            fprintf(stderr, "%s: CPU affinity: %s\n", name_.c_str(),
+                    strerror(err));
+        }
+    }
+
+    /* not fatal: the thread runs all the same, as any other */
+    memset(&param, 0, sizeof (param));
+    param.sched_priority = sched_.priority;
+    err = pthread_setschedparam(pthread_self(), sched_.policy, &param);
+    if (err != 0) {
+        fprintf(stderr, "%s: scheduling policy: %s\n", name_.c_str(),
+                strerror(err));
+    }
+}
+
+void Runnable::accountLatency(uint64_t late) {
+    wakeups_.fetch_add(1, memory_order_relaxed);
+    lateSum_.fetch_add(late, memory_order_relaxed);
+    if (late > lateMax_.load(memory_order_relaxed)) {
+        lateMax_.store(late, memory_order_relaxed);
+    }
+    buckets_[latencyBucket(late)].fetch_add(1, memory_order_relaxed);
+}
+
+void Runnable::getLatencyStats(LatencyStats &stats) const {
+    stats.wakeups = wakeups_.load(memory_order_relaxed);
+    stats.lateSum = lateSum_.load(memory_order_relaxed);
+    stats.lateMax = lateMax_.load(memory_order_relaxed);
+    for (uint32_t k = 0; k < LATENCY_BUCKETS; k++) {
+        stats.buckets[k] = buckets_[k].load(memory_order_relaxed);
+    }
+}
+
+int Runnable::parseSchedAttr(const char *spec, SchedAttr &attr) {
+    const char *p = spec;
+    char *end;
+    long first;
+    long last;
+
+    attr = SchedAttr();
+
+    /* the CPUs, a list of ranges */
+    while (*p != '\0' && *p != ':') {
+        first = strtol(p, &end, 10);
+        last = first;
+        if (end == p) {
+            return EXIT_FAILURE;
+        }
+        if (*end == '-') {
+            p = end + 1;
+            last = strtol(p, &end, 10);
+            if (end == p) {
+                return EXIT_FAILURE;
+            }
+        }
+        if (first < 0 || last < first || last >= CPU_SETSIZE) {
+            return EXIT_FAILURE;
+        }
+        for (long cpu = first; cpu <= last; cpu++) {
+            CPU_SET(cpu, &attr.cpus);
+        }
+        p = end;
+        if (*p == ',') {
+            p++;
+        } else if (*p != '\0' && *p != ':') {
+            return EXIT_FAILURE;
+        }
+    }
+    if (*p == '\0') {
+        return EXIT_SUCCESS;
+    }
+
+    /* the policy, with its priority */
+    p++;
+    if (strncmp(p, "fifo", 4) == 0) {
+        attr.policy = SCHED_FIFO;
+        p += 4;
+    } else if (strncmp(p, "rr", 2) == 0) {
+        attr.policy = SCHED_RR;
+        p += 2;
+    } else if (strncmp(p, "other", 5) == 0) {
+        attr.policy = SCHED_OTHER;
+        p += 5;
+    } else {
+        return EXIT_FAILURE;
+    }
+    if (attr.policy == SCHED_OTHER) {
+        return *p == '\0' ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    /* the lowest of the real-time priorities by default */
+    attr.priority = sched_get_priority_min(attr.policy);
+    if (*p == ':') {
+        attr.priority = strtol(p + 1, &end, 10);
+        if (end == p + 1) {
+            return EXIT_FAILURE;
+        }
+        p = end;
+    }
+    if (*p != '\0' || attr.priority < sched_get_priority_min(attr.policy) ||
+            attr.priority > sched_get_priority_max(attr.policy)) {
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+int Runnable::lockMemory() {
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        perror("mlockall");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
+ostream & operator<<(ostream& os, const Runnable::SchedAttr& attr) {
+    int count = CPU_COUNT(&attr.cpus);
+    int cpu;
+
+    os << "cpus: ";
+    if (count == 0) {
+        os << "any";
+    }
+    for (cpu = 0; count > 0; cpu++) {
+        if (CPU_ISSET(cpu, &attr.cpus)) {
+            os << cpu << (--count > 0 ? "," : "");
+        }
+    }
+    switch (attr.policy) {
+        case SCHED_FIFO:
+            os << " fifo " << attr.priority;
+            break;
+        case SCHED_RR:
+            os << " rr " << attr.priority;
+            break;
+        default:
+            os << " other";
+            break;
+    }
+    return os;
+}
+
+ostream & operator<<(ostream& os, const Runnable::LatencyStats& stats) {
+    uint64_t count = 0;
+    uint32_t k;
+
+    os << "wakeups: " << stats.wakeups;
+    if (stats.wakeups == 0) {
+        return os;
+    }
+    /* the first bucket k with 99% of them, all under 2^k us */
+    for (k = 0; k < Runnable::LATENCY_BUCKETS - 1; k++) {
+        count += stats.buckets[k];
+        if (count * 100 >= stats.wakeups * 99) {
+            break;
+        }
+    }
+    os << " late mean/max: " << stats.lateSum / stats.wakeups << "/" <<
+            stats.lateMax << " us, 99%: ";
+    if (k < Runnable::LATENCY_BUCKETS - 1) {
+        os << "< " << (1ULL << k) << " us";
+    } else {
+        os << ">= " << (1ULL << (k - 1)) << " us";
+    }
+    return os;
 }
 
 ostream & operator<<(ostream& os, const Runnable & r) {
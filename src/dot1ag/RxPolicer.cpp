@@ -0,0 +1,217 @@
+/*
+ * @brief: Per source MAC and class policer for the frames received
+ *
+ *    Copyright (c) 2017
+ *    Author: James Wang
+ *    All rights reserved.
+ *
+ * Created on March 7, 2017
+ */
+
+#include "dot1ag/net_common.h"
+
+#include "dot1ag/RxPolicer.h"
+#include "dot1ag/FrameLayout.h"
+
+RxPolicer::RxPolicer(uint32_t rate, uint32_t burst) : controlRate_(0),
+controlBurst_(0), ccmRate_(0), controlSet_(false) {
+    memset(table_, 0, sizeof (table_));
+    memset(overflow_, 0, sizeof (overflow_));
+    for (int i = 0; i < RX_CLASSES; i++) {
+        overflow_[i].rxClass = i;
+    }
+    setRate(rate, burst);
+}
+
+void RxPolicer::setRate(uint32_t rate, uint32_t burst) {
+    lock_guard<mutex> lg(mutex_);
+
+    if (burst == 0) {
+        burst = 1;
+    }
+    burst_.store((uint64_t) burst * 1000000, memory_order_relaxed);
+    rate_.store(rate, memory_order_relaxed);
+}
+
+void RxPolicer::addControlRate(uint32_t rate) {
+    uint64_t control;
+    uint64_t burst;
+
+    lock_guard<mutex> lg(mutex_);
+
+    ccmRate_ += rate;
+    if (controlSet_) {
+        return;
+    }
+    control = ccmRate_ * CONTROL_HEADROOM + RAPS_RATE;
+    if (control > UINT32_MAX) {
+        control = UINT32_MAX;
+    }
+    burst = control / 10;
+    if (burst < CONTROL_BURST) {
+        burst = CONTROL_BURST;
+    }
+    controlBurst_.store(burst * 1000000, memory_order_relaxed);
+    controlRate_.store(control, memory_order_relaxed);
+}
+
+void RxPolicer::setControlRate(uint32_t rate, uint32_t burst) {
+    lock_guard<mutex> lg(mutex_);
+
+    if (burst == 0) {
+        burst = 1;
+    }
+    controlSet_ = true;
+    controlBurst_.store((uint64_t) burst * 1000000, memory_order_relaxed);
+    controlRate_.store(rate, memory_order_relaxed);
+}
+
+RxPolicer::RxClass RxPolicer::classify(const uint8_t *frame,
+        uint32_t size) {
+    const struct cfmhdr *cfmhdr;
+
+    cfmhdr = frameCfmHdr(classifyFrame(frame, size), frame);
+    if (cfmhdr == NULL) {
+        return RX_OTHER;
+    }
+    switch (cfmhdr->opcode) {
+        case CFM_CCM:
+        case CFM_RAPS:
+            return RX_CONTROL;
+        default:
+            return RX_OAM;
+    }
+}
+
+uint32_t RxPolicer::hashSource(const uint8_t *mac, RxClass rxClass) {
+    uint32_t h = 2166136261u;
+
+    /* FNV-1a, the OUI alone is a poor hash for peers of one vendor */
+    for (int i = ETHER_ADDR_LEN - 1; i >= 0; i--) {
+        h ^= mac[i];
+        h *= 16777619u;
+    }
+    h ^= rxClass;
+    h *= 16777619u;
+    return h;
+}
+
+bool RxPolicer::consume(Bucket &b, uint32_t rate, uint64_t burst,
+        uint64_t nowUsec) {
+    if (b.tb.consume(rate, burst, nowUsec)) {
+        b.passed++;
+        return true;
+    }
+    b.policed++;
+    return false;
+}
+
+bool RxPolicer::admit(const uint8_t *src, RxClass rxClass,
+        uint64_t nowUsec) {
+    uint32_t rate;
+    uint64_t burst;
+    uint32_t h;
+    Bucket *b;
+    Bucket *victim = NULL;
+
+    if (rxClass == RX_CONTROL) {
+        rate = controlRate_.load(memory_order_relaxed);
+        burst = controlBurst_.load(memory_order_relaxed);
+    } else {
+        rate = rate_.load(memory_order_relaxed);
+        burst = burst_.load(memory_order_relaxed);
+    }
+    if (rate == 0) {
+        return true;
+    }
+
+    lock_guard<mutex> lg(mutex_);
+
+    h = hashSource(src, rxClass);
+    for (uint32_t i = 0; i < MAX_PROBE; i++) {
+        b = &table_[(h + i) & (TABLE_SIZE - 1)];
+        if (b->used && b->rxClass == rxClass &&
+                ETHER_IS_EQUAL(b->mac, src)) {
+            return consume(*b, rate, burst, nowUsec);
+        }
+        /* first free or aged out slot is taken if the source is new */
+        if (victim == NULL && (!b->used ||
+                nowUsec - b->tb.lastSeen > AGE_USEC)) {
+            victim = b;
+        }
+    }
+
+    if (victim == NULL) {
+        return consume(overflow_[rxClass], rate, burst, nowUsec);
+    }
+
+    /* a new source starts with a full bucket */
+    memcpy(victim->mac, src, ETHER_ADDR_LEN);
+    victim->used = 1;
+    victim->rxClass = rxClass;
+    victim->tb.tokens = burst;
+    victim->tb.lastSeen = nowUsec;
+    victim->passed = 0;
+    victim->policed = 0;
+    return consume(*victim, rate, burst, nowUsec);
+}
+
+void RxPolicer::getStats(vector<SourceStats> &stats) const {
+    SourceStats s;
+
+    lock_guard<mutex> lg(mutex_);
+
+    stats.clear();
+    for (uint32_t i = 0; i < TABLE_SIZE; i++) {
+        if (!table_[i].used) {
+            continue;
+        }
+        memcpy(s.mac, table_[i].mac, ETHER_ADDR_LEN);
+        s.rxClass = (RxClass) table_[i].rxClass;
+        s.passed = table_[i].passed;
+        s.policed = table_[i].policed;
+        stats.push_back(s);
+    }
+}
+
+uint64_t RxPolicer::getOverflowPoliced() const {
+    uint64_t policed = 0;
+
+    lock_guard<mutex> lg(mutex_);
+
+    for (int i = 0; i < RX_CLASSES; i++) {
+        policed += overflow_[i].policed;
+    }
+    return policed;
+}
+
+ostream & operator<<(ostream& os, const RxPolicer &p) {
+    vector<RxPolicer::SourceStats> stats;
+
+    if (!p.isEnabled()) {
+        os << "RX policer: disabled" << endl;
+        return os;
+    }
+
+    p.getStats(stats);
+    os << "RX policer: " << p.rate_.load(memory_order_relaxed) <<
+            " frames/s, burst " <<
+            p.burst_.load(memory_order_relaxed) / 1000000 <<
+            " per source and class, CCM and R-APS " <<
+            p.controlRate_.load(memory_order_relaxed) << " frames/s, burst " <<
+            p.controlBurst_.load(memory_order_relaxed) / 1000000 <<
+            ", overflow policed: " << p.getOverflowPoliced() << endl;
+    for (size_t i = 0; i < stats.size(); i++) {
+        os << "  " << hex << setfill('0');
+        for (int j = 0; j < ETHER_ADDR_LEN; j++) {
+            os << setw(2) << (unsigned int) stats[i].mac[j] <<
+                    (j < ETHER_ADDR_LEN - 1 ? ":" : "");
+        }
+        os << dec << setfill(' ') << (stats[i].rxClass ==
+                RxPolicer::RX_CONTROL ? " CCM/R-APS" : stats[i].rxClass ==
+                RxPolicer::RX_OAM ? " OAM" : " other") << " passed: " <<
+                stats[i].passed <<
+                " policed: " << stats[i].policed << endl;
+    }
+    return os;
+}
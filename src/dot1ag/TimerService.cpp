@@ -0,0 +1,132 @@
+/*
+ * @brief: Tickless timer of a worker thread, on timerfd and eventfd
+ *
+ *    Copyright (c) 2017
+ *    Author: James Wang
+ *    All rights reserved.
+ *
+ * Created on March 7, 2017
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+
+#include "dot1ag/TimerService.h"
+#include "dot1ag/MonoTime.h"
+
+const uint64_t TimerService::NONE64;
+
+TimerService::TimerService() : watchFd_(-1), deadline_(NONE64),
+lastLate_(0) {
+    timerFd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timerFd_ < 0) {
+        perror("timerfd_create");
+        exit(EXIT_FAILURE);
+    }
+    wakeFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeFd_ < 0) {
+        perror("eventfd");
+        exit(EXIT_FAILURE);
+    }
+    wakeups_.store(0, memory_order_relaxed);
+    expirations_.store(0, memory_order_relaxed);
+    lateSum_.store(0, memory_order_relaxed);
+    lateMax_.store(0, memory_order_relaxed);
+}
+
+TimerService::~TimerService() {
+    close(timerFd_);
+    close(wakeFd_);
+}
+
+int TimerService::arm(uint64_t deadline) {
+    struct itimerspec spec = {};
+
+    if (deadline == deadline_) {
+        return EXIT_SUCCESS;
+    }
+    /* all 0 disarms, so the time 0 is taken as 1 ns */
+    if (deadline != NONE64) {
+        MonoTime(deadline == 0 ? 1 : deadline).toTimespec(spec.it_value);
+    }
+    if (timerfd_settime(timerFd_, TFD_TIMER_ABSTIME, &spec, NULL) < 0) {
+        perror("timerfd_settime");
+        return EXIT_FAILURE;
+    }
+    deadline_ = deadline;
+    return EXIT_SUCCESS;
+}
+
+bool TimerService::wait() {
+    struct pollfd fds[3];
+    uint64_t value;
+    uint64_t late;
+    bool expired = false;
+
+    fds[0].fd = timerFd_;
+    fds[0].events = POLLIN;
+    fds[1].fd = wakeFd_;
+    fds[1].events = POLLIN;
+    /* poll() skips it if -1; read by the owner once woken up */
+    fds[2].fd = watchFd_;
+    fds[2].events = POLLIN;
+    while (poll(fds, 3, -1) < 0) {
+        if (errno != EINTR) {
+            perror("poll");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if ((fds[0].revents & POLLIN) &&
+            read(timerFd_, &value, sizeof (value)) == sizeof (value)) {
+        late = (MonoTime::now() - MonoTime(deadline_)).usec();
+        lastLate_ = late;
+
+        expirations_.fetch_add(1, memory_order_relaxed);
+        lateSum_.fetch_add(late, memory_order_relaxed);
+        if (late > lateMax_.load(memory_order_relaxed)) {
+            lateMax_.store(late, memory_order_relaxed);
+        }
+        /* a one shot: it is disarmed once expired */
+        deadline_ = NONE64;
+        expired = true;
+    }
+    if (fds[1].revents & POLLIN) {
+        /* the wakeups posted so far, all in one */
+        if (read(wakeFd_, &value, sizeof (value)) < 0 && errno != EAGAIN) {
+            perror("read eventfd");
+        }
+    }
+    wakeups_.fetch_add(1, memory_order_relaxed);
+    return expired;
+}
+
+void TimerService::wake() {
+    uint64_t one = 1;
+
+    /* never blocks: the counter only saturates after 2^64 - 2 wakeups */
+    if (write(wakeFd_, &one, sizeof (one)) < 0 && errno != EAGAIN) {
+        perror("write eventfd");
+    }
+}
+
+void TimerService::getStats(Stats &stats) const {
+    stats.wakeups = wakeups_.load(memory_order_relaxed);
+    stats.expirations = expirations_.load(memory_order_relaxed);
+    stats.lateSum = lateSum_.load(memory_order_relaxed);
+    stats.lateMax = lateMax_.load(memory_order_relaxed);
+}
+
+ostream& operator<<(ostream& os, const TimerService::Stats& stats) {
+    os << "wakeups: " << stats.wakeups << " deadlines: " << stats.expirations;
+    if (stats.expirations > 0) {
+        os << " late mean/max: " << stats.lateSum / stats.expirations <<
+                "/" << stats.lateMax << " us";
+    }
+    return os;
+}
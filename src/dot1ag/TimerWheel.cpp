@@ -0,0 +1,275 @@
+/*
+ * @brief: Hierarchical timing wheel for deadline ordered expiry
+ *
+ *    Copyright (c) 2017
+ *    Author: James Wang
+ *    All rights reserved.
+ *
+ * Created on March 7, 2017
+ */
+
+#include "dot1ag/TimerWheel.h"
+
+TimerWheel::TimerWheel(uint32_t capacity, uint64_t now) : nodes_(),
+next_(now + 1), pending_(0) {
+    for (uint32_t i = 0; i <= OVERDUE; i++) {
+        head_[i] = NONE;
+    }
+    resize(capacity);
+}
+
+void TimerWheel::resize(uint32_t capacity) {
+    Node n;
+
+    n.expires = 0;
+    n.prev = NONE;
+    n.next = NONE;
+    n.slot = NONE;
+    if (capacity > nodes_.size()) {
+        nodes_.resize(capacity, n);
+    }
+}
+
+/*
+ * Put the timer in the slot its expiry falls in, relative to the next tick
+ * to process:
+ *   level 0: within SLOTS ticks, slot by the tick itself
+ *   level n: within SLOTS^(n+1) ticks, slot by the n-th SLOT_BITS of it
+ */
+void TimerWheel::link(uint32_t id) {
+    Node &n = nodes_[id];
+    uint64_t expires = n.expires;
+    uint64_t delta;
+    uint32_t level;
+    uint32_t slot;
+
+    if (expires < next_) {
+        /* overdue, to fire on the next advance() whatever its time */
+        slot = OVERDUE;
+    } else {
+        delta = expires - next_;
+        for (level = 0; level < LEVELS - 1; level++) {
+            if (delta < (1ULL << (SLOT_BITS * (level + 1)))) {
+                break;
+            }
+        }
+        if (delta >= (1ULL << (SLOT_BITS * LEVELS))) {
+            /* park it at the far end, it gets re-inserted from there */
+            expires = next_ + (1ULL << (SLOT_BITS * LEVELS)) - 1;
+        }
+        slot = level * SLOTS +
+                ((expires >> (SLOT_BITS * level)) & (SLOTS - 1));
+    }
+
+    n.slot = slot;
+    n.prev = NONE;
+    n.next = head_[slot];
+    if (n.next != NONE) {
+        nodes_[n.next].prev = id;
+    }
+    head_[slot] = id;
+}
+
+void TimerWheel::unlink(uint32_t id) {
+    Node &n = nodes_[id];
+
+    if (n.prev != NONE) {
+        nodes_[n.prev].next = n.next;
+    } else {
+        head_[n.slot] = n.next;
+    }
+    if (n.next != NONE) {
+        nodes_[n.next].prev = n.prev;
+    }
+    n.prev = NONE;
+    n.next = NONE;
+    n.slot = NONE;
+}
+
+void TimerWheel::arm(uint32_t id, uint64_t expires) {
+    if (id >= nodes_.size()) {
+        resize(id + 1);
+    }
+    if (nodes_[id].slot != NONE) {
+        unlink(id);
+    } else {
+        pending_++;
+    }
+    nodes_[id].expires = expires;
+    link(id);
+}
+
+void TimerWheel::cancel(uint32_t id) {
+    if (id >= nodes_.size() || nodes_[id].slot == NONE) {
+        return;
+    }
+    unlink(id);
+    pending_--;
+}
+
+/* Spread the timers of a higher level slot over the lower levels */
+void TimerWheel::cascade(uint32_t level, uint32_t index) {
+    uint32_t slot = level * SLOTS + index;
+    uint32_t id = head_[slot];
+    uint32_t next;
+
+    /* detach the whole list first, a timer may come back to this slot */
+    head_[slot] = NONE;
+    while (id != NONE) {
+        next = nodes_[id].next;
+        link(id);
+        id = next;
+    }
+}
+
+void TimerWheel::advance(uint64_t now, vector<uint32_t> &expired) {
+    uint64_t tick;
+    uint64_t skip;
+    uint32_t index;
+    uint32_t level;
+    uint32_t id;
+    uint32_t next;
+
+    for (id = head_[OVERDUE]; id != NONE; id = next) {
+        next = nodes_[id].next;
+        nodes_[id].prev = NONE;
+        nodes_[id].next = NONE;
+        nodes_[id].slot = NONE;
+        pending_--;
+        expired.push_back(id);
+    }
+    head_[OVERDUE] = NONE;
+
+    if (pending_ == 0) {
+        if (now >= next_) {
+            next_ = now + 1;
+        }
+        return;
+    }
+
+    /*
+     * a jump over the whole span of the wheel, e.g. timers armed before the
+     * first advance() to the clock: sort them again rather than walk ticks
+     */
+    if (now >= next_ && now - next_ >= (1ULL << (SLOT_BITS * LEVELS))) {
+        rebase(now, expired);
+        return;
+    }
+
+    while (next_ <= now) {
+        tick = next_;
+
+        /*
+         * nothing in the slot nor to cascade: skip the idle ticks up to the
+         * next one with something to do, the woken up after a long sleep
+         * need not walk every tick of it
+         */
+        if (head_[tick & (SLOTS - 1)] == NONE && (tick & (SLOTS - 1)) != 0) {
+            skip = nextExpiry();
+            if (skip > now) {
+                next_ = now + 1;
+                break;
+            }
+            if (skip > tick) {
+                next_ = skip;
+                continue;
+            }
+        }
+
+        /* on a wrap of level n, bring the timers of level n+1 down */
+        for (level = 1; level < LEVELS; level++) {
+            if (((tick >> (SLOT_BITS * (level - 1))) & (SLOTS - 1)) != 0) {
+                break;
+            }
+            cascade(level, (tick >> (SLOT_BITS * level)) & (SLOTS - 1));
+        }
+
+        index = tick & (SLOTS - 1);
+        id = head_[index];
+        head_[index] = NONE;
+        next_ = tick + 1;
+
+        while (id != NONE) {
+            next = nodes_[id].next;
+            if (nodes_[id].expires <= tick) {
+                nodes_[id].prev = NONE;
+                nodes_[id].next = NONE;
+                nodes_[id].slot = NONE;
+                pending_--;
+                expired.push_back(id);
+            } else {
+                /* parked beyond the reach of the wheel */
+                link(id);
+            }
+            id = next;
+        }
+
+        if (pending_ == 0 && next_ <= now) {
+            next_ = now + 1;
+        }
+    }
+}
+
+void TimerWheel::rebase(uint64_t now, vector<uint32_t> &expired) {
+    vector<uint32_t> armed;
+    uint32_t id;
+
+    for (uint32_t slot = 0; slot < OVERDUE; slot++) {
+        for (id = head_[slot]; id != NONE; id = nodes_[id].next) {
+            armed.push_back(id);
+        }
+        head_[slot] = NONE;
+    }
+
+    next_ = now + 1;
+    for (size_t i = 0; i < armed.size(); i++) {
+        id = armed[i];
+        if (nodes_[id].expires <= now) {
+            nodes_[id].prev = NONE;
+            nodes_[id].next = NONE;
+            nodes_[id].slot = NONE;
+            pending_--;
+            expired.push_back(id);
+        } else {
+            link(id);
+        }
+    }
+}
+
+uint64_t TimerWheel::nextExpiry() const {
+    uint64_t next = NONE64;
+    uint64_t window;
+    uint32_t level;
+    uint32_t k;
+
+    if (pending_ == 0) {
+        return NONE64;
+    }
+    if (head_[OVERDUE] != NONE) {
+        return now();
+    }
+
+    /* level 0: the tick of the first non-empty slot */
+    for (k = 0; k < SLOTS; k++) {
+        if (head_[(next_ + k) & (SLOTS - 1)] != NONE) {
+            next = next_ + k;
+            break;
+        }
+    }
+
+    /* higher levels: the tick their first non-empty slot cascades down */
+    for (level = 1; level < LEVELS; level++) {
+        uint32_t shift = SLOT_BITS * level;
+
+        window = (next_ + (1ULL << shift) - 1) >> shift;
+        for (k = 0; k < SLOTS; k++) {
+            if (head_[level * SLOTS + ((window + k) & (SLOTS - 1))] != NONE) {
+                if (((window + k) << shift) < next) {
+                    next = (window + k) << shift;
+                }
+                break;
+            }
+        }
+    }
+    return next;
+}
@@ -0,0 +1,78 @@
+/*
+ * @brief: Bounds checked walk over the TLVs of a CFM PDU
+ *
+ *    Copyright (c) 2017
+ *    Author: James Wang
+ *    All rights reserved.
+ *
+ * Created on March 7, 2017
+ */
+
+#include "dot1ag/net_common.h"
+
+#include "dot1ag/TlvIterator.h"
+
+const size_t TlvIterator::TLV_HDR_SIZE;
+
+int TlvIterator::validate(const uint8_t *frame, uint32_t size) {
+    TlvIterator tlvs(frame, size);
+    CfmTlv tlv;
+
+    while (tlvs.next(tlv)) {
+        ;
+    }
+    return tlvs.isDone() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*
+ *  Sender ID TLV value
+ *  +---------------------------------+
+ *  | Chassis ID Length               |  1
+ *  +---------------------------------+
+ *  | Chassis ID Subtype              |  1, if Chassis ID Length > 0
+ *  +---------------------------------+
+ *  | Chassis ID                      |  Chassis ID Length
+ *  +---------------------------------+
+ *  | Management Address Domain ...   |  optional, not decoded
+ *  +---------------------------------+
+ */
+int CfmTlv::getSenderId(uint8_t &chassisIdSubtype, const uint8_t *&chassisId,
+        uint8_t &chassisIdLength) const {
+    if (type != TLV_SENDER_ID || length < 1) {
+        return EXIT_FAILURE;
+    }
+    chassisIdLength = value[0];
+    if (chassisIdLength == 0) {
+        chassisIdSubtype = 0;
+        chassisId = NULL;
+        return EXIT_SUCCESS;
+    }
+    if (length < 2 + chassisIdLength) {
+        return EXIT_FAILURE;
+    }
+    chassisIdSubtype = value[1];
+    chassisId = value + 2;
+    return EXIT_SUCCESS;
+}
+
+/*
+ *  Organization-Specific TLV value
+ *  +---------------------------------+
+ *  | OUI                             |  3
+ *  +---------------------------------+
+ *  | Sub-Type                        |  1
+ *  +---------------------------------+
+ *  | Value                           |  optional
+ *  +---------------------------------+
+ */
+int CfmTlv::getOrgSpecific(uint32_t &oui, uint8_t &subtype,
+        const uint8_t *&data, uint16_t &dataLength) const {
+    if (type != TLV_ORG_SPECIFIC || length < 4) {
+        return EXIT_FAILURE;
+    }
+    oui = (value[0] << 16) | (value[1] << 8) | value[2];
+    subtype = value[3];
+    data = value + 4;
+    dataLength = length - 4;
+    return EXIT_SUCCESS;
+}
@@ -5,8 +5,6 @@
  * To-do: 
  *      - There is only one NetIf used for this engine, while for a real ERPS
  *        topology, there should be 2 net interfaces involved.
- *      - For better performance and accuracy, SIGNALARM signal might be preferred
- *        for periodic CCM/LBM sending.
  *
  *    Copyright (c) 2017
  *    Author: James Wang
@@ -17,64 +15,154 @@
 
 #include "dot1ag/net_common.h"
 
-#include <signal.h>
+#include <math.h>
+
+#include <algorithm>
 
 #include "erps/ErpsEngine.h"
 #include "dot1ag/ieee8021ag.h"
 #include "dot1ag/NetIf.h"
+#include "dot1ag/TlvIterator.h"
+
+const uint32_t ErpsEngine::FLAP_PENALTY;
+const uint32_t ErpsEngine::SUPPRESS_LIMIT;
+const uint32_t ErpsEngine::REUSE_LIMIT;
+const uint32_t ErpsEngine::MAX_PENALTY;
+const uint64_t ErpsEngine::TX_TICK_NSEC;
+const uint32_t ErpsEngine::TX_BURST_MIN;
+const uint32_t ErpsEngine::TX_GAP_MAX;
+const uint32_t ErpsEngine::TX_PHASE_BITS;
+
+/* The bits of n the other way round, n / 2^32 the van der Corput number */
+static uint32_t reverseBits(uint32_t n) {
+    n = (n >> 1 & 0x55555555) | (n & 0x55555555) << 1;
+    n = (n >> 2 & 0x33333333) | (n & 0x33333333) << 2;
+    n = (n >> 4 & 0x0f0f0f0f) | (n & 0x0f0f0f0f) << 4;
+    n = (n >> 8 & 0x00ff00ff) | (n & 0x00ff00ff) << 8;
+    return n >> 16 | n << 16;
+}
 
-ErpsEngine::ErpsEngine(NetIf *netIf0, const Dot1agAttr *attr, string name) : netIf1_(NULL),
-netIf0_(netIf0), NetIfListener(name) {
+ErpsEngine::ErpsEngine(NetIf *netIf0, const Dot1agAttr *attr, uint32_t workers,
+        string name) : netIf1_(NULL), netIf0_(netIf0), NetIfListener(name),
+reporter_(this), events_(workers == 0 ? 1 : workers) {
 
-    this->mutex_ = new mutex();
-    this->cond_ = new condition_variable();
-    this->taskCfm = new TaskCfm(this);
+    if (workers == 0) {
+        workers = 1;
+    }
+    for (uint32_t i = 0; i < workers; i++) {
+        shards_.push_back(new Shard(this, i));
+    }
+    this->verbose_ = attr->verbose;
+    this->inline_ = false;
+    this->ccmMemo_ = true;
 
-    configNetIf(&this->netIf0Cfg_, attr);
+    if (addMep(attr) != EXIT_SUCCESS) {
+        exit(EXIT_FAILURE);
+    }
     /* Listener to the packet received from the NetIf */
     netIf0->registerListener(ETYPE_CFM, this);
-
-    /* initialize remote MEP database */
-    for (int i = 1; i <= MAX_MEPID; i++) {
-        this->netIf0Cfg_.rMEPdb[i].active = 0;
-    }
 }
 
 ErpsEngine::~ErpsEngine() {
     /* Note: mutex and cond_ have been taken care of by Runnable */
 
-    if (netIf0Cfg_.dot1agCcm != NULL) {
-        delete netIf0Cfg_.dot1agCcm;
+    /* the MEPs go with their MA */
+    for (size_t i = 0; i < mas_.size(); i++) {
+        delete mas_[i];
+    }
+
+    for (size_t i = 0; i < shards_.size(); i++) {
+        delete shards_[i];
     }
-    if (netIf0Cfg_.dot1agRAps != NULL) {
-        delete netIf0Cfg_.dot1agRAps;
+}
+
+ErpsEngine::Shard::Shard(ErpsEngine *engine, uint32_t id) :
+NetIfListener("ERPS Shard " + to_string(id)), erpsEngine(engine), id(id),
+txTimers(0, txTick(MonoTime::now())), checkTimers(0, NetIf::getTimeMsec()),
+txRate(0), txBurst(TX_BURST_MIN) {
+    asleep.store(false, memory_order_relaxed);
+    ccmsSent.store(0, memory_order_relaxed);
+    txSlips.store(0, memory_order_relaxed);
+    txDeferred.store(0, memory_order_relaxed);
+    txBatches.store(0, memory_order_relaxed);
+    txBatchMax.store(0, memory_order_relaxed);
+    rxFrames.store(0, memory_order_relaxed);
+    rxLatencySum.store(0, memory_order_relaxed);
+    rxLatencyMax.store(0, memory_order_relaxed);
+    for (uint32_t k = 0; k < LATENCY_BUCKETS; k++) {
+        rxLatency[k].store(0, memory_order_relaxed);
     }
-    if (netIf0Cfg_.dot1agLbm != NULL) {
-        delete netIf0Cfg_.dot1agLbm;
+}
+
+uint64_t ErpsEngine::Shard::nextDeadline() const {
+    uint64_t tx = txTimers.nextExpiry();
+    uint64_t check = checkTimers.nextExpiry();
+    uint64_t transaction = transactions.nextExpiry();
+
+    tx = tx == TimerWheel::NONE64 ? TimerService::NONE64 : tx * TX_TICK_NSEC;
+    check = check == TimerWheel::NONE64 ? TimerService::NONE64 :
+            check * MonoTime::NSEC_PER_MSEC;
+    transaction = transaction == TimerWheel::NONE64 ? TimerService::NONE64 :
+            transaction * MonoTime::NSEC_PER_MSEC;
+    if (transaction < check) {
+        check = transaction;
     }
+    return tx < check ? tx : check;
+}
 
-    if (taskCfm != NULL) {
-        delete taskCfm;
+int ErpsEngine::Shard::bufferPacket(Dot1ag *packet) {
+    int status = NetIfListener::bufferPacket(packet);
+
+    /* queued before asleep is read: the shard took it or sleeps on it */
+    if (status == EXIT_SUCCESS && asleep.load(memory_order_relaxed)) {
+        timer.wake();
     }
+    return status;
 }
 
 /*
- * Will start 2 thread: the engine itself in task(), and TaskCfm::task() 
+ * Will start the engine in task(), which starts the shards and waits for them
  */
 void ErpsEngine::startService() {
     thread *thread_engine = this->start();
 
-    /* wait a second to start taskCfm after the main ErpsEngine starts */
-    sleep(1);
-
-    thread *thread_cfm = this->taskCfm->start();
-    thread_cfm->join();
     thread_engine->join();
 }
 
-int ErpsEngine::configNetIf(NetIfCfg *netIfCfg, const Dot1agAttr *attr) {
-    // Save the dot1ag attr to the NetIf config.
-    netIfCfg->dot1agAttr = attr;
+int ErpsEngine::bufferPacket(Dot1ag *packet) {
+    if (this->inline_) {
+        this->serve(*shards_[steer(packet)], packet);
+        return EXIT_SUCCESS;
+    }
+    return shards_[steer(packet)]->bufferPacket(packet);
+}
+
+ErpsEngine::MaCfg *ErpsEngine::addMa(const Dot1agAttr *attr) {
+    MaCfg *ma;
+
+    if (maDemux_.add(attr->vlan, attr->md_level, mas_.size()) !=
+            EXIT_SUCCESS) {
+        fprintf(stderr, "MA %s: vlan %d level %d out of range\n",
+                attr->ma, attr->vlan, attr->md_level);
+        return NULL;
+    }
+
+    /* its LBMs may be answered by the RX thread, those of no MA never */
+    this->netIf0_->addLbrMa(attr->vlan, attr->md_level);
+
+    /* spread over the shards as they come, the same load for each */
+    ma = new MaCfg(attr);
+    ma->shard = shards_[mas_.size() % shards_.size()];
+    mas_.push_back(ma);
+    configMa(ma, attr);
+    return ma;
+}
+
+int ErpsEngine::addMep(const Dot1agAttr *attr) {
+    uint32_t index;
+    MaCfg *ma;
+    MepCfg *mep;
+    Shard *shard;
 
     /* MD level should be in range 0-7 */
     if (attr->md_level > 7) {
@@ -82,281 +170,617 @@ int ErpsEngine::configNetIf(NetIfCfg *netIfCfg, const Dot1agAttr *attr) {
         exit(EXIT_FAILURE);
     }
 
-    this->taskCfm->setInterval(attr->CCMinterval);
-    this->taskCfm->setSkips(attr->CCMSkips);
+    index = maDemux_.lookup(attr->vlan, attr->md_level);
+    if (index != MaDemux::NONE) {
+        ma = mas_[index];
+        if (strcmp(ma->dot1agAttr.md, attr->md) != 0 ||
+                strcmp(ma->dot1agAttr.ma, attr->ma) != 0) {
+            fprintf(stderr, "MA %s: vlan %d level %d already taken by "
+                    "MA %s\n", attr->ma, attr->vlan, attr->md_level,
+                    ma->dot1agAttr.ma);
+            return EXIT_FAILURE;
+        }
+        for (size_t i = 0; i < ma->meps.size(); i++) {
+            if (ma->meps[i]->attr.mepid == attr->mepid) {
+                fprintf(stderr, "MA %s: MEPID %d already configured\n",
+                        attr->ma, attr->mepid);
+                return EXIT_FAILURE;
+            }
+        }
+    } else if ((ma = addMa(attr)) == NULL) {
+        return EXIT_FAILURE;
+    }
+
+    shard = ma->shard;
+    mep = new MepCfg(attr, ma);
+    mep->index = shard->meps.size();
+    ma->meps.push_back(mep);
+    shard->meps.push_back(mep);
+    shard->txTimers.resize(shard->meps.size());
+    shard->checkTimers.resize(shard->meps.size());
+
+    /* the CCMs its peers send take that much more of the RX policer */
+    this->netIf0_->getPolicer().addControlRate((1000000 + mep->ccmInterval -
+            1) / mep->ccmInterval);
 
     /* check for mandatory '-m' flag */
     if ((attr->mepid > 0) && (attr->mepid < 8192)) {
 
-        netIfCfg->dot1agCcm = new Dot1agCcm(attr);
+        mep->dot1agCcm = new Dot1agCcm(&mep->attr);
 
-        int seq = netIfCfg->dot1agCcm->getTransId();
-        cout << "Sending CFM CCM start tid: " << seq <<
-                " with size: " << netIfCfg->dot1agCcm->getPacketSize() << endl;
+        int seq = mep->dot1agCcm->getTransId();
+        if (attr->verbose) {
+            cout << "Sending CFM CCM start tid: " << seq <<
+                    " with size: " << mep->dot1agCcm->getPacketSize() << endl;
+        }
+    }
+
+    if (mep->dot1agCcm != NULL) {
+        /* twice its share of the CCMs of a tick, rounded up */
+        shard->txRate += (1000000 + mep->ccmInterval - 1) / mep->ccmInterval;
+        shard->txBurst = max((uint64_t) TX_BURST_MIN, (shard->txRate * 2 *
+                TX_TICK_NSEC + 999999999) / 1000000000);
 
+        mep->txPhase = this->txPhase(mep->ccmInterval);
+        mep->nextTx = firstTx(*mep, MonoTime::now());
+        shard->txTimers.arm(mep->index, txTick(mep->nextTx));
     }
 
+    return EXIT_SUCCESS;
+}
+
+int ErpsEngine::configMa(MaCfg *maCfg, const Dot1agAttr *attr) {
+    /* The MAID expected in the CCMs received */
+    maCfg->maidMatcher.setMaid(attr->md, attr->ma);
+
+    /* the templates point to the copy of attr kept by the MA */
     if (attr->remoteMac != NULL) {
-        netIfCfg->dot1agLbm = new Dot1agLbm(attr);
+        maCfg->dot1agLbm = new Dot1agLbm(&maCfg->dot1agAttr);
+        if (attr->ltmTtl > 0) {
+            maCfg->dot1agLtm = new Dot1agLtm(&maCfg->dot1agAttr,
+                    attr->ltmTtl);
+        }
     }
     /* build R-APS packets */
-    netIfCfg->dot1agRAps = new Dot1agRAps(attr);
+    maCfg->dot1agRAps = new Dot1agRAps(&maCfg->dot1agAttr);
 
     return EXIT_SUCCESS;
 }
 
-int ErpsEngine::processCcm(NetIfCfg &cfg, const uint8_t *data, int verbose) {
+size_t ErpsEngine::memoryUsage() const {
+    size_t bytes = maDemux_.memoryUsage();
+
+    bytes += mas_.capacity() * sizeof (MaCfg *);
+    for (size_t i = 0; i < shards_.size(); i++) {
+        const Shard *shard = shards_[i];
+
+        bytes += sizeof (*shard) + shard->meps.capacity() * sizeof (MepCfg *);
+        bytes += shard->txTimers.memoryUsage() - sizeof (shard->txTimers);
+        bytes += shard->checkTimers.memoryUsage() -
+                sizeof (shard->checkTimers);
+        bytes += shard->transactions.memoryUsage() -
+                sizeof (shard->transactions);
+    }
+    for (size_t i = 0; i < mas_.size(); i++) {
+        const MaCfg *ma = mas_[i];
+
+        bytes += sizeof (*ma) + ma->meps.capacity() * sizeof (MepCfg *);
+        bytes += sizeof (Dot1agRAps);
+        if (ma->dot1agLbm != NULL) {
+            bytes += sizeof (Dot1agLbm);
+        }
+        if (ma->dot1agLtm != NULL) {
+            bytes += sizeof (Dot1agLtm);
+        }
+        for (size_t j = 0; j < ma->meps.size(); j++) {
+            const MepCfg *mep = ma->meps[j];
+
+            bytes += sizeof (*mep) - sizeof (mep->rMEPdb);
+            bytes += mep->rMEPdb.memoryUsage();
+            bytes += mep->view.memoryUsage() - sizeof (mep->view);
+            bytes += mep->rMEPexpired.capacity() * sizeof (uint32_t);
+            bytes += mep->eventSlots.capacity() * sizeof (uint32_t);
+            if (mep->dot1agCcm != NULL) {
+                bytes += sizeof (Dot1agCcm);
+            }
+        }
+    }
+    return bytes;
+}
 
-    struct cfmencap *encap;
-    struct cfmhdr *cfmhdr;
-    struct cfm_cc *cfm_cc;
-    uint8_t mdnl = 0;
+void ErpsEngine::updateRMep(MepCfg &mep, uint16_t rMEPid,
+        const uint8_t *srcmac, int tlv_ps, int tlv_is, uint32_t interval,
+        bool rdi, uint32_t seq, const uint8_t *frame, uint32_t size,
+        uint32_t seqOffset, uint64_t nowUsec) {
+    RMepStore &rMEPdb = mep.rMEPdb;
+    uint64_t now = nowUsec / 1000;
+    uint32_t slot;
+    bool fresh;
     int i;
-    uint8_t *md_namep;
-    uint8_t sma_name_fmt;
-    uint8_t smanl = 0;
-    uint8_t local_mac[ETHER_ADDR_LEN];
-    struct timeval now;
-    int rMEPid;
-    int more_tlvs;
-    int tlv_length;
-    uint8_t *p;
-    const Dot1agAttr *attr = cfg.dot1agAttr;
-    struct rMEP *rMEPdb = cfg.rMEPdb;
-
-    encap = (struct cfmencap *) data;
-
-    /* discard if not received on our vlan */
-    if ((GET_VLAN(encap) != attr->vlan) && (IS_TAGGED((uint8_t*) encap))) {
-        fprintf(stderr, "Vlan not match: CCM received with vlan %d "
-                "(ours %d)\n", GET_VLAN(encap), attr->vlan);
-        return (EXIT_FAILURE);
+
+    slot = rMEPdb.insert(rMEPid);
+    fresh = !(rMEPdb.state(slot) & RMepStore::RMEP_ACTIVE);
+    rMEPdb.state(slot) |= RMepStore::RMEP_ACTIVE |
+            RMepStore::RMEP_CCM_RECEIVED_EQUAL;
+
+    for (i = 0; i < ETHER_ADDR_LEN; i++) {
+        rMEPdb.cold(slot).recvdMacAddress[i] = srcmac[i];
     }
-    if ((attr->vlan != 0) && (!IS_TAGGED((uint8_t*) encap))) {
-        return (EXIT_FAILURE);
+    if (tlv_ps >= 0) {
+        rMEPdb.cold(slot).tlv_ps = tlv_ps;
+    }
+    if (tlv_is >= 0) {
+        rMEPdb.cold(slot).tlv_is = tlv_is;
     }
 
-    /* We need to parse the CCM header first in order to get the MEP ID */
-    cfm_cc = POS_CFM_CC(data);
-    /* discard if CCM has the same MEPID as us */
-    if (cfm_cc->mepid == htons(attr->mepid)) {
-        fprintf(stderr,
-                "config error: CCM received with our MEPID %d "
-                "(ours %d)\n",
-                ntohs(cfm_cc->mepid), attr->mepid);
-        return (EXIT_FAILURE);
-    } else {
-        rMEPid = ntohs(cfm_cc->mepid);
+    /*
+     * Set rMEPwhile to 3.5x the CCM interval of the remote MEP, rounded
+     * up to the ms. rMEPwhile is the timeout after which it is assumed
+     * that the remote MEP is down. 3.5 times means that 3 CCM PDUs have
+     * been lost.
+     */
+    rMEPdb.cold(slot).recvdInterval = interval;
+    rMEPdb.timeout(slot) = ccmWhile(interval);
+
+    /* its interval is tracked, but one other than ours is an error */
+    if (setRMepBit(rMEPdb, slot, RMepStore::RMEP_INTERVAL_MISMATCH,
+            interval != mep.ccmInterval, mep.rMEPmismatch) &&
+            interval != mep.ccmInterval && !rMEPdb.cold(slot).suppressed) {
+        this->postEvent(mep, rMEPid, EventLog::RMEP_INTERVAL_MISMATCH,
+                interval, 1, now);
     }
 
-    /* parse the generic CFM header */
-    cfmhdr = CFMHDR(data);
+    /* recvdRDI, and a port or interface of the remote MEP not up */
+    setRMepBit(rMEPdb, slot, RMepStore::RMEP_RDI, rdi, mep.rMEPrdi);
+    setRMepBit(rMEPdb, slot, RMepStore::RMEP_MAC_STATUS,
+            (rMEPdb.cold(slot).tlv_ps != 0 &&
+            rMEPdb.cold(slot).tlv_ps != DOT1AG_PS_UP) ||
+            (rMEPdb.cold(slot).tlv_is != 0 &&
+            rMEPdb.cold(slot).tlv_is != DOT1AG_IS_UP), mep.rMEPmacStatus);
+
+    /* log entry on DOWN to UP transition, or a new remote MEP */
+    if (setRMepBit(rMEPdb, slot, RMepStore::RMEP_CCM_DEFECT, false,
+            mep.rMEPdown) || fresh) {
+        this->rMepTransition(mep, slot, now);
+    }
 
-    if (verbose) {
-        fprintf(stderr, "rcvd CCM from: "
-                "%02x:%02x:%02x:%02x:%02x:%02x, level %d",
-                encap->srcmac[0], encap->srcmac[1],
-                encap->srcmac[2], encap->srcmac[3],
-                encap->srcmac[4], encap->srcmac[5],
-                GET_MD_LEVEL(cfmhdr));
+    this->armRMep(mep, slot, now);
+
+    /* the next CCM alike takes the short way */
+    rMEPdb.trackSeq(slot, seq);
+    rMEPdb.arrivals(slot).add(nowUsec, interval);
+    if (this->ccmMemo_) {
+        rMEPdb.keepCcm(slot, frame, size, seqOffset, sizeof (seq));
     }
+    this->publishRMep(mep, slot, now);
 
-    /* discard if MD Level is different from ours */
-    if (GET_MD_LEVEL(cfmhdr) != attr->md_level) {
-        rMEPdb[rMEPid].CCMreceivedEqual = 0;
-        if (verbose) {
-            fprintf(stderr,
-                    " (expected level %d, discard frame)\n",
-                    attr->md_level);
+    this->updateDefects(mep, now);
+}
+
+void ErpsEngine::raiseCcmDefect(MaCfg &cfg, uint8_t defect,
+        uint32_t interval, uint64_t now) {
+    uint64_t until = now + ccmWhile(interval);
+
+    for (size_t i = 0; i < cfg.meps.size(); i++) {
+        MepCfg &mep = *cfg.meps[i];
+        uint64_t &ccmWhile = defect == MepCfg::DEFECT_XCON_CCM ?
+                mep.xconCCMwhile : mep.errorCCMwhile;
+
+        if (until > ccmWhile) {
+            ccmWhile = until;
         }
-        return (EXIT_FAILURE);
-    } else {
-        rMEPdb[rMEPid].active = 1;
-        rMEPdb[rMEPid].CCMreceivedEqual = 1;
-        this->printRMEPState(rMEPdb, rMEPid, "ACTIVE");
+        this->updateDefects(mep, now);
     }
+}
 
-    /* extract the Maintenance Domain Name, if present */
-    md_namep = cfm_cc->maid.var_p;
+void ErpsEngine::updateDefects(MepCfg &mep, uint64_t now) {
+    uint8_t defects = 0;
+    uint8_t alarms;
+    uint8_t highest;
+    uint64_t checkAt;
 
-    /* create a '\0' filled buffer for MD Name */
-    char mdnamebuf[DOT1AG_MAX_MD_LENGTH + 1];
-    memset(mdnamebuf, '\0', sizeof (mdnamebuf));
+    if (mep.rMEPrdi > 0) {
+        defects |= MepCfg::DEFECT_RDI_CCM;
+    }
+    if (mep.rMEPmacStatus > 0) {
+        defects |= MepCfg::DEFECT_MAC_STATUS;
+    }
+    if (mep.rMEPdown > 0) {
+        defects |= MepCfg::DEFECT_REMOTE_CCM;
+    }
+    if (mep.rMEPmismatch > 0 || mep.errorCCMwhile > now) {
+        defects |= MepCfg::DEFECT_ERROR_CCM;
+    }
+    if (mep.xconCCMwhile > now) {
+        defects |= MepCfg::DEFECT_XCON_CCM;
+    }
+    mep.defects = defects;
 
-    switch (cfm_cc->maid.format) {
-        case 0:
-            /* reservered for IEEE 802.1 */
-            break;
-        case 1:
-            /* No Maintenance Domain Name present */
+    /*
+     * The Fault Notification Generator: the highest priority defect of
+     * those at lowestAlarmPri or above is reported once it has lasted
+     * fngAlarmTime, and a higher one at once; the alarm is reset once
+     * there has been none for fngResetTime
+     */
+    alarms = defects & ~((1 << (mep.attr.lowestAlarmPri - 1)) - 1);
+    highest = alarms == 0 ? 0 : 32 - __builtin_clz(alarms);
+    switch (mep.fngState) {
+        case MepCfg::FNG_RESET:
+            if (highest > 0) {
+                mep.fngState = MepCfg::FNG_DEFECT;
+                mep.fngWhile = now + mep.attr.fngAlarmTime;
+            }
             break;
-        case 2:
-            /* Domain Name based string */
+        case MepCfg::FNG_DEFECT:
+            if (highest == 0) {
+                mep.fngState = MepCfg::FNG_RESET;
+                mep.fngWhile = 0;
+            } else if (now >= mep.fngWhile) {
+                mep.fngState = MepCfg::FNG_REPORTED;
+                mep.fngWhile = 0;
+                mep.fngPriority = highest;
+                this->postEvent(mep, 0, EventLog::FAULT_ALARM,
+                        mep.fngPriority, 1, now);
+            }
             break;
-        case 3:
-            /* MAC address + 2-octet integer */
+        case MepCfg::FNG_REPORTED:
+            if (highest == 0) {
+                mep.fngState = MepCfg::FNG_CLEARING;
+                mep.fngWhile = now + mep.attr.fngResetTime;
+            } else if (highest > mep.fngPriority) {
+                mep.fngPriority = highest;
+                this->postEvent(mep, 0, EventLog::FAULT_ALARM,
+                        mep.fngPriority, 1, now);
+            }
             break;
-        case 4:
-            /* Character string */
-            mdnl = cfm_cc->maid.length;
-            if ((mdnl < 1) || (mdnl > DOT1AG_MAX_MD_LENGTH)) {
-                fprintf(stderr, "illegal MD Name Length: %d\n", mdnl);
-                break;
+        case MepCfg::FNG_CLEARING:
+            if (highest > 0) {
+                mep.fngState = MepCfg::FNG_REPORTED;
+                mep.fngWhile = 0;
+                if (highest > mep.fngPriority) {
+                    mep.fngPriority = highest;
+                    this->postEvent(mep, 0, EventLog::FAULT_ALARM,
+                        mep.fngPriority, 1, now);
+                }
+            } else if (now >= mep.fngWhile) {
+                mep.fngState = MepCfg::FNG_RESET;
+                mep.fngWhile = 0;
+                this->postEvent(mep, 0, EventLog::FAULT_ALARM_RESET,
+                        mep.fngPriority, 1, now);
+                mep.fngPriority = 0;
             }
-            /* copy MD Name to buffer, ensuring trailing '\0' */
-            strncpy(mdnamebuf, (char *) md_namep, mdnl);
+            break;
+    }
+    mep.view.publishDefects(mep.defects, mep.fngPriority);
+
+    /* the defect timers are checked with the rMEPwhile ones */
+    checkAt = mep.rMEPdb.timers().nextExpiry();
+    if (mep.errorCCMwhile > now && mep.errorCCMwhile < checkAt) {
+        checkAt = mep.errorCCMwhile;
+    }
+    if (mep.xconCCMwhile > now && mep.xconCCMwhile < checkAt) {
+        checkAt = mep.xconCCMwhile;
+    }
+    if (mep.fngWhile != 0 && mep.fngWhile < checkAt) {
+        checkAt = mep.fngWhile;
+    }
+    if (mep.eventAt < checkAt) {
+        checkAt = mep.eventAt;
+    }
+    if (checkAt < mep.checkAt) {
+        this->scheduleCheck(mep, checkAt);
+    }
+}
 
-            if (verbose) {
-                fprintf(stderr, ", MD \"%s\"", mdnamebuf);
+void ErpsEngine::rMepTransition(MepCfg &mep, uint32_t slot, uint64_t now) {
+    RMepStore::Cold &cold = mep.rMEPdb.cold(slot);
+
+    cold.transitions++;
+
+    /* every time it goes down weighs, and decays by half every half-life */
+    if ((mep.rMEPdb.state(slot) & RMepStore::RMEP_CCM_DEFECT) &&
+            mep.attr.flapHalfLife > 0) {
+        decayPenalty(cold, mep.attr.flapHalfLife, now);
+        cold.penalty = min(cold.penalty + FLAP_PENALTY, MAX_PENALTY);
+        if (!cold.suppressed && cold.penalty >= SUPPRESS_LIMIT) {
+            cold.suppressed = 1;
+            this->postEvent(mep, mep.rMEPdb.getMepid(slot),
+                    EventLog::RMEP_SUPPRESSED, 0, cold.transitions, now);
+        }
+    }
+
+    /* reported once the window is over, with all the others in it */
+    if (!cold.pending) {
+        cold.pending = 1;
+        cold.dueAt = now + mep.attr.eventWindow;
+        mep.eventSlots.push_back(slot);
+        if (cold.dueAt < mep.eventAt) {
+            mep.eventAt = cold.dueAt;
+        }
+    }
+}
+
+void ErpsEngine::flushEvents(MepCfg &mep, uint64_t now) {
+    size_t i = 0;
+
+    if (mep.eventAt > now) {
+        return;
+    }
+    mep.eventAt = TimerWheel::NONE64;
+    while (i < mep.eventSlots.size()) {
+        uint32_t slot = mep.eventSlots[i];
+        RMepStore::Cold &cold = mep.rMEPdb.cold(slot);
+        uint16_t rMEPid = mep.rMEPdb.getMepid(slot);
+        bool up = !(mep.rMEPdb.state(slot) & RMepStore::RMEP_CCM_DEFECT);
+
+        if (cold.dueAt <= now && cold.suppressed) {
+            decayPenalty(cold, mep.attr.flapHalfLife, now);
+            if (cold.penalty >= REUSE_LIMIT) {
+                /* held back till its penalty has decayed enough */
+                cold.dueAt = now + 1 + (uint64_t) (mep.attr.flapHalfLife *
+                        log2((double) cold.penalty / REUSE_LIMIT));
+            } else {
+                cold.suppressed = 0;
+                this->postEvent(mep, rMEPid, EventLog::RMEP_REUSED, 0, 1,
+                        now);
             }
-            /* discard if MD Name is different from ours */
-            if (strncmp(mdnamebuf, attr->md,
-                    strlen(attr->md) > mdnl ? strlen(attr->md) : mdnl)
-                    != 0) {
-                if (verbose) {
-                    fprintf(stderr,
-                            " (expected \"%s\", discard frame)\n",
-                            attr->md);
-                }
-                return (EXIT_FAILURE);
+        }
+        if (cold.dueAt > now) {
+            if (cold.dueAt < mep.eventAt) {
+                mep.eventAt = cold.dueAt;
             }
-            break;
-        default:
-            /*
-             *  5-31:   Reserved for IEEE 802.1
-             *  32-63:  Defined by ITU-T Y.1731
-             *  64-255: Reserved for IEEE 802.1
-             */
-            break;
+            i++;
+            continue;
+        }
+
+        /* only what changed since last reported */
+        if (up != (bool) cold.reportedUp) {
+            this->postEvent(mep, rMEPid, up ? EventLog::RMEP_UP :
+                    EventLog::RMEP_DOWN, 0, cold.transitions, now);
+            cold.reportedUp = up;
+        } else if (cold.transitions > 0) {
+            this->postEvent(mep, rMEPid, EventLog::RMEP_FLAPPED, 0,
+                    cold.transitions, now);
+        }
+        cold.transitions = 0;
+        cold.pending = 0;
+        mep.eventSlots[i] = mep.eventSlots.back();
+        mep.eventSlots.pop_back();
     }
+}
+
+int ErpsEngine::checkRMEPdb(MepCfg &mep, uint64_t now) {
+    int status = EXIT_SUCCESS;
+    MepSnapshot::Entry last;
+
+    /* has one of the remote MEP timers run out? */
+    mep.rMEPexpired.clear();
+    mep.rMEPdb.timers().advance(now, mep.rMEPexpired);
+    for (size_t n = 0; n < mep.rMEPexpired.size(); n++) {
+        uint32_t slot = mep.rMEPexpired[n];
+        uint8_t state = mep.rMEPdb.state(slot);
+        if (!(state & RMepStore::RMEP_ACTIVE)) {
+            continue;
+        }
+        /* log entry on UP to DOWN transition */
+        if (setRMepBit(mep.rMEPdb, slot, RMepStore::RMEP_CCM_DEFECT, true,
+                mep.rMEPdown)) {
+            this->rMepTransition(mep, slot, now);
+            /* the outage is no interval between CCMs */
+            mep.rMEPdb.arrivals(slot).restart();
+            /* no CCMs with the wrong interval either, as errorCCMwhile */
+            setRMepBit(mep.rMEPdb, slot,
+                    RMepStore::RMEP_INTERVAL_MISMATCH, false,
+                    mep.rMEPmismatch);
+            /* last heard of as before, only the state changed */
+            last.lastSeen = 0;
+            mep.view.read(slot, last);
+            this->publishRMep(mep, slot, last.lastSeen);
+            status = EXIT_FAILURE;
+        }
+    }
+    this->flushEvents(mep, now);
+
+    /* from scratch: the check due now has been taken off already */
+    mep.checkAt = TimerWheel::NONE64;
+    this->updateDefects(mep, now);
+    return status;
+}
+
+template <class Layout>
+int ErpsEngine::processCcm(MaCfg &cfg, const uint8_t *data, uint32_t size,
+        int verbose) {
+
+    const uint8_t *srcmac;
+    const struct cfmhdr *cfmhdr;
+    const struct cfm_cc *cfm_cc;
+    int rMEPid;
+    uint32_t seq;
+    uint32_t interval;
+    uint32_t slot;
+    uint32_t refreshed;
+    uint64_t nowUsec;
+    uint64_t now;
+    const Dot1agAttr *attr = &cfg.dot1agAttr;
 
     /*
-     * MAID field size is 48 octets
-     * MD Name Format: 1 octet
-     * MD Name Length: 1 octet
-     * Short MA Name Format: 1 octet
-     * Short MA Name Length: 1 octet
-     * MD Name + Short MA Name <= 48 - 4
-     * Zero padding at the end
+     * all the offsets below are constants of the layout, and the frame
+     * was demultiplexed to this MA by its VLAN and MD level already
      */
+    if (size < Layout::PDU_OFFSET + sizeof (struct cfm_cc)) {
+        return (EXIT_FAILURE);
+    }
 
-    /* extract the Short MA Name */
-    /* Short MA Name Format starts after MD Name */
-    sma_name_fmt = *(md_namep + mdnl);
+    /* We need to parse the CCM header first in order to get the MEP ID */
+    cfm_cc = Layout::template pdu<struct cfm_cc>(data);
+    rMEPid = ntohs(cfm_cc->mepid);
+    if (rMEPid < 1 || rMEPid > MAX_MEPID) {
+        return (EXIT_FAILURE);
+    }
 
-    /* create a '\0' filled buffer, ensuring trailing '\0' */
-    /* maximum SMA length is "MAID_SIZE - mdnl - 4" */
-    char smanamebuf[MAID_SIZE - mdnl - 4 + 1];
-    memset(smanamebuf, '\0', sizeof (smanamebuf));
+    /* parse the generic CFM header */
+    cfmhdr = Layout::cfmhdr(data);
+    srcmac = Layout::srcMac(data);
+    seq = ntohl(cfm_cc->seqNumber);
+    nowUsec = NetIf::getTimeUsec();
+    now = nowUsec / 1000;
+
+    /* the remote MEP is watched at the interval it says it sends at */
+    interval = Dot1agCcm::decodeInterval(GET_CCM_INTERVAL(cfmhdr));
+    if (interval == 0) {
+        if (verbose) {
+            fprintf(stderr, "invalid CCM interval, discard frame\n");
+        }
+        return (EXIT_FAILURE);
+    }
 
-    switch (sma_name_fmt) {
-        case 0:
-            /* Reserved for 802.1 */
-            break;
-        case 1:
-            /* Primary VID */
-            break;
-        case 2:
-            /* Character String */
-            smanl = *(md_namep + mdnl + sizeof (sma_name_fmt));
-            if (smanl < 1) {
-                fprintf(stderr, "illegal Short MA Length: %d\n",
-                        smanl);
-                break;
-            }
-            if (smanl + mdnl > MAID_SIZE - 4) {
-                smanl = MAID_SIZE - mdnl - 4;
-            }
+    if (verbose) {
+        fprintf(stderr, "rcvd CCM from: "
+                "%02x:%02x:%02x:%02x:%02x:%02x, level %d",
+                srcmac[0], srcmac[1], srcmac[2],
+                srcmac[3], srcmac[4], srcmac[5],
+                GET_MD_LEVEL(cfmhdr));
+    }
 
-            /* copy Short MA Name to buffer */
-            strncpy(smanamebuf, (char *) (md_namep + mdnl + 2), smanl);
+    /*
+     * A remote MEP in a steady state sends the same CCM over and over but
+     * for the sequence number. If it is the one last accepted by all the
+     * local MEPs, only the sequence number and the timers need refreshing.
+     */
+    refreshed = 0;
+    cfg.refreshed.assign(cfg.meps.size(), 0);
+    for (size_t i = 0; i < cfg.meps.size() && this->ccmMemo_; i++) {
+        MepCfg &mep = *cfg.meps[i];
+
+        slot = mep.rMEPdb.find(rMEPid);
+        if (slot != RMepStore::NONE &&
+                (mep.rMEPdb.state(slot) & (RMepStore::RMEP_ACTIVE |
+                RMepStore::RMEP_CCM_RECEIVED_EQUAL |
+                RMepStore::RMEP_CCM_DEFECT)) == (RMepStore::RMEP_ACTIVE |
+                RMepStore::RMEP_CCM_RECEIVED_EQUAL) &&
+                mep.rMEPdb.isLastCcm(slot, data, size, Layout::PDU_OFFSET,
+                sizeof (cfm_cc->seqNumber))) {
+            mep.rMEPdb.trackSeq(slot, seq);
+            mep.rMEPdb.arrivals(slot).add(nowUsec,
+                    mep.rMEPdb.cold(slot).recvdInterval);
+            this->armRMep(mep, slot, now);
+            this->publishRMep(mep, slot, now);
+            cfg.refreshed[i] = 1;
+            refreshed++;
+        }
+    }
+    if (refreshed == cfg.meps.size()) {
+        if (verbose) {
+            fprintf(stderr, ", seq %u (same as last)\n", seq);
+        }
+        return (EXIT_SUCCESS);
+    }
 
-            if (verbose) {
-                fprintf(stderr, ", MA \"%s\"", smanamebuf);
+    /*
+     * discard if MAID is different from ours: ours is encoded just as we
+     * send it, so one compare does, and names are only decoded to tell
+     */
+    if (!cfg.maidMatcher.match(&cfm_cc->maid)) {
+        if (verbose) {
+            char mdnamebuf[DOT1AG_MAX_MD_LENGTH + 1];
+            char smanamebuf[MAID_SIZE - 4 + 1];
+
+            if (MaidMatcher::decodeNames(&cfm_cc->maid, mdnamebuf,
+                    smanamebuf) != EXIT_SUCCESS) {
+                fprintf(stderr, ", illegal MAID");
+            } else {
+                fprintf(stderr, ", MD \"%s\", MA \"%s\"", mdnamebuf,
+                        smanamebuf);
             }
+            fprintf(stderr,
+                    " (expected MD \"%s\", MA \"%s\", discard frame)\n",
+                    attr->md, attr->ma);
+        }
+        /* a CCM of another MA leaking into ours, xconCCMdefect */
+        this->raiseCcmDefect(cfg, MepCfg::DEFECT_XCON_CCM, interval, now);
+        return (EXIT_FAILURE);
+    }
+    if (verbose) {
+        fprintf(stderr, ", MD \"%s\", MA \"%s\"", attr->md, attr->ma);
+    }
 
-            /* discard if MA name is different from ours */
-            if (strncmp(smanamebuf, attr->ma,
-                    strlen(attr->ma) > smanl ? strlen(attr->ma) : smanl)
-                    != 0) {
-                if (verbose) {
-                    fprintf(stderr,
-                            " (expected \"%s\", discard frame)\n",
-                            attr->ma);
-                }
-                return (EXIT_FAILURE);
+    /*
+     * discard if CCM has the same MEPID as one of us: ours coming back
+     * from the interface, or else a MEP misconfigured, errorCCMdefect
+     */
+    for (size_t i = 0; i < cfg.meps.size(); i++) {
+        if (cfg.meps[i]->attr.mepid != rMEPid) {
+            continue;
+        }
+        if (memcmp(srcmac, this->netIf0_->getLocalMac(),
+                ETHER_ADDR_LEN) != 0) {
+            if (!(cfg.meps[i]->defects & MepCfg::DEFECT_ERROR_CCM)) {
+                fprintf(stderr,
+                        "config error: CCM received with our MEPID %d "
+                        "(ours %d)\n",
+                        rMEPid, cfg.meps[i]->attr.mepid);
             }
-            break;
-        case 3:
-            /* 2-octet Integer */
-            break;
-        case 4:
-            /* RFC2685 VPN ID */
-            break;
-        default:
-            /*
-             *  5-31:   Reserved for IEEE 802.1
-             *  32-63:  Defined by ITU-T Y.1731
-             *  64-255: Reserved for IEEE 802.1
-             */
-            break;
+            this->raiseCcmDefect(cfg, MepCfg::DEFECT_ERROR_CCM, interval,
+                    now);
+        } else if (verbose) {
+            fprintf(stderr, " (our own, discard frame)\n");
+        }
+        return (EXIT_FAILURE);
     }
-    for (i = 0; i < ETHER_ADDR_LEN; i++) {
-        rMEPdb[rMEPid].recvdMacAddress[i] = encap->srcmac[i];
-    }
-
-    /* start parsing TLVs */
-    p = POS_CFM_CC_TLVS(data);
-    more_tlvs = 1; /* there are more TLVs to parse */
-    while (more_tlvs) {
-        tlv_length = ntohs(*(uint16_t *) (p + 1));
-        switch (*p) {
-            case TLV_END:
-                /* End TLV */
-                more_tlvs = 0; /* last TLV, stop further parsing */
-                break;
-            case TLV_SENDER_ID:
-                /* Sender ID TLV */
-                /* XXX not implemented yet */
-                break;
-            case TLV_ORG_SPECIFIC:
-                /* Organization-Specific TLV */
-                /* XXX not implemented yet */
-                break;
+
+    /*
+     * parse the TLVs before taking the remote MEP in, a CCM with TLVs
+     * running over the end of the frame is discarded
+     */
+    TlvIterator tlvs(Layout::firstTlv(data), data + size);
+    CfmTlv tlv;
+    int tlv_ps = -1;
+    int tlv_is = -1;
+    uint8_t status;
+
+    while (tlvs.next(tlv)) {
+        switch (tlv.type) {
             case TLV_PORT_STATUS:
                 /* Port Status TLV */
-                rMEPdb[rMEPid].tlv_ps = *(p + 3);
+                if (tlv.getStatus(status) == EXIT_SUCCESS) {
+                    tlv_ps = status;
+                }
                 break;
             case TLV_INTERFACE_STATUS:
                 /* Interface Status TLV */
-                rMEPdb[rMEPid].tlv_is = *(p + 3);
+                if (tlv.getStatus(status) == EXIT_SUCCESS) {
+                    tlv_is = status;
+                }
                 break;
             default:
+                /* Sender ID, Organization-Specific, ... not used */
                 break;
         }
-        /* skip over TLV length + value fields to next TLV */
-        p += sizeof (uint16_t) + tlv_length + 1;
+    }
+    if (tlvs.isMalformed()) {
+        if (verbose) {
+            fprintf(stderr, " (malformed TLVs, discard frame)\n");
+        }
+        return (EXIT_FAILURE);
     }
 
     if (verbose) {
         fprintf(stderr, "\n");
     }
 
-    /* send log entry on DOWN to UP transition */
-    if (rMEPdb[rMEPid].rMEPCCMdefect == 1) {
-        rMEPdb[rMEPid].rMEPCCMdefect = 0;
-        this->printRMEPState(rMEPdb, rMEPid, "UP");
-    }
-
     /*
-     * Set rMEPwhile to 3.5x CCMinterval. rMEPwhile is the
-     * timeout after which it is assumed that the remote
-     * MEP is down. 3.5 times means that 3 CCM PDUs have
-     * been lost.
+     * every local MEP of the MA tracks the remote MEP on its own, but for
+     * those refreshed above: the CCM is the one they accepted last, already
+     * counted in their sequence and arrival accounting
      */
-    uint32_t sec = (attr->CCMinterval / 10 * 35) / 1000;
-    uint32_t usec = ((attr->CCMinterval / 10 * 35) % 1000) * 1000;
-    NetIf::updateTimeFromNow(rMEPdb[rMEPid].rMEPwhile, sec, usec);
+    for (size_t i = 0; i < cfg.meps.size(); i++) {
+        if (cfg.refreshed[i]) {
+            continue;
+        }
+        this->updateRMep(*cfg.meps[i], rMEPid, srcmac, tlv_ps, tlv_is,
+                interval, (cfmhdr->flags & DOT1AG_CCFLAGS_RDI) != 0, seq,
+                data, size, Layout::PDU_OFFSET, nowUsec);
+    }
 
     return (EXIT_SUCCESS);
 }
@@ -364,179 +788,772 @@ int ErpsEngine::processCcm(NetIfCfg &cfg, const uint8_t *data, int verbose) {
 /*
  * This task is to handle received CFM packets and react accordingly 
  */
+int ErpsEngine::processCcm(MaCfg &cfg, const Dot1ag *dot1ag) {
+    const uint8_t *data = dot1ag->getPacketBuf().data();
+    uint32_t size = dot1ag->getPacketSize();
+
+    /* the frame was classified when received, pick its layout */
+    switch (dot1ag->getTagging()) {
+        case FRAME_UNTAGGED:
+            return processCcm<UntaggedLayout>(cfg, data, size, cfg.dot1agAttr.verbose);
+        case FRAME_DOT1Q:
+            return processCcm<Dot1qLayout>(cfg, data, size, cfg.dot1agAttr.verbose);
+        case FRAME_DOT1AD:
+            return processCcm<Dot1adLayout>(cfg, data, size, cfg.dot1agAttr.verbose);
+        default:
+            return (EXIT_FAILURE);
+    }
+}
+
+void ErpsEngine::processPacket(Dot1ag *dot1ag) {
+    const struct cfmhdr *cfmhdr;
+    uint32_t interval;
+    MaCfg *ma;
+
+    /* every shard runs this, so the per frame traces only with -V */
+    cfmhdr = dot1ag->getCfmHdr();
+    switch (cfmhdr == NULL ? -1 : cfmhdr->opcode) {
+        case CFM_CCM:
+            if (verbose_) {
+                cout << " :: This is a CFM CCM packet ..." << endl;
+            }
+            /* of an unknown VLAN and MD level: counted, dropped */
+            if ((ma = demuxMa(dot1ag)) != NULL) {
+                processCcm(*ma, dot1ag);
+            } else if ((ma = xconMa(dot1ag)) != NULL) {
+                /* of a lower MD level than an MA of ours */
+                interval = Dot1agCcm::decodeInterval(
+                        GET_CCM_INTERVAL(cfmhdr));
+                if (interval != 0) {
+                    this->raiseCcmDefect(*ma, MepCfg::DEFECT_XCON_CCM,
+                            interval, NetIf::getTimeMsec());
+                }
+            }
+            break;
+        case CFM_LBM:
+            if (verbose_) {
+                cout << " :: This is a CFM LBM packet with tid: " <<
+                        dot1ag->getTransId() << endl;
+            }
+            /*
+             * answered for an MA of ours only, as on the fast path; those
+             * of an unknown VLAN and MD level are counted, dropped
+             */
+            if (demuxMa(dot1ag) != NULL &&
+                    EXIT_SUCCESS == Dot1agLbm::convertDotagLbm2Lbr(dot1ag,
+                    this->netIf0_->getLocalMac())) {
+                this->netIf0_->sendPacket(dot1ag);
+                if (verbose_) {
+                    cout << " :: Sent CFM LBR packet Successfully with tid: " <<
+                            dot1ag->getTransId() << endl;
+                }
+            }
+            break;
+        case CFM_LBR:
+            if (verbose_) {
+                cout << " :: This is a CFM LBR packet ..." << endl;
+            }
+            /* to the coroutine awaiting it, which matches it in full */
+            if ((ma = demuxMa(dot1ag)) == NULL ||
+                    !ma->shard->transactions.deliver(dot1ag)) {
+                if (verbose_) {
+                    cout << " :: No LBM outstanding with tid: " <<
+                            dot1ag->getTransId() << endl;
+                }
+            }
+            break;
+        case CFM_LTM:
+            if (verbose_) {
+                cout << " :: This is a CFM LTM packet ..." << endl;
+            }
+            break;
+        case CFM_LTR:
+            if (verbose_) {
+                cout << " :: This is a CFM LTR packet ..." << endl;
+            }
+            if ((ma = demuxMa(dot1ag)) == NULL ||
+                    !ma->shard->transactions.deliver(dot1ag)) {
+                if (verbose_) {
+                    cout << " :: No LTM outstanding with tid: " <<
+                            dot1ag->getTransId() << endl;
+                }
+            }
+            break;
+        case CFM_RAPS:
+            if (verbose_) {
+                cout << " :: This is a R-APS packet ..." << endl;
+            }
+            if ((ma = demuxMa(dot1ag)) != NULL &&
+                    ma->dot1agRAps != NULL) {
+                //dot1agRAps->printPacket();
+                if (ma->dot1agRAps->cfmMatchRAps(dot1ag)) {
+                    cout << "  :: R-APS matched " << endl;
+                }
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+void ErpsEngine::startTx(const MonoTime &now) {
+    for (size_t i = 0; i < shards_.size(); i++) {
+        Shard *shard = shards_[i];
+
+        for (size_t j = 0; j < shard->meps.size(); j++) {
+            MepCfg *mep = shard->meps[j];
+
+            if (shard->txTimers.isArmed(mep->index)) {
+                mep->nextTx = firstTx(*mep, now);
+                shard->txTimers.arm(mep->index, txTick(mep->nextTx));
+            }
+        }
+    }
+}
+
+void ErpsEngine::startTransactions() {
+    uint32_t interval;
+
+    for (size_t i = 0; i < mas_.size(); i++) {
+        MaCfg *ma = mas_[i];
+
+        /* an LBM every CCM interval of its first MEP, in ms at least 1 */
+        if (ma->dot1agLbm != NULL) {
+            interval = ma->meps[0]->ccmInterval / 1000;
+            this->loopback(*ma, interval > 0 ? interval : 1);
+        }
+        if (ma->dot1agLtm != NULL) {
+            this->linktrace(*ma);
+        }
+    }
+}
+
+CfmTask ErpsEngine::loopback(MaCfg &ma, uint32_t interval) {
+    TransactionTable &transactions = ma.shard->transactions;
+
+    while (1) {
+        co_await transactions.sleep(interval);
+        this->ping(ma);
+    }
+}
+
+CfmTask ErpsEngine::ping(MaCfg &ma) {
+    Shard &shard = *ma.shard;
+    Transaction lb(shard.transactions, CFM_LBR, Dot1agLbm::LBR_TIMEOUT);
+    MonoTime sent = MonoTime::now();
+    Dot1ag *lbr;
+
+    /* out with the CCMs of this round */
+    this->queueDot1agPacket(shard, ma.dot1agLbm, lb.getTransId(),
+            ma.dot1agAttr.verbose);
+
+    /*
+     * of another MAC, the next one may still be ours; told every LBM when
+     * verbose, otherwise to the event log as the LBRs are lost and back
+     */
+    while ((lbr = co_await lb.reply()) != NULL) {
+        if (EXIT_SUCCESS == ma.dot1agLbm->cfm_matchlbr(
+                lbr->getPacketData(), lbr->getPacketSize(),
+                lb.getTransId())) {
+            if (ma.dot1agAttr.verbose) {
+                cout << " :: Good - This CFM LBR matched the LBM we sent "
+                        "with tid: " << lb.getTransId() << " in " <<
+                        (MonoTime::now() - sent).usec() << " us" << endl;
+            }
+            if (ma.lbrLost) {
+                ma.lbrLost = false;
+                this->postEvent(*ma.meps[0], 0, EventLog::LBR_RECEIVED,
+                        lb.getTransId(), 1, NetIf::getTimeMsec());
+            }
+            co_return;
+        }
+    }
+    if (ma.dot1agAttr.verbose) {
+        cout << *this << " :: No LBR to the LBM sent with tid: " <<
+                lb.getTransId() << " within " << Dot1agLbm::LBR_TIMEOUT <<
+                " ms" << endl;
+    }
+    if (!ma.lbrLost) {
+        ma.lbrLost = true;
+        this->postEvent(*ma.meps[0], 0, EventLog::LBR_LOST, lb.getTransId(),
+                1, NetIf::getTimeMsec());
+    }
+}
+
+CfmTask ErpsEngine::linktrace(MaCfg &ma) {
+    Shard &shard = *ma.shard;
+    const uint8_t *localMac = this->netIf0_->getLocalMac();
+    uint8_t ttl;
+    uint8_t action;
+    uint32_t hops;
+    bool hit;
+    Dot1ag *ltr;
+
+    while (1) {
+        co_await shard.transactions.sleep(Dot1agLtm::LTR_TIMEOUT);
+
+        Transaction lt(shard.transactions, CFM_LTR, Dot1agLtm::LTR_TIMEOUT);
+        this->queueDot1agPacket(shard, ma.dot1agLtm, lt.getTransId(),
+                ma.dot1agAttr.verbose);
+
+        /* every MIP and MEP on the way answers, till the timeout */
+        hops = 0;
+        hit = false;
+        while ((ltr = co_await lt.reply()) != NULL) {
+            if (Dot1agLtm::parseLtr(ltr->getPacketData(),
+                    ltr->getPacketSize(), localMac, ttl, action) !=
+                    EXIT_SUCCESS) {
+                continue;
+            }
+            hops++;
+            hit = hit || action == ACTION_RLYHIT;
+            cout << " :: LTR to the LTM with tid: " << lt.getTransId() <<
+                    " from ";
+            Dot1ag::eaprint(ltr->getPacketData() + ETHER_ADDR_LEN);
+            cout << " ttl: " << (int) ttl << " action: " << (int) action <<
+                    endl;
+        }
+        cout << *this << " :: Linktrace with tid: " << lt.getTransId() <<
+                " answered by " << hops << " hops, target " <<
+                (hit ? "reached" : "not reached") << endl;
+    }
+}
+
+void ErpsEngine::serve(Shard &shard, Dot1ag *dot1ag) {
+    uint64_t stamp = dot1ag->getRxStamp();
+    uint64_t now;
+    uint64_t latency;
+
+    this->processPacket(dot1ag);
+
+    /* the frames built here rather than received have no time stamp */
+    now = NetIf::getDateUsec();
+    if (stamp != 0 && now >= stamp) {
+        latency = now - stamp;
+        shard.rxFrames.fetch_add(1, memory_order_relaxed);
+        shard.rxLatencySum.fetch_add(latency, memory_order_relaxed);
+        if (latency > shard.rxLatencyMax.load(memory_order_relaxed)) {
+            shard.rxLatencyMax.store(latency, memory_order_relaxed);
+        }
+        shard.rxLatency[latencyBucket(latency)].fetch_add(1,
+                memory_order_relaxed);
+    }
+
+    /* the packet has been processed so it needs to be deleted */
+    delete dot1ag;
+}
+
 void ErpsEngine::task() {
-    struct cfmhdr *cfmhdr;
+    vector<thread *> threads;
+
+    /* the CCMs start from now, at their phase */
+    this->startTx(MonoTime::now());
+    this->startTransactions();
 
+    for (size_t i = 0; i < shards_.size(); i++) {
+        threads.push_back(shards_[i]->start());
+    }
+    if (reporter_.seconds > 0) {
+        threads.push_back(reporter_.start());
+    }
+    threads.push_back(events_.start());
+    for (size_t i = 0; i < threads.size(); i++) {
+        threads[i]->join();
+    }
+}
+
+/*
+ * The main loop of a shard: the packets steered to it, then its CCMs/LBMs
+ * and rMEPwhile timers due, then to sleep till the next of them or the next
+ * packet, whichever comes first
+ */
+void ErpsEngine::Shard::task() {
     // For the packet received for processing
     Dot1ag *dot1ag = NULL;
-    uint8_t *data;
 
-    /* The main loop of this NetIf */
-    int loop = 0;
     while (1) {
-        cout << endl << *this << " :: In loop: will wait ... " << endl;
         unique_lock<mutex> ul(*(this->mutex_));
-        this->cond_->wait(ul);
 
-        /* to process each packet in the rxBuffer */
-        int size = this->rxBuffer.size();
-        for (int i = 0; i < size; i++) {
-            dot1ag = this->rxBuffer.front();
-            cout << endl << *this << " index: " << i << " :: Received Dot1ag packet" << endl;
+        /*
+         * to process the packets queued by their priority, R-APS first;
+         * the lock is only held to dequeue so that RX is never blocked
+         */
+        asleep.store(false, memory_order_relaxed);
+        while ((dot1ag = this->popPacket()) != NULL) {
+            ul.unlock();
             //            dot1ag->printPacket();
 
-            data = dot1ag->getPacketData();
-            cfmhdr = CFMHDR(data);
-            switch (cfmhdr->opcode) {
-                case CFM_CCM:
-                    cout << " :: This is a CFM CCM packet ..." << endl;
-                    processCcm(netIf0Cfg_, data);
-                    break;
-                case CFM_LBM:
-                    cout << " :: This is a CFM LBM packet with tid: " <<
-                            dot1ag->getTransId() << endl;
-                    /* Now build responde and send out*/
-                    if (EXIT_SUCCESS == Dot1agLbm::convertDotagLbm2Lbr(dot1ag,
-                            this->netIf0_->getLocalMac())) {
-                        this->netIf0_->sendPacket(dot1ag);
-                        cout << " :: Sent CFM LBR packet Successfully with tid: " <<
-                                dot1ag->getTransId() << endl;
-                    }
-                    break;
-                case CFM_LBR:
-                    cout << " :: This is a CFM LBR packet ..." << endl;
-                    if (netIf0Cfg_.dot1agLbm != NULL) {
-                        //dot1agLbm->printPacket();
-                        if (EXIT_SUCCESS == netIf0Cfg_.dot1agLbm->cfm_matchlbr(data)) {
-                            cout << " :: Good - This CFM LBR matched the LBM we sent with tid: " <<
-                                    dot1ag->getTransId() << endl;
-                        }
-                    }
-
-                    break;
-                case CFM_LTM:
-                    cout << " :: This is a CFM LTM packet ..." << endl;
-                    break;
-                case CFM_RAPS:
-                    cout << " :: This is a R-APS packet ..." << endl;
-                    if (netIf0Cfg_.dot1agRAps != NULL) {
-                        //dot1agRAps->printPacket();
-                        if (netIf0Cfg_.dot1agRAps->cfmMatchRAps(data)) {
-                            cout << "  :: R-APS matched " << endl;
-                        }
-                    }
-                    break;
-                default:
-                    break;
-            }
-
-            /* 
-             * To-do: the packet has been process so it needs to be deleted 
-             */
-            this->rxBuffer.pop_front();
-            delete dot1ag;
+            erpsEngine->serve(*this, dot1ag);
+            ul.lock();
         }
-
+        /* from now on, a packet queued wakes the timer up */
+        asleep.store(true, memory_order_relaxed);
         ul.unlock();
-        loop++;
+
+        erpsEngine->runCfm(*this, MonoTime::now());
+
+        timer.arm(this->nextDeadline());
+        if (timer.wait()) {
+            this->accountLatency(timer.getLastLate());
+        }
     }
 
 }
 
+/*
+ * The one loop of the engine run to completion: the frames received, then
+ * the CCMs/LBMs and rMEPwhile timers due of all the shards, then to sleep
+ * till the next of them or the next frame, whichever comes first
+ */
+void ErpsEngine::runToCompletion() {
+    TimerService &timer = shards_[0]->timer;
+    uint64_t deadline;
+    uint64_t next;
+    uint64_t late;
+    uint32_t received;
+    int fd;
+
+    /* the thread of the engine, as a shard would be */
+    this->attach();
+
+    fd = this->netIf0_->openRx();
+    if (fd < 0) {
+        fprintf(stderr, "%s: failed to open the RX channel\n",
+                this->netIf0_->getIfName());
+        exit(EXIT_FAILURE);
+    }
+    timer.watch(fd);
+    this->inline_ = true;
+
+    /* the CCMs start from now, at their phase */
+    this->startTx(MonoTime::now());
+    this->startTransactions();
+
+    if (reporter_.seconds > 0) {
+        reporter_.start();
+    }
+    events_.start();
+
+    while (1) {
+        /*
+         * the frames first, processed as they are read, but RX_BUDGET of
+         * them at most for a flood not to hold the CCMs up
+         */
+        received = this->netIf0_->receive(NetIf::RX_BUDGET, &late);
+        if (received > 0) {
+            this->accountLatency(late);
+        }
+
+        MonoTime now = MonoTime::now();
+        deadline = TimerService::NONE64;
+        for (size_t i = 0; i < shards_.size(); i++) {
+            this->runCfm(*shards_[i], now);
+            next = shards_[i]->nextDeadline();
+            if (next < deadline) {
+                deadline = next;
+            }
+        }
+
+        /* with frames left to read, straight back to them */
+        if (received < NetIf::RX_BUDGET) {
+            timer.arm(deadline);
+            if (timer.wait()) {
+                this->accountLatency(timer.getLastLate());
+            }
+        }
+    }
+}
+
+/*
+ * The status report loop, off the snapshots the shards publish
+ */
+void ErpsEngine::Reporter::task() {
+    MonoTime due;
+    MonoTime now;
+
+    while (1) {
+        due = MonoTime::now() + MonoTime::fromMsec(this->seconds * 1000ULL);
+        this_thread::sleep_for(chrono::seconds(this->seconds));
+        now = MonoTime::now();
+        this->accountLatency(now > due ? (now - due).usec() : 0);
+        erpsEngine->printStatus(cout);
+    }
+}
+
+void ErpsEngine::setWorkerSchedAttr(const SchedAttr &attr) {
+    int count = CPU_COUNT(&attr.cpus);
+    int cpu = -1;
+
+    this->setSchedAttr(attr);
+    for (size_t i = 0; i < shards_.size(); i++) {
+        SchedAttr shard = attr;
+
+        /* the next CPU of the set, round robin */
+        if (shards_.size() > 1 && count > 1) {
+            do {
+                cpu = (cpu + 1) % CPU_SETSIZE;
+            } while (!CPU_ISSET(cpu, &attr.cpus));
+            CPU_ZERO(&shard.cpus);
+            CPU_SET(cpu, &shard.cpus);
+        }
+        shards_[i]->setSchedAttr(shard);
+    }
+}
+
+void ErpsEngine::getSchedStats(SchedStats &stats) const {
+    TimerService::Stats timer;
+    IntervalStats tx;
+    double error;
+
+    memset(&stats, 0, sizeof (stats));
+    for (size_t i = 0; i < shards_.size(); i++) {
+        const Shard *shard = shards_[i];
+        uint32_t batchMax = shard->txBatchMax.load(memory_order_relaxed);
+
+        shard->timer.getStats(timer);
+        stats.ccmsSent += shard->ccmsSent.load(memory_order_relaxed);
+        stats.txSlips += shard->txSlips.load(memory_order_relaxed);
+        stats.txDeferred += shard->txDeferred.load(memory_order_relaxed);
+        stats.txBatches += shard->txBatches.load(memory_order_relaxed);
+        if (batchMax > stats.txBatchMax) {
+            stats.txBatchMax = batchMax;
+        }
+        stats.rxFrames += shard->rxFrames.load(memory_order_relaxed);
+        stats.rxLatencySum += shard->rxLatencySum.load(memory_order_relaxed);
+        if (shard->rxLatencyMax.load(memory_order_relaxed) >
+                stats.rxLatencyMax) {
+            stats.rxLatencyMax = shard->rxLatencyMax.load(
+                    memory_order_relaxed);
+        }
+        for (uint32_t k = 0; k < LATENCY_BUCKETS; k++) {
+            stats.rxLatency[k] += shard->rxLatency[k].load(
+                    memory_order_relaxed);
+        }
+        stats.timer.wakeups += timer.wakeups;
+        stats.timer.expirations += timer.expirations;
+        stats.timer.lateSum += timer.lateSum;
+        if (timer.lateMax > stats.timer.lateMax) {
+            stats.timer.lateMax = timer.lateMax;
+        }
+
+        /* each MEP against its own interval, as it published them */
+        for (size_t j = 0; j < shard->meps.size(); j++) {
+            const MepCfg *mep = shard->meps[j];
+
+            if (mep->view.readTx(tx) != EXIT_SUCCESS ||
+                    tx.getCount() == 0) {
+                continue;
+            }
+            if (stats.txMeps == 0 || tx.getMin() < stats.txMin) {
+                stats.txMin = tx.getMin();
+            }
+            if (tx.getMax() > stats.txMax) {
+                stats.txMax = tx.getMax();
+            }
+            error = fabs(tx.getMean() - mep->ccmInterval);
+            if (error > stats.txMeanError) {
+                stats.txMeanError = error;
+            }
+            if (tx.getStddev() > stats.txStddevMax) {
+                stats.txStddevMax = tx.getStddev();
+            }
+            for (uint32_t k = 0; k < IntervalStats::BUCKETS; k++) {
+                stats.txBuckets[k] += tx.getBucket(k);
+            }
+            stats.txIntervals += tx.getCount();
+            stats.txMeps++;
+        }
+    }
+}
+
+void ErpsEngine::printStatus(ostream &os) const {
+    MepSnapshot::Entry entry;
+    IntervalStats tx;
+    uint64_t now = NetIf::getTimeMsec();
+    ostringstream report;
+
+    /* the MAs and MEPs are set up before the start, only read since */
+    report << *this;
+    printThread(report, this->netIf0_->getRx());
+    printThread(report, *this);
+    for (size_t i = 0; i < shards_.size(); i++) {
+        printThread(report, *shards_[i]);
+    }
+    printThread(report, events_);
+    printThread(report, reporter_);
+    for (size_t i = 0; i < shards_.size(); i++) {
+        TimerService::Stats stats;
+        TransactionTable::Stats transactions;
+
+        const Shard *shard = shards_[i];
+        uint64_t frames = shard->rxFrames.load(memory_order_relaxed);
+
+        shard->timer.getStats(stats);
+        report << " shard " << i << " timer " << stats;
+        if (frames > 0) {
+            report << " rx: " << frames << " latency mean/max: " <<
+                    shard->rxLatencySum.load(memory_order_relaxed) / frames <<
+                    "/" << shard->rxLatencyMax.load(memory_order_relaxed) <<
+                    " us";
+        }
+        report << endl;
+        shard->transactions.getStats(transactions);
+        if (transactions.opened > 0) {
+            report << "   " << transactions << endl;
+        }
+    }
+    for (size_t i = 0; i < mas_.size(); i++) {
+        const MaCfg *ma = mas_[i];
+
+        for (size_t j = 0; j < ma->meps.size(); j++) {
+            const MepCfg *mep = ma->meps[j];
+            uint32_t size = mep->view.size();
+
+            report << " vlan: " << ma->dot1agAttr.vlan << " level: " <<
+                    (int) ma->dot1agAttr.md_level << " MEPid: " <<
+                    mep->attr.mepid << " defects: 0x" << hex <<
+                    (int) mep->view.getDefects() << dec << " alarm: " <<
+                    (int) mep->view.getAlarm() << " rMEPs: " << size <<
+                    endl;
+            if (mep->view.readTx(tx) == EXIT_SUCCESS) {
+                report << "   tx every " << mep->ccmInterval << " us, ";
+                tx.print(report);
+            }
+            for (uint32_t slot = 0; slot < size; slot++) {
+                if (mep->view.read(slot, entry) != EXIT_SUCCESS) {
+                    continue;
+                }
+                report << "   rMEPid: " << entry.mepid << " mac: " << hex <<
+                        setfill('0');
+                for (int k = 0; k < ETHER_ADDR_LEN; k++) {
+                    report << (k ? ":" : "") << setw(2) <<
+                            (unsigned int) entry.mac[k];
+                }
+                report << dec << setfill(' ') << " is " <<
+                        ((entry.state & RMepStore::RMEP_CCM_DEFECT) ?
+                        "DOWN" : "UP") << " seq: " << entry.lastSeq <<
+                        " rx: " << entry.received << " lost: " <<
+                        entry.lost << " gaps: " << entry.gaps <<
+                        " dup: " << entry.duplicates << " late: " <<
+                        entry.reorders <<
+                        " interval: " << entry.interval << " us" <<
+                        " ps: " << (int) entry.tlv_ps << " is: " <<
+                        (int) entry.tlv_is << " last heard: " <<
+                        now - entry.lastSeen << " ms ago" << endl;
+                report << "     ";
+                entry.arrivals.print(report);
+            }
+        }
+    }
+    /* in one go, not interleaved with the traces of the shards */
+    os << report.str() << flush;
+}
+
+void ErpsEngine::printThread(ostream &os, const Runnable &thread) {
+    Runnable::LatencyStats stats;
+
+    /* e.g. the RX thread, with the engine run to completion */
+    if (!thread.isStarted()) {
+        return;
+    }
+    thread.getLatencyStats(stats);
+    os << " thread " << thread.getName() << " " << thread.getSchedAttr() <<
+            " " << stats << endl;
+}
+
 ostream & operator<<(ostream& os, const ErpsEngine & ee) {
-    os << "[" + ee.name_ + "(tid: " << this_thread::get_id() << ")]:: rx size: " << ee.rxBuffer.size() << endl;
+    os << "[" + ee.name_ + "(tid: " << this_thread::get_id() << ")]:: workers: " << ee.shards_.size() <<
+            ", MAs: " << ee.mas_.size() << ", MEPs: " << ee.getMepCount() <<
+            ", unknown MA drops: " << ee.maDemux_.getUnknown() <<
+            ", events dropped: " << ee.events_.getDropped() << endl;
     return os;
 }
 
-void ErpsEngine::sendDot1agPacket(Dot1ag *dot1ag, uint32_t seq) {
-    int status = EXIT_SUCCESS;
+MonoTime ErpsEngine::txPhase(uint32_t interval) {
+    MonoTime spread = MonoTime::fromUsec(interval);
+    uint32_t n = txPhases_[interval]++;
 
+    /* the longer intervals start within the first second all the same */
+    if (spread > MonoTime::fromMsec(1000)) {
+        spread = MonoTime::fromMsec(1000);
+    }
+
+    /*
+     * van der Corput over TX_PHASES slots: 0, 1/2, 1/4, 3/4, 1/8, ... of
+     * the spread, each MEP halfway between two earlier ones, however many
+     * come; the slots share their wakeups
+     */
+    return MonoTime((uint64_t) (reverseBits(n) >> (32 - TX_PHASE_BITS)) *
+            spread.nsec() >> TX_PHASE_BITS);
+}
+
+MonoTime ErpsEngine::firstTx(const MepCfg &mep, const MonoTime &now) {
+    MonoTime period = MonoTime::fromUsec(mep.ccmInterval);
+    MonoTime first;
+
+    if (period > MonoTime::fromMsec(1000)) {
+        return now + mep.txPhase;
+    }
+
+    /* on the grid of the interval, the same for all the MEPs */
+    first = now - MonoTime(now.nsec() % period.nsec()) + mep.txPhase;
+    if (first < now) {
+        first += period;
+    }
+    return first;
+}
+
+void ErpsEngine::queueDot1agPacket(Shard &shard, Dot1ag *dot1ag, uint32_t seq,
+        int verbose) {
     if (dot1ag == NULL) {
         return;
     }
 
-    if (typeid (*dot1ag) == typeid (Dot1agCcm)) {
-        dot1ag->setTransId(seq);
-        cout << "  [TaskCfm]:: going to send CCM with seq: " << seq << endl;
-    } else if (typeid (*dot1ag) == typeid (Dot1agLbm)) {
-        dot1ag->setTransId(seq);
-        cout << *this << "  [TaskCfm]:: going to send LBM with seq: " << seq << endl;
+    dot1ag->setTransId(seq);
+    if (verbose) {
+        if (typeid (*dot1ag) == typeid (Dot1agCcm)) {
+            cout << "  [Shard]:: going to send CCM with seq: " << seq << endl;
+        } else if (typeid (*dot1ag) == typeid (Dot1agLbm)) {
+            cout << *this << "  [Shard]:: going to send LBM with seq: " << seq << endl;
+        } else if (typeid (*dot1ag) == typeid (Dot1agLtm)) {
+            cout << *this << "  [Shard]:: going to send LTM with tid: " << seq << endl;
+        }
     }
+    shard.txBatch.push_back(dot1ag);
+}
+
+void ErpsEngine::flushTx(Shard &shard) {
+    uint32_t count = shard.txBatch.size();
+    uint32_t sent;
 
-    status = this->netIf0_->sendPacket(dot1ag);
+    if (count == 0) {
+        return;
+    }
+    sent = this->netIf0_->transmitBatch(&shard.txBatch[0], count);
+    shard.txBatch.clear();
 
-    if (status == EXIT_SUCCESS) {
-        cout << *this << "  [TaskCfm]:: Sent successfully" << endl;
-    } else {
-        cout << *this << "  [TaskCfm]:: Failed in sending" << endl;
+    shard.txBatches.fetch_add(1, memory_order_relaxed);
+    if (count > shard.txBatchMax.load(memory_order_relaxed)) {
+        shard.txBatchMax.store(count, memory_order_relaxed);
     }
 
+    /* failures are told anyway, a MEP not heard of is a defect elsewhere */
+    if (sent != count) {
+        cout << *this << "  [Shard]:: Failed in sending " << count - sent <<
+                " of " << count << endl;
+    } else if (verbose_) {
+        cout << *this << "  [Shard]:: Sent " << count << " successfully" <<
+                endl;
+    }
 }
 
-/*
- * To-do: using SIGALARM for scheduling periodically sending CCM/LBM messages 
- */
-void ErpsEngine::scheduleTimer() {
-    struct sigaction act;
-    struct itimerval tval;
-
-    /* define signal handler */
-    act.sa_handler = &timeout_handler;
-    sigemptyset(&act.sa_mask);
-    act.sa_flags = 0;
-    if (sigaction(SIGALRM, &act, NULL) == -1) {
-        perror("sigaction");
-        exit(EXIT_FAILURE);
+void ErpsEngine::sendCcm(MepCfg &mep, const MonoTime &now) {
+    MonoTime interval = MonoTime::fromUsec(mep.ccmInterval);
+    Shard &shard = *mep.ma->shard;
+
+    /*
+     * CCIsentCCMs, numbered from 1 as 0 is for not numbered; the CCMs
+     * skipped take their number too, so that the peers see them lost
+     */
+    mep.ccmSeq++;
+
+    /* Needs to skip CCMSkips of CCMs */
+    if (((mep.ccmSeq - 1) % (mep.attr.CCMSkips + 1)) == 0) {
+        /* the remote MEPs learn of our defects from it, presentRDI */
+        mep.dot1agCcm->setRdi(mep.defects & MepCfg::DEFECTS_RDI);
+        this->queueDot1agPacket(shard, mep.dot1agCcm, mep.ccmSeq,
+                mep.attr.verbose);
+        shard.ccmsSent.fetch_add(1, memory_order_relaxed);
     }
 
-    /* set timer to INTERVAL seconds */
-    tval.it_interval.tv_usec = 0;
-    tval.it_interval.tv_sec = 1;
-    tval.it_value.tv_usec = 0;
-    tval.it_value.tv_sec = 1;
-    if (setitimer(ITIMER_REAL, &tval, NULL) < 0) {
-        perror("setitimer");
-        exit(EXIT_FAILURE);
+    /* how far the CCMs are from their interval, skipped ones included */
+    mep.txIntervals.add(now.usec(), mep.ccmInterval);
+    mep.view.publishTx(mep.txIntervals);
+
+    /*
+     * keep to the grid of the first CCM, in ns so that 3.33 ms comes out
+     * right on average out of the TX ticks; a whole interval late, skip the
+     * CCMs missed rather than send them in a burst, the phase kept
+     */
+    mep.nextTx += interval;
+    if (mep.nextTx <= now) {
+        mep.nextTx += MonoTime(((now - mep.nextTx).nsec() / interval.nsec() +
+                1) * interval.nsec());
+        shard.txSlips.fetch_add(1, memory_order_relaxed);
     }
+    shard.txTimers.arm(mep.index, txTick(mep.nextTx));
+}
+
+void ErpsEngine::deferTx(Shard &shard, const MonoTime &now) {
+    vector<uint32_t> &due = shard.txDue;
+    uint64_t tick = now.nsec() / TX_TICK_NSEC;
+    size_t kept = shard.txBurst;
+    size_t deferred = 0;
+
+    /* the most late first, by the CCM they are due to send */
+    sort(due.begin(), due.end(), [&shard](uint32_t a, uint32_t b) {
+        return shard.meps[a]->nextTx < shard.meps[b]->nextTx;
+    });
 
+    /*
+     * the others a burst a tick over the next ticks, their phase kept, each
+     * as long as its peers would not go TX_GAP_MAX without a CCM of it; it
+     * goes now otherwise, past the burst
+     */
+    for (size_t i = shard.txBurst; i < due.size(); i++) {
+        MepCfg &mep = *shard.meps[due[i]];
+        uint64_t at = tick + 1 + deferred / shard.txBurst;
+        uint64_t last = mep.txIntervals.getLast();
+
+        if (last != 0 && at * TX_TICK_NSEC / 1000 >= last +
+                (uint64_t) mep.ccmInterval * TX_GAP_MAX / 10) {
+            due[kept++] = due[i];
+            continue;
+        }
+        shard.txTimers.arm(due[i], at);
+        deferred++;
+    }
+    shard.txDeferred.fetch_add(deferred, memory_order_relaxed);
+    due.resize(kept);
 }
 
-/*
- * Periodically sending CCM/LBMs if configred so
- */
-void ErpsEngine::TaskCfm::task() {
-    int status = EXIT_SUCCESS;
-    struct timeval now, next_ccm;
-    uint32_t seq = 0;
+void ErpsEngine::runCfm(Shard &shard, const MonoTime &now) {
+    uint64_t msec = now.msec();
 
-    /* schedule next CCM to be sent to now */
-    gettimeofday(&next_ccm, NULL);
+    /* the LBMs and LTMs they send go out with the CCMs below */
+    shard.transactions.advance(msec);
 
-    while (1) {
-        gettimeofday(&now, NULL);
+    /*
+     * the MEPs due to send, the others are not even looked at; the frames
+     * of the tick go out together
+     */
+    shard.txDue.clear();
+    shard.txTimers.advance(now.nsec() / TX_TICK_NSEC, shard.txDue);
+    if (shard.txDue.size() > shard.txBurst) {
+        this->deferTx(shard, now);
+    }
+    for (size_t i = 0; i < shard.txDue.size(); i++) {
+        this->sendCcm(*shard.meps[shard.txDue[i]], now);
+    }
+    this->flushTx(shard);
 
-        if (cfm_timevalcmp(next_ccm, now, <)) {
-            /* Needs to skip CCMSkips of CCMs */
-            if ((seq % (this->CCMSkips + 1)) == 0) {
-                erpsEngine->sendDot1agPacket(erpsEngine->netIf0Cfg_.dot1agCcm, seq);
-                erpsEngine->sendDot1agPacket(erpsEngine->netIf0Cfg_.dot1agLbm, seq);
-            }
-            seq++;
-            NetIf::updateTimeFromNow(next_ccm, CCMinterval / 1000,
-                    (CCMinterval % 1000) * 1000);
-        }
+    /* has one of the remote MEP timers run out? */
+    shard.checkDue.clear();
+    shard.checkTimers.advance(msec, shard.checkDue);
+    for (size_t i = 0; i < shard.checkDue.size(); i++) {
+        MepCfg *mep = shard.meps[shard.checkDue[i]];
 
-        /* has one of the remote MEP timers run out? */
-        status = this->erpsEngine->checkRMEPdb(this->erpsEngine->netIf0Cfg_);
-        if (status == EXIT_FAILURE) {
+        if (this->checkRMEPdb(*mep, msec) == EXIT_FAILURE) {
             /* some mac is down */
-            cout << "  :: mac is down so send out R-APS SF message ..." << endl;
-            this->erpsEngine->netIf0_->sendPacket(this->erpsEngine->netIf0Cfg_.dot1agRAps);
-            cout << "  :: R-APS SF sent " << endl;
+            this->netIf0_->sendPacket(mep->ma->dot1agRAps);
+            this->postEvent(*mep, 0, EventLog::RAPS_SF_SENT, 0, 1, msec);
         }
-
-        /* To-do: sleep ms for now, and better solution might be using signal */
-        usleep(NetIf::WAKEUP / 1000);
     }
+}
 
+void ErpsEngine::runCfm(uint64_t now) {
+    for (size_t i = 0; i < shards_.size(); i++) {
+        this->runCfm(*shards_[i], MonoTime::fromMsec(now));
+    }
 }
+
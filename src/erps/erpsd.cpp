@@ -25,27 +25,65 @@
 
 static void usage() {
     fprintf(stderr, "\n  usage: erpsd -i interface \n\n"
-            "    [-m MEPID(11)] \n"
+            "    [-m MEPID[-MEPID](11)] \n"
             "    [-t target mac address] \n"
+            "    [-T linktrace to the target mac with LTMs of TTL (0: off)] \n"
             "    [-r ring id(1)] \n"
-            "    [-m MEPID] \n"
-            "    [-v vlan (0)] [-l mdlevel (1)]\n"
-            "    [-s CCM-interval (1000) 100|1000|10000|60000|600000] \n"
+            "    [-v vlan[-vlan] (0)] [-l mdlevel (1)]\n"
+            "    [-s CCM-interval (1000) 3.33|10|100|1000|10000|60000|600000] \n"
             "    [-S CCM-skips (0)]\n"
             "    [-d maintenance-domain(HCL)]\n"
             "    [-a maintenance-association(HCL_ERPS)]\n"
+            "    [-p RX-policer rate(5000)[:burst(500)] per source mac and class (0: off)]\n"
+            "    [-L LBR fast path rate[:burst] LBRs/s sent from RX thread (0: off)]\n"
+            "    [-w worker threads, the MAs spread over them (1)]\n"
+            "    [-C run to completion: one thread receives, processes and sends]\n"
+            "    [-P rx|engine:[cpus][:fifo|rr|other[:priority]] scheduling of the threads]\n"
+            "    [-M lock the memory of the process, no page fault on it]\n"
+            "    [-R seconds between status reports of the MEPs (0: off)]\n"
+            "    [-F lowest defect priority alarmed[:alarm-ms[:reset-ms]] (2:2500:10000)]\n"
+            "    [-E event window ms[:flap dampening half-life ms, 0 off] (1000:15000)]\n"
             "    [-V verbose] \n\n"
             "  Notes: \n\n"
             "  - Interface is required via -i \n"
             "  - If -m specified, it will continually sending CCMs; \n"
-            "  - If -t specified, it will continually sending LBMs; \n"
+            "  - A range of VLANs makes one MA per VLAN, and a range of MEPIDs \n"
+            "    that many local MEPs in each of them, each with its own CCMs; \n"
+            "  - If -t specified, it will continually sending LBMs, and LTMs \n"
+            "    too with -T, each awaiting its replies on its own; the LBRs \n"
+            "    are told of with -V, else the events as they are lost and back \n"
             "  - If none of the above 2 specified, it will behave like a daemon, \n"
-            "    just waiting for Dot1ag messages. \n\n"
+            "    just waiting for Dot1ag messages. \n"
+            "  - With -C, the MAs of all the workers are served by that one \n"
+            "    thread, without any hand over of the frames between threads. \n"
+            "  - -P rx is the thread receiving the frames, -P engine the workers, \n"
+            "    which send the CCMs too, one CPU each of the cpus in turn, or \n"
+            "    the one thread with -C, e.g. -P rx:1:fifo:60 -P engine:2-3:fifo:50 \n"
+            "  - -p polices the LBMs, LTMs and their replies of each peer apart \n"
+            "    from its other frames; its CCMs and R-APS have a budget of \n"
+            "    their own, twice the CCMs of the MEPs configured. \n\n"
             );
 
     exit(EXIT_FAILURE);
 }
 
+/*
+ * Parse "n" or "first-last" into [first, last], EXIT_FAILURE if malformed
+ */
+static int parseRange(const char *str, int &first, int &last) {
+    char *end;
+
+    first = strtol(str, &end, 10);
+    last = first;
+    if (*end == '-') {
+        last = strtol(end + 1, &end, 10);
+    }
+    if (end == str || *end != '\0' || last < first) {
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
+
 /*
  * Main function
  */
@@ -55,9 +93,24 @@ int main(int argc, char** argv) {
     int status = -1;
 
     Dot1agAttr attr;
+    int vlanFirst = 0, vlanLast = 0;
+    int mepFirst = -1, mepLast = -1;
+    int ttl;
+    uint32_t policerRate = RxPolicer::DEFAULT_RATE;
+    uint32_t policerBurst = RxPolicer::DEFAULT_BURST;
+    uint32_t lbrRate = 0;
+    uint32_t lbrBurst = 100;
+    uint32_t workers = 1;
+    uint32_t statusInterval = 0;
+    bool runToCompletion = false;
+    bool lockMemory = false;
+    Runnable::SchedAttr rxSched;
+    Runnable::SchedAttr engineSched;
+    Runnable::SchedAttr *sched;
+    char *burst;
 
     /* parse command line options */
-    while ((ch = getopt(argc, argv, "hi:l:v:c:r:t:m:s:S:d:a:V")) != -1) {
+    while ((ch = getopt(argc, argv, "hi:l:v:c:r:t:T:m:s:S:d:a:p:L:w:CP:MR:F:E:V")) != -1) {
         switch (ch) {
             case 'h':
                 usage();
@@ -69,7 +122,11 @@ int main(int argc, char** argv) {
                 attr.md_level = atoi(optarg);
                 break;
             case 'v':
-                attr.vlan = atoi(optarg);
+                if (parseRange(optarg, vlanFirst, vlanLast) != EXIT_SUCCESS ||
+                        vlanFirst < 0 || vlanLast > 4095) {
+                    fprintf(stderr, "Invalid vlan range: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
                 break;
             case 'r':
                 attr.ring_id = atoi(optarg);
@@ -77,8 +134,20 @@ int main(int argc, char** argv) {
             case 't':
                 attr.remoteMac = optarg;
                 break;
+            case 'T':
+                ttl = atoi(optarg);
+                if (ttl < 0 || ttl > 255) {
+                    fprintf(stderr, "Invalid LTM TTL: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                attr.ltmTtl = ttl;
+                break;
             case 'm':
-                attr.mepid = atoi(optarg);
+                if (parseRange(optarg, mepFirst, mepLast) != EXIT_SUCCESS ||
+                        mepFirst < 1 || mepLast > MAX_MEPID) {
+                    fprintf(stderr, "Invalid MEPID range: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
                 break;
             case 's':
                 attr.CCMinterval = atoi(optarg);
@@ -92,6 +161,73 @@ int main(int argc, char** argv) {
             case 'a':
                 attr.ma = optarg;
                 break;
+            case 'p':
+                policerRate = atoi(optarg);
+                burst = strchr(optarg, ':');
+                if (burst != NULL) {
+                    policerBurst = atoi(burst + 1);
+                }
+                break;
+            case 'L':
+                lbrRate = atoi(optarg);
+                burst = strchr(optarg, ':');
+                if (burst != NULL) {
+                    lbrBurst = atoi(burst + 1);
+                }
+                break;
+            case 'w':
+                workers = atoi(optarg);
+                if (workers < 1) {
+                    fprintf(stderr, "At least one worker thread is needed\n");
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'C':
+                runToCompletion = true;
+                break;
+            case 'P':
+                if (strncmp(optarg, "rx:", 3) == 0) {
+                    sched = &rxSched;
+                } else if (strncmp(optarg, "engine:", 7) == 0) {
+                    sched = &engineSched;
+                } else {
+                    fprintf(stderr, "Threads are rx or engine: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                if (Runnable::parseSchedAttr(strchr(optarg, ':') + 1,
+                        *sched) != EXIT_SUCCESS) {
+                    fprintf(stderr, "Invalid scheduling: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'M':
+                lockMemory = true;
+                break;
+            case 'R':
+                statusInterval = atoi(optarg);
+                break;
+            case 'F':
+                attr.lowestAlarmPri = atoi(optarg);
+                if (attr.lowestAlarmPri < 1 || attr.lowestAlarmPri > 6) {
+                    fprintf(stderr, "Defect priorities are 1 to 6\n");
+                    exit(EXIT_FAILURE);
+                }
+                burst = strchr(optarg, ':');
+                if (burst != NULL) {
+                    attr.fngAlarmTime = atoi(burst + 1);
+                    burst = strchr(burst + 1, ':');
+                    if (burst != NULL) {
+                        attr.fngResetTime = atoi(burst + 1);
+                    }
+                }
+                break;
+            case 'E':
+                attr.eventWindow = atoi(optarg);
+                burst = strchr(optarg, ':');
+                if (burst != NULL) {
+                    attr.flapHalfLife = atoi(burst + 1);
+                }
+                break;
             case 'V':
                 attr.verbose = 1;
                 break;
@@ -114,12 +250,13 @@ int main(int argc, char** argv) {
         usage();
     }
     
-    /* check for valid '-t' flag */
     /*
-     * 10 ms is not supported because it is probably a too short
-     * interrupt time for most Unix based systems.
+     * check for valid '-s' flag: 3.33 ms (3) and 10 ms are fine too, the
+     * shards sleep on a timerfd till the CCM is due, not for a tick
      */
     switch (attr.CCMinterval) {
+        case 3:
+        case 10:
         case 100:
         case 1000:
         case 10000:
@@ -128,18 +265,52 @@ int main(int argc, char** argv) {
             break;
         default:
             fprintf(stderr, "Supported CCM interval times are:\n");
-            fprintf(stderr, "100, 1000, 10000, 60000, 600000 ms\n");
+            fprintf(stderr, "3.33, 10, 100, 1000, 10000, 60000, 600000 ms\n");
             exit(EXIT_FAILURE);
     }
 
 
+    /* before the MEPs are set up, so that all of them are locked in */
+    if (lockMemory && Runnable::lockMemory() != EXIT_SUCCESS) {
+        exit(EXIT_FAILURE);
+    }
+
     cout << "Hello from ERPSd!" << endl;
 
     NetIf nif(attr.ifname);
+    nif.getPolicer().setRate(policerRate, policerBurst);
+    nif.setLbrFastPath(lbrRate, lbrBurst);
+
+    /* Handling ERPS and CFM messages, the first MEP comes with the engine */
+    attr.vlan = vlanFirst;
+    attr.mepid = mepFirst;
+    ErpsEngine erpsEngine(&nif, &attr, workers);
+
+    for (int vlan = vlanFirst; vlan <= vlanLast; vlan++) {
+        for (int mepid = mepFirst; mepid <= mepLast; mepid++) {
+            if (vlan == vlanFirst && mepid == mepFirst) {
+                continue;
+            }
+            attr.vlan = vlan;
+            attr.mepid = mepid;
+            if (erpsEngine.addMep(&attr) != EXIT_SUCCESS) {
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+    erpsEngine.setStatusInterval(statusInterval);
+    erpsEngine.setWorkerSchedAttr(engineSched);
+    nif.setRxSchedAttr(rxSched);
+    cout << "MAs: " << erpsEngine.getMaCount() << ", local MEPs: " <<
+            erpsEngine.getMepCount() << ", workers: " <<
+            erpsEngine.getWorkerCount() << ", " <<
+            erpsEngine.memoryUsage() << " bytes" << endl;
+
+    /* Will never return, the NetIf is driven by the engine itself */
+    if (runToCompletion) {
+        erpsEngine.runToCompletion();
+    }
 
-    /* Handling ERPS and CFM messages */
-    ErpsEngine erpsEngine(&nif, &attr);
-    
     thread *thread_netif;
     nif.init();
     thread_netif = nif.start();